@@ -0,0 +1,379 @@
+#include "readfile.h"
+#include "writefile.h"
+#include "mode-options.h"
+#include "wav-header.h"
+#include "sound-effects.h"
+#include "wav-stream.h"
+#include "sample-format.h"
+#include "simd-kernels.h"
+#include "io-queue.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <functional>
+
+// Micro-benchmark of WAVE file I/O and effects.
+// Synthetic files are generated for every combination of sample format, channel count and length,
+// every operation is timed separately and the best of several runs is printed as one JSON object per line,
+// so results can be collected and compared between versions.
+
+/* Support functions */
+
+// Sample format of generated files.
+struct BenchFormat
+{
+  const char* name;
+  uint16_t audio_format;
+  uint16_t bits_per_sample;
+};
+
+const BenchFormat BENCH_FORMATS[] = {
+  { "u8", format::WAVE_FORMAT_PCM, 8 },
+  { "s16", format::WAVE_FORMAT_PCM, 16 },
+  { "s24", format::WAVE_FORMAT_PCM, 24 },
+  { "s32", format::WAVE_FORMAT_PCM, 32 },
+  { "f32", format::WAVE_FORMAT_IEEE_FLOAT, 32 },
+  { "f64", format::WAVE_FORMAT_IEEE_FLOAT, 64 },
+};
+
+const uint32_t BENCH_FREQUENCY = 48000;
+
+// Header is parsed this many times in one run, a single parse is too short to be timed.
+const size_t HEADER_PARSES = 1000;
+
+// Benchmark options.
+//
+// Throws std::invalid_argument exception if invalid option or options value was passed.
+struct BenchOptions
+{
+  std::string work_dir = ".";
+  std::vector<std::string> formats = { "u8", "s16", "s24", "s32", "f32", "f64" };
+  std::vector<uint32_t> channel_counts = { 1, 2, 6 };
+  std::vector<uint32_t> lengths_s = { 1, 30 };
+  uint32_t repeats = 3;
+  BenchOptions(const int argc, const char* argv[]);
+};
+
+// Splits comma-separated list.
+std::vector<std::string> split_list(const std::string& list);
+
+// Parses comma-separated list of positive numbers.
+// Throws std::invalid_argument exception if an item is not a positive number.
+std::vector<uint32_t> parse_number_list(const std::string& list, const char* option);
+
+// Returns the format with format_name.
+// Throws std::invalid_argument exception if format name is unknown.
+const BenchFormat& find_format(const std::string& format_name);
+
+// Makes WAVE file bytes of frame_count frames: 44-byte header and a sine of different phase in every channel.
+std::vector<uint8_t> make_wav(const BenchFormat& bench_format, uint16_t channels, uint32_t frame_count);
+
+// Runs operation repeats times and returns the best time in seconds.
+// prepare is called before every run and is not timed.
+double best_time(uint32_t repeats, const std::function<void()>& prepare, const std::function<void()>& operation);
+
+// Prints result as a JSON object line.
+void print_result(const char* op, const std::string& format_name, uint16_t channels, uint32_t frame_count,
+                  uint64_t byte_count, double seconds);
+
+void print_usage();
+
+
+int main(const int argc, const char* argv[])
+{
+  try
+  {
+    if (argc > 1 && std::string(argv[1]) == "help")
+    {
+      print_usage();
+      return 0;
+    }
+    BenchOptions options(argc, argv);
+
+    for (const std::string& format_name : options.formats)
+    {
+      for (uint32_t channels : options.channel_counts)
+      {
+        for (uint32_t length_s : options.lengths_s)
+        {
+          uint32_t frame_count = BENCH_FREQUENCY * length_s;
+          std::vector<uint8_t> bytes = make_wav(find_format(format_name), channels, frame_count);
+          uint64_t data_size = bytes.size() - 44;
+          std::string path = options.work_dir + "/bench-" + format_name + "-" + std::to_string(channels) + "ch-" +
+                             std::to_string(length_s) + "s.wav";
+          std::string quarter_ms = std::to_string(length_s * 250), three_quarters_ms = std::to_string(length_s * 750);
+
+          auto report = [&](const char* op, double seconds)
+          {
+            print_result(op, format_name, channels, frame_count, data_size, seconds);
+          };
+          std::vector<uint8_t> work;
+          auto copy_bytes = [&]() { work = bytes; };
+          auto nothing = []() {};
+
+          report("writefile", best_time(options.repeats, nothing, [&]() { writefile(bytes, path); }));
+          report("readfile", best_time(options.repeats, nothing, [&]() { work = readfile(path.c_str()); }));
+
+          double header_seconds = best_time(options.repeats, nothing, [&]()
+          {
+            for (size_t idx = 0; idx < HEADER_PARSES; idx++)
+            {
+              WavHeader header(bytes);
+              if (header.get_data_size() != data_size)
+              {
+                throw std::runtime_error("Error: Generated file has wrong data size.");
+              }
+            }
+          });
+          report("header", header_seconds / HEADER_PARSES);
+
+          // Effects run on the bytes in memory, so they are timed without file I/O
+          const char* trim_argv[] = { "wav-edit-bench", "trim", path.c_str(), "-s", quarter_ms.c_str(), "-e",
+                                      three_quarters_ms.c_str() };
+          TrimOptions trim(7, trim_argv);
+          report("trim", best_time(options.repeats, copy_bytes, [&]() { effects::trim(work, trim); }));
+
+          const char* fade_argv[] = { "wav-edit-bench", "fade", path.c_str() };
+          FadeOptions fade(3, fade_argv);
+          report("fade", best_time(options.repeats, copy_bytes, [&]() { effects::fade(work, fade); }));
+
+          const char* reverb_argv[] = { "wav-edit-bench", "reverb", path.c_str(), "-d", "100", "-k", "0.3" };
+          ReverbOptions reverb(7, reverb_argv);
+          report("reverb", best_time(options.repeats, copy_bytes, [&]() { effects::reverb(work, reverb); }));
+
+          const char* freeverb_argv[] = { "wav-edit-bench", "freeverb", path.c_str() };
+          FreeverbOptions freeverb(3, freeverb_argv);
+          report("freeverb", best_time(options.repeats, copy_bytes, [&]() { effects::freeverb(work, freeverb); }));
+
+          // Streamed effect reads, processes and writes blocks at the same time, see io-queue.h
+          std::string stream_path = path + ".out.wav";
+          report("fade-stream", best_time(options.repeats, nothing, [&]()
+          {
+            WavReader reader(path.c_str());
+            WavWriter writer(stream_path.c_str(), reader.get_header_bytes());
+            effects::fade(reader, writer, fade);
+          }));
+          std::remove(stream_path.c_str());
+
+          std::remove(path.c_str());
+        }
+      }
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << e.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
+
+
+/* Support functions implementation */
+
+BenchOptions::BenchOptions(const int argc, const char* argv[])
+{
+  int idx = 1;
+  while (idx < argc)
+  {
+    if (argv[idx][0] != '-' || idx + 1 == argc)
+    {
+      throw std::invalid_argument("Error: Invalid options format. See 'wav-edit-bench help'.");
+    }
+
+    std::string value = argv[idx + 1];
+    switch (argv[idx][1])
+    {
+      case 'd':
+        work_dir = value;
+        if (!directory_exists(work_dir.c_str()))
+        {
+          throw std::invalid_argument("Error: Directory (-d) '" + work_dir + "' does not exist.");
+        }
+        break;
+
+      case 'f':
+        formats = split_list(value);
+        for (const std::string& format_name : formats)
+        {
+          find_format(format_name);
+        }
+        break;
+
+      case 'c':
+        channel_counts = parse_number_list(value, "-c");
+        break;
+
+      case 'l':
+        lengths_s = parse_number_list(value, "-l");
+        break;
+
+      case 'r':
+        repeats = parse_number_list(value, "-r").at(0);
+        break;
+
+      default:
+        throw std::invalid_argument("Error: Invalid option " + std::string(argv[idx]) + ". See 'wav-edit-bench help'.");
+    }
+    idx += 2;
+  }
+}
+
+std::vector<std::string> split_list(const std::string& list)
+{
+  std::vector<std::string> items;
+  std::stringstream stream(list);
+  std::string item;
+  while (std::getline(stream, item, ','))
+  {
+    items.push_back(item);
+  }
+  return items;
+}
+
+std::vector<uint32_t> parse_number_list(const std::string& list, const char* option)
+{
+  std::vector<uint32_t> numbers;
+  for (const std::string& item : split_list(list))
+  {
+    char* end;
+    unsigned long number = std::strtoul(item.c_str(), &end, 10);
+    if (item.empty() || *end != '\0' || number == 0 || number > 0xFFFF)
+    {
+      throw std::invalid_argument("Error: Values of " + std::string(option) + " should be positive numbers.");
+    }
+    numbers.push_back((uint32_t)number);
+  }
+  if (numbers.empty())
+  {
+    throw std::invalid_argument("Error: " + std::string(option) + " needs at least one value.");
+  }
+  return numbers;
+}
+
+// Writes little-endian value of byte_count bytes at pos.
+void put_le(std::vector<uint8_t>& bytes, size_t pos, uint64_t value, size_t byte_count)
+{
+  for (size_t idx = 0; idx < byte_count; idx++)
+  {
+    bytes[pos + idx] = (uint8_t)(value >> (8 * idx));
+  }
+}
+
+template <typename T>
+void put_sample(uint8_t* out, float val)
+{
+  T smpl = samples::from_float<T>(val);
+  memcpy(out, &smpl, sizeof(T));
+}
+
+const BenchFormat& find_format(const std::string& format_name)
+{
+  for (const BenchFormat& bench_format : BENCH_FORMATS)
+  {
+    if (format_name == bench_format.name)
+    {
+      return bench_format;
+    }
+  }
+  throw std::invalid_argument("Error: Unknown format '" + format_name + "', formats are u8, s16, s24, s32, f32 and f64.");
+}
+
+std::vector<uint8_t> make_wav(const BenchFormat& bench_format, uint16_t channels, uint32_t frame_count)
+{
+  uint16_t sample_size = bench_format.bits_per_sample / 8;
+  uint16_t block_align = sample_size * channels;
+  uint64_t data_size = (uint64_t)frame_count * block_align;
+  std::vector<uint8_t> bytes(44 + data_size);
+
+  memcpy(&bytes[0], "RIFF", 4);
+  put_le(bytes, 4, 36 + data_size, 4);
+  memcpy(&bytes[8], "WAVEfmt ", 8);
+  put_le(bytes, 16, 16, 4);
+  put_le(bytes, 20, bench_format.audio_format, 2);
+  put_le(bytes, 22, channels, 2);
+  put_le(bytes, 24, BENCH_FREQUENCY, 4);
+  put_le(bytes, 28, (uint64_t)BENCH_FREQUENCY * block_align, 4);
+  put_le(bytes, 32, block_align, 2);
+  put_le(bytes, 34, bench_format.bits_per_sample, 2);
+  memcpy(&bytes[36], "data", 4);
+  put_le(bytes, 40, data_size, 4);
+
+  uint8_t* out = &bytes[44];
+  for (uint32_t frame = 0; frame < frame_count; frame++)
+  {
+    for (uint16_t channel = 0; channel < channels; channel++, out += sample_size)
+    {
+      float val = 0.5f * (float)std::sin(2. * 3.14159265358979 * 440. * frame / BENCH_FREQUENCY + channel);
+      switch (bench_format.bits_per_sample + (bench_format.audio_format == format::WAVE_FORMAT_IEEE_FLOAT))
+      {
+        case 8:  put_sample<uint8_t>(out, val); break;
+        case 16: put_sample<int16_t>(out, val); break;
+        case 24: put_sample<samples::Int24>(out, val); break;
+        case 32: put_sample<int32_t>(out, val); break;
+        case 33: put_sample<float>(out, val); break;
+        case 65: put_sample<double>(out, val); break;
+      }
+    }
+  }
+  return bytes;
+}
+
+double best_time(uint32_t repeats, const std::function<void()>& prepare, const std::function<void()>& operation)
+{
+  double best = 0.;
+  for (uint32_t run = 0; run < repeats; run++)
+  {
+    prepare();
+    auto start_time = std::chrono::steady_clock::now();
+    operation();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    if (run == 0 || seconds < best)
+    {
+      best = seconds;
+    }
+  }
+  return best;
+}
+
+// Queue of streamed reads and writes is made the same way as by WavReader and WavWriter,
+// so its name is the one they use.
+void print_result(const char* op, const std::string& format_name, uint16_t channels, uint32_t frame_count,
+                  uint64_t byte_count, double seconds)
+{
+  static const std::string io_name = make_io_queue(1)->get_name();
+  std::ostringstream line;
+  line << "{\"op\":\"" << op << "\",\"format\":\"" << format_name << "\",\"channels\":" << channels
+       << ",\"frames\":" << frame_count << ",\"bytes\":" << byte_count << ",\"kernels\":\"" << kernels::instruction_set()
+       << "\",\"io\":\"" << io_name << "\",\"seconds\":" << seconds << ",\"ns_per_frame\":" << (frame_count > 0 ? seconds * 1e9 / frame_count : 0.)
+       << ",\"gb_per_s\":" << (seconds > 0 ? byte_count / seconds / 1e9 : 0.) << "}";
+  std::cout << line.str() << std::endl;
+}
+
+void print_usage()
+{
+  std::cout
+    << "USAGE:\n"
+    << "wav-edit-bench[.exe] [OPTIONS]...\n\n"
+    << "    Will generate WAVE files for every combination of format, channel count and length,\n"
+    << "    time file writing and reading, header parsing, trim, fade, reverb and freeverb effects,\n"
+    << "    streamed fade (fade-stream) and print the best time of every operation as a JSON object per line:\n"
+    << "    op, format, channels, frames, bytes (of data), kernels, io (queue of streamed blocks: io_uring or thread),\n"
+    << "    seconds, ns_per_frame, gb_per_s\n"
+    << "    Header time is the time of one parse. Effects run on file bytes in memory,\n"
+    << "    fade-stream is the fade from file to file with read-ahead and write-behind, including the final sync.\n"
+    << "    OPTIONS:\n"
+    << "    -d = directory for generated files, they are removed after use (current directory by default)\n"
+    << "    -f = comma-separated formats: u8, s16, s24, s32, f32, f64 (all by default)\n"
+    << "    -c = comma-separated channel counts (1,2,6 by default)\n"
+    << "    -l = comma-separated lengths in seconds (1,30 by default)\n"
+    << "    -r = number of runs of every operation, the best one is printed (3 by default)\n" << std::endl;
+}
@@ -0,0 +1,486 @@
+#include "io-queue.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <cerrno>
+#include <cstring>
+
+#ifdef HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+/* Support functions */
+
+// Request of a queue: a read into bytes from infile or a write of bytes to outfile.
+struct IoRequest
+{
+  InputFile* infile;
+  OutputFile* outfile;
+  uint64_t pos;
+  uint8_t* bytes;
+  size_t byte_count;
+  bool done;
+};
+
+// Does the request in the calling thread.
+// Throws std::runtime_error if the file could not be read or written
+void run_request(const IoRequest& request);
+
+
+/* ThreadQueue implementation */
+
+// Queue with one thread that does the requests one after another.
+// Requests of the caller and blocks processed meanwhile overlap, as with io_uring,
+// but a request of one queue does not start before the previous one is done.
+class ThreadQueue : public IoQueue
+{
+private:
+  std::deque<IoRequest> requests;
+  std::deque<std::string> errors;  // error message of every request, empty if the request succeeded
+  size_t started = 0;              // requests at the front of the queue taken by the thread
+  std::mutex mutex;
+  std::condition_variable request_added, request_done;
+  bool stopping = false;
+  std::thread worker;
+
+  void work();
+  void submit(const IoRequest& request);
+
+public:
+  ThreadQueue();
+  ~ThreadQueue();
+
+  void submit_read(InputFile& file, uint64_t pos, uint8_t* bytes, size_t byte_count);
+  void submit_write(OutputFile& file, uint64_t pos, const uint8_t* bytes, size_t byte_count);
+  void wait();
+  size_t get_pending_count();
+  const char* get_name();
+};
+
+ThreadQueue::ThreadQueue() : worker(&ThreadQueue::work, this)
+{
+}
+
+// Requests left in the queue are done before the thread stops, their bytes are still in place.
+ThreadQueue::~ThreadQueue()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  request_added.notify_one();
+  worker.join();
+}
+
+void ThreadQueue::work()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    request_added.wait(lock, [this] { return started < requests.size() || stopping; });
+    if (started == requests.size())
+    {
+      return;
+    }
+
+    // Elements of std::deque stay in place when other elements are added or removed at the ends
+    size_t request_idx = started++;
+    IoRequest& request = requests[request_idx];
+    std::string& error = errors[request_idx];
+    lock.unlock();
+    try
+    {
+      run_request(request);
+    }
+    catch (const std::exception& exception)
+    {
+      error = exception.what();
+    }
+    lock.lock();
+    request.done = true;
+    request_done.notify_one();
+  }
+}
+
+void ThreadQueue::submit(const IoRequest& request)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests.push_back(request);
+    errors.push_back(std::string());
+  }
+  request_added.notify_one();
+}
+
+void ThreadQueue::submit_read(InputFile& file, uint64_t pos, uint8_t* bytes, size_t byte_count)
+{
+  submit({ &file, nullptr, pos, bytes, byte_count, false });
+}
+
+void ThreadQueue::submit_write(OutputFile& file, uint64_t pos, const uint8_t* bytes, size_t byte_count)
+{
+  submit({ nullptr, &file, pos, (uint8_t*)bytes, byte_count, false });
+}
+
+void ThreadQueue::wait()
+{
+  std::string error;
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    request_done.wait(lock, [this] { return requests.front().done; });
+    error = errors.front();
+    requests.pop_front();
+    errors.pop_front();
+    started--;
+  }
+
+  if (!error.empty())
+  {
+    throw std::runtime_error(error);
+  }
+}
+
+size_t ThreadQueue::get_pending_count()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return requests.size();
+}
+
+const char* ThreadQueue::get_name()
+{
+  return "thread";
+}
+
+
+#ifdef HAVE_IO_URING
+
+/* UringQueue implementation */
+
+// Queue of io_uring requests made by system calls, so liburing is not needed.
+// Reads and writes are buffered and started by the kernel right on submission.
+// A request that completes short or fails is finished by a plain read or write in the calling thread,
+// which either continues it or reports the error in the same way as the files do.
+class UringQueue : public IoQueue
+{
+private:
+  // Requests with the io_uring result of every one, their iovec are used by the kernel
+  struct UringRequest
+  {
+    IoRequest request;
+    struct iovec iov;
+    int32_t result;
+  };
+
+  int ring_fd = -1;
+  uint8_t* sq_ring = nullptr;
+  uint8_t* cq_ring = nullptr;
+  size_t sq_ring_size = 0, cq_ring_size = 0;
+  io_uring_sqe* sqes = nullptr;
+  size_t sqes_size = 0;
+  unsigned *sq_tail, *sq_mask, *sq_array, *cq_head, *cq_tail, *cq_mask;
+  io_uring_cqe* cqes;
+
+  std::deque<UringRequest> requests;
+  uint64_t front_id = 0;       // user data of the first request in the queue, the next ones follow it
+  unsigned unsubmitted = 0;    // requests put into the submission ring, but not taken by the kernel yet
+
+  void submit(const IoRequest& request, uint8_t opcode);
+
+  // Calls io_uring_enter until all new requests are submitted and min_complete requests are done.
+  // When the kernel can't take more requests now (EAGAIN or EBUSY), a request in flight is waited for first.
+  // Throws std::runtime_error if the system call failed
+  void enter(unsigned min_complete);
+
+  // Number of requests taken by the kernel and not done yet.
+  size_t get_in_flight_count();
+
+  // Marks completed requests as done.
+  void reap();
+
+  void release();
+
+public:
+  // Throws std::runtime_error if io_uring could not be set up, e.g. on old kernels or when it is not allowed
+  UringQueue(size_t depth);
+  ~UringQueue();
+
+  void submit_read(InputFile& file, uint64_t pos, uint8_t* bytes, size_t byte_count);
+  void submit_write(OutputFile& file, uint64_t pos, const uint8_t* bytes, size_t byte_count);
+  void wait();
+  size_t get_pending_count();
+  const char* get_name();
+};
+
+UringQueue::UringQueue(size_t depth)
+{
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  ring_fd = (int)syscall(__NR_io_uring_setup, (unsigned)depth, &params);
+  if (ring_fd < 0)
+  {
+    throw std::runtime_error("Error: io_uring could not be set up: " + std::string(std::strerror(errno)) + ".");
+  }
+
+  // Kernels with single mmap map both rings at once
+  sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+  {
+    sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+  }
+  sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+  void* sq_map = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                      IORING_OFF_SQ_RING);
+  void* cq_map = sq_map;
+  if (sq_map != MAP_FAILED && !(params.features & IORING_FEAT_SINGLE_MMAP))
+  {
+    cq_map = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd,
+                  IORING_OFF_CQ_RING);
+  }
+  void* sqes_map = MAP_FAILED;
+  if (cq_map != MAP_FAILED)
+  {
+    sqes_map = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  }
+  sq_ring = sq_map != MAP_FAILED ? (uint8_t*)sq_map : nullptr;
+  cq_ring = cq_map != MAP_FAILED ? (uint8_t*)cq_map : nullptr;
+  sqes = sqes_map != MAP_FAILED ? (io_uring_sqe*)sqes_map : nullptr;
+  if (sqes == nullptr)
+  {
+    std::string reason = std::strerror(errno);
+    release();
+    throw std::runtime_error("Error: io_uring rings could not be mapped: " + reason + ".");
+  }
+
+  sq_tail = (unsigned*)(sq_ring + params.sq_off.tail);
+  sq_mask = (unsigned*)(sq_ring + params.sq_off.ring_mask);
+  sq_array = (unsigned*)(sq_ring + params.sq_off.array);
+  cq_head = (unsigned*)(cq_ring + params.cq_off.head);
+  cq_tail = (unsigned*)(cq_ring + params.cq_off.tail);
+  cq_mask = (unsigned*)(cq_ring + params.cq_off.ring_mask);
+  cqes = (io_uring_cqe*)(cq_ring + params.cq_off.cqes);
+}
+
+// The kernel may still write into bytes of pending requests, so they are waited for before the rings are gone.
+UringQueue::~UringQueue()
+{
+  while (true)
+  {
+    reap();
+    size_t done_count = 0;
+    while (done_count < requests.size() && requests[done_count].request.done)
+    {
+      done_count++;
+    }
+    if (done_count == requests.size())
+    {
+      break;
+    }
+    try
+    {
+      enter(1);
+    }
+    catch (const std::exception&)
+    {
+      break;
+    }
+  }
+  release();
+}
+
+void UringQueue::release()
+{
+  if (sqes != nullptr)
+  {
+    munmap(sqes, sqes_size);
+  }
+  if (cq_ring != nullptr && cq_ring != sq_ring)
+  {
+    munmap(cq_ring, cq_ring_size);
+  }
+  if (sq_ring != nullptr)
+  {
+    munmap(sq_ring, sq_ring_size);
+  }
+  if (ring_fd >= 0)
+  {
+    close(ring_fd);
+  }
+}
+
+void UringQueue::submit(const IoRequest& request, uint8_t opcode)
+{
+  requests.push_back({ request, { request.bytes, request.byte_count }, 0 });
+  UringRequest& uring_request = requests.back();
+
+  // Only this thread writes the submission tail, the kernel reads it after the entry is filled
+  unsigned tail = *sq_tail;
+  unsigned idx = tail & *sq_mask;
+  io_uring_sqe& sqe = sqes[idx];
+  std::memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = opcode;
+  sqe.fd = request.infile != nullptr ? request.infile->get_fd() : request.outfile->get_fd();
+  sqe.addr = (uint64_t)&uring_request.iov;
+  sqe.len = 1;
+  sqe.off = request.pos;
+  sqe.user_data = front_id + requests.size() - 1;
+  sq_array[idx] = idx;
+  __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+  unsubmitted++;
+
+  enter(0);
+}
+
+void UringQueue::enter(unsigned min_complete)
+{
+  while (true)
+  {
+    int result = (int)syscall(__NR_io_uring_enter, ring_fd, unsubmitted, min_complete,
+                              min_complete > 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    if (result >= 0)
+    {
+      unsubmitted -= std::min<unsigned>(result, unsubmitted);
+      if (unsubmitted == 0)
+      {
+        return;
+      }
+    }
+    else if (errno == EINTR)
+    {
+      continue;
+    }
+    else if (errno != EAGAIN && errno != EBUSY)
+    {
+      throw std::runtime_error("Error: io_uring request failed: " + std::string(std::strerror(errno)) + ".");
+    }
+
+    // The kernel took only some of the requests or none. Completion of a request in flight frees
+    // what the kernel lacks, without any the call is just repeated
+    reap();
+    if (get_in_flight_count() > 0)
+    {
+      syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      reap();
+    }
+    else
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+size_t UringQueue::get_in_flight_count()
+{
+  size_t pending_count = 0;
+  for (const UringRequest& uring_request : requests)
+  {
+    pending_count += !uring_request.request.done;
+  }
+  return pending_count - unsubmitted;
+}
+
+void UringQueue::reap()
+{
+  unsigned head = *cq_head;
+  unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+  for (; head != tail; head++)
+  {
+    const io_uring_cqe& cqe = cqes[head & *cq_mask];
+    UringRequest& uring_request = requests[cqe.user_data - front_id];
+    uring_request.result = cqe.res;
+    uring_request.request.done = true;
+  }
+  __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+void UringQueue::submit_read(InputFile& file, uint64_t pos, uint8_t* bytes, size_t byte_count)
+{
+  submit({ &file, nullptr, pos, bytes, byte_count, false }, IORING_OP_READV);
+}
+
+void UringQueue::submit_write(OutputFile& file, uint64_t pos, const uint8_t* bytes, size_t byte_count)
+{
+  submit({ nullptr, &file, pos, (uint8_t*)bytes, byte_count, false }, IORING_OP_WRITEV);
+}
+
+void UringQueue::wait()
+{
+  reap();
+  while (!requests.front().request.done)
+  {
+    enter(1);
+    reap();
+  }
+
+  IoRequest request = requests.front().request;
+  int32_t result = requests.front().result;
+  requests.pop_front();
+  front_id++;
+
+  // The rest of a short or failed request is done in place, so errors are reported by the files
+  size_t done_count = result > 0 ? (size_t)result : 0;
+  if (done_count < request.byte_count)
+  {
+    request.pos += done_count;
+    request.bytes += done_count;
+    request.byte_count -= done_count;
+    run_request(request);
+  }
+}
+
+size_t UringQueue::get_pending_count()
+{
+  return requests.size();
+}
+
+const char* UringQueue::get_name()
+{
+  return "io_uring";
+}
+
+#endif
+
+
+/* Header functions */
+
+std::unique_ptr<IoQueue> make_io_queue(size_t depth)
+{
+#ifdef HAVE_IO_URING
+  try
+  {
+    return std::unique_ptr<IoQueue>(new UringQueue(depth));
+  }
+  catch (const std::runtime_error&)
+  {
+    // Kernel without io_uring or a sandbox that does not allow it
+  }
+#else
+  (void)depth;  // the thread queue keeps one request in flight
+#endif
+  return std::unique_ptr<IoQueue>(new ThreadQueue());
+}
+
+
+/* Support functions implementation */
+
+void run_request(const IoRequest& request)
+{
+  if (request.infile != nullptr)
+  {
+    request.infile->read_at(request.pos, request.bytes, request.byte_count);
+  }
+  else
+  {
+    request.outfile->write_at(request.pos, request.bytes, request.byte_count);
+  }
+}
@@ -0,0 +1,44 @@
+#ifndef IOQUEUE_H
+#define IOQUEUE_H
+
+#include "readfile.h"
+#include "writefile.h"
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+// Queue of asynchronous reads and writes of blocks at explicit file positions.
+// Requests run in the background while the caller works on other blocks,
+// and the caller waits for them in the order they were submitted.
+// Bytes of a request must stay in place and the file must stay open until the request is waited for.
+// The queue is meant to have one owner that submits requests and waits for them.
+// Destroying the queue waits for all requests in it.
+class IoQueue
+{
+public:
+  virtual ~IoQueue() {}
+
+  // Starts reading byte_count bytes at pos of file into bytes.
+  virtual void submit_read(InputFile& file, uint64_t pos, uint8_t* bytes, size_t byte_count) = 0;
+
+  // Starts writing byte_count bytes to pos of file.
+  virtual void submit_write(OutputFile& file, uint64_t pos, const uint8_t* bytes, size_t byte_count) = 0;
+
+  // Waits until the oldest request is done and removes it from the queue.
+  // Throws std::runtime_error if the request failed, e.g. when the file ended or the disk is full
+  virtual void wait() = 0;
+
+  // Number of requests submitted and not waited for.
+  virtual size_t get_pending_count() = 0;
+
+  // Name of the implementation, "io_uring" or "thread".
+  virtual const char* get_name() = 0;
+};
+
+// Makes queue for up to depth pending requests: the caller waits for the oldest one before submitting more.
+// io_uring is used where the kernel has it (Linux 5.1 and later) and allows it,
+// otherwise the requests are done one after another by a thread of the queue.
+std::unique_ptr<IoQueue> make_io_queue(size_t depth);
+
+#endif
@@ -0,0 +1,238 @@
+#include "local-socket.h"
+
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+LocalServer::LocalServer(const char* /*socket_path*/)
+{
+  throw std::runtime_error("Error: Local sockets are not supported on Windows.");
+}
+
+LocalServer::~LocalServer()
+{
+}
+
+int LocalServer::accept_connection()
+{
+  return -1;
+}
+
+void LocalServer::stop()
+{
+}
+
+LocalConnection::LocalConnection(LocalServer& server, int fd) : server(server), fd(fd)
+{
+}
+
+LocalConnection::~LocalConnection()
+{
+}
+
+bool LocalConnection::read_line(std::string& /*line*/)
+{
+  return false;
+}
+
+void LocalConnection::write_line(const std::string& /*text*/)
+{
+}
+
+#else
+
+/* Support functions */
+
+// Makes address of the socket at socket_path.
+// Throws std::runtime_error if the path is too long for a socket address.
+sockaddr_un socket_address(const std::string& socket_path)
+{
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socket_path.size() >= sizeof(address.sun_path))
+  {
+    throw std::runtime_error("Error: Socket path '" + socket_path + "' is too long.");
+  }
+  memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+  return address;
+}
+
+// Returns true if a server accepts connections at socket_path.
+bool server_is_running(const sockaddr_un& address)
+{
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1)
+  {
+    return false;
+  }
+  bool connected = connect(fd, (const sockaddr*)&address, sizeof(address)) == 0;
+  close(fd);
+  return connected;
+}
+
+
+/* LocalServer implementation */
+
+LocalServer::LocalServer(const char* socket_path) : socket_path(socket_path)
+{
+  sockaddr_un address = socket_address(this->socket_path);
+
+  struct stat results;
+  if (lstat(socket_path, &results) == 0)
+  {
+    if (!S_ISSOCK(results.st_mode))
+    {
+      throw std::runtime_error("Error: '" + this->socket_path + "' exists and is not a socket.");
+    }
+    if (server_is_running(address))
+    {
+      throw std::runtime_error("Error: Socket '" + this->socket_path + "' is used by a running server.");
+    }
+    unlink(socket_path);
+  }
+
+  fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd == -1)
+  {
+    throw std::runtime_error("Error: Socket could not be made: " + std::string(strerror(errno)));
+  }
+  if (bind(fd, (const sockaddr*)&address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+  {
+    std::string reason = strerror(errno);
+    close(fd);
+    throw std::runtime_error("Error: Socket '" + this->socket_path + "' could not be listened: " + reason);
+  }
+}
+
+LocalServer::~LocalServer()
+{
+  close(fd);
+  unlink(socket_path.c_str());
+}
+
+int LocalServer::accept_connection()
+{
+  while (true)
+  {
+    int connection_fd = accept(fd, nullptr, nullptr);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopped)
+    {
+      if (connection_fd != -1)
+      {
+        close(connection_fd);
+      }
+      return -1;
+    }
+    if (connection_fd != -1)
+    {
+      connection_fds.insert(connection_fd);
+      return connection_fd;
+    }
+    if (errno != EINTR && errno != ECONNABORTED)
+    {
+      throw std::runtime_error("Error: Failed to accept connection: " + std::string(strerror(errno)));
+    }
+  }
+}
+
+// Shutdown of the listening socket wakes up the thread waiting in accept().
+void LocalServer::stop()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  stopped = true;
+  shutdown(fd, SHUT_RDWR);
+  for (int connection_fd : connection_fds)
+  {
+    shutdown(connection_fd, SHUT_RD);
+  }
+}
+
+
+/* LocalConnection implementation */
+
+LocalConnection::LocalConnection(LocalServer& server, int fd) : server(server), fd(fd)
+{
+}
+
+LocalConnection::~LocalConnection()
+{
+  std::lock_guard<std::mutex> lock(server.mutex);
+  server.connection_fds.erase(fd);
+  close(fd);
+}
+
+bool LocalConnection::read_line(std::string& line)
+{
+  size_t line_end;
+  while ((line_end = buffer.find('\n')) == std::string::npos)
+  {
+    if (buffer.size() > MAX_LINE_BYTES)
+    {
+      throw std::runtime_error("Error: Line is longer than " + std::to_string(MAX_LINE_BYTES) + " bytes.");
+    }
+
+    char bytes[4096];
+    ssize_t count = recv(fd, bytes, sizeof(bytes), 0);
+    if (count == -1 && errno == EINTR)
+    {
+      continue;
+    }
+    if (count == -1)
+    {
+      throw std::runtime_error("Error: Failed to read from connection: " + std::string(strerror(errno)));
+    }
+    if (count == 0)
+    {
+      if (buffer.empty())
+      {
+        return false;
+      }
+      line_end = buffer.size();
+      buffer += '\n';
+      break;
+    }
+    buffer.append(bytes, count);
+  }
+
+  line = buffer.substr(0, line_end);
+  buffer.erase(0, line_end + 1);
+  if (!line.empty() && line.back() == '\r')
+  {
+    line.pop_back();
+  }
+  return true;
+}
+
+// MSG_NOSIGNAL keeps the process alive when the client is gone, the error is returned instead of SIGPIPE.
+void LocalConnection::write_line(const std::string& text)
+{
+  std::string bytes = text + '\n';
+  size_t written = 0;
+  while (written < bytes.size())
+  {
+    ssize_t count = send(fd, bytes.data() + written, bytes.size() - written, MSG_NOSIGNAL);
+    if (count == -1 && errno == EINTR)
+    {
+      continue;
+    }
+    if (count == -1)
+    {
+      throw std::runtime_error("Error: Failed to write to connection: " + std::string(strerror(errno)));
+    }
+    written += count;
+  }
+}
+
+#endif
@@ -0,0 +1,73 @@
+#ifndef LOCALSOCKET_H
+#define LOCALSOCKET_H
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <cstddef>
+
+// Maximal length of one line read from a connection.
+const size_t MAX_LINE_BYTES = 1 << 16;
+
+class LocalConnection;
+
+// Listening Unix domain socket at a file path.
+// A stale socket file left by a server that is not running any more is replaced,
+// a socket with a running server is not.
+// The socket file is removed when the server is destroyed.
+//
+// Throws std::runtime_error if the socket could not be made or is already used by a running server
+// Throws std::runtime_error on Windows, where local sockets are not supported
+class LocalServer
+{
+private:
+  std::string socket_path;
+  int fd = -1;
+  bool stopped = false;
+  std::set<int> connection_fds;  // open connections, closed for reading on stop()
+  std::mutex mutex;
+
+  friend class LocalConnection;
+
+public:
+  LocalServer(const char* socket_path);
+  ~LocalServer();
+  LocalServer(const LocalServer&) = delete;
+  LocalServer& operator=(const LocalServer&) = delete;
+
+  // Waits for the next client. Returns -1 when the server is stopped,
+  // otherwise the descriptor of the connection, which is passed to LocalConnection.
+  // Throws std::runtime_error if accepting failed.
+  int accept_connection();
+
+  // Stops accepting clients and ends reading of open connections, their read_line() returns false.
+  // Can be called from any thread.
+  void stop();
+};
+
+// Connection of a client to LocalServer, which reads and writes lines of text.
+// The connection is closed when it is destroyed.
+class LocalConnection
+{
+private:
+  LocalServer& server;
+  int fd;
+  std::string buffer;  // bytes read after the last line
+
+public:
+  LocalConnection(LocalServer& server, int fd);
+  ~LocalConnection();
+  LocalConnection(const LocalConnection&) = delete;
+  LocalConnection& operator=(const LocalConnection&) = delete;
+
+  // Reads the next line without its end. Returns false when the client closed the connection
+  // or the server was stopped. The last line can end without a line break.
+  // Throws std::runtime_error if reading failed or the line is longer than MAX_LINE_BYTES.
+  bool read_line(std::string& line);
+
+  // Writes text and a line break.
+  // Throws std::runtime_error if the client closed the connection.
+  void write_line(const std::string& text);
+};
+
+#endif
@@ -3,31 +3,106 @@
 #include "printhex.h"
 #include "mode-options.h"
 #include "wav-header.h"
-#include "sound-effects.h"
+#include "wav-stream.h"
+#include "thread-pool.h"
+#include "stage-stats.h"
+#include "local-socket.h"
+#include "wavedit.h"
 
 #include <iostream>
 #include <string>
 #include <vector>
 #include <sstream>
+#include <chrono>
+#include <iomanip>
+#include <cmath>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <thread>
+#include <system_error>
+#include <set>
+#include <algorithm>
 #include <cstdint>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace modes
 {
   const std::string help = "help";
   const std::string hex = "hex";
   const std::string info = "info";
+  const std::string analyze = "analyze";
+  const std::string peaks = "peaks";
   const std::string trim = "trim";
   const std::string fade = "fade";
+  const std::string normalize = "normalize";
   const std::string reverb = "reverb";
+  const std::string freeverb = "freeverb";
+  const std::string chain = "chain";
+  const std::string batch = "batch";
+  const std::string serve = "serve";
+  const std::string shutdown = "shutdown";
+}
+
+// Options of the program that can be anywhere on the command line, they are taken out before the mode options are parsed.
+namespace flags
+{
+  // What to do with an existing output file: ask the user, replace it (--yes) or keep it (--no-clobber).
+  enum Replace { ASK, YES, NO_CLOBBER };
+
+  Replace replace = ASK;
+  bool in_place = false;  // --in-place: edit the mapped input file directly when the effect keeps its size
 }
 
 /* Support functions */
 
-// If file already exists, ask user if they want to rewrite it.
-// Returns true if file path is empty, or if user confirms rewriting.
-// Returns false if user denies rewriting.
+// If file already exists, ask user if they want to rewrite it, unless --yes or --no-clobber answers for them.
+// Returns true if file does not exist, or if user confirms rewriting.
+// Returns false if user denies rewriting or --no-clobber is passed.
+// Throws std::invalid_argument exception if the answer is needed, but input is not a terminal,
+// so an unattended run does not wait for it.
 bool check_for_replace_dialogue(const char* file_path);
 
+// Formats clip counts as numbers separated by spaces, one for every channel.
+std::string clip_counts_to_string(const std::vector<uint64_t>& clip_counts);
+
+// Runs one request line of serve mode and returns the reply: a JSON object with "status" "ok" and the results,
+// or with "status" "error" and the error "message". Output files are replaced without asking.
+// "shutdown" request stops server.
+std::string serve_request(const std::string& line, LocalServer& server);
+
+// Reads request lines of the connection till the client closes it or server is stopped.
+// Every request is run on the pool and its reply is written before the next line is read.
+void serve_connection(LocalServer& server, int connection_fd, ThreadPool& pool);
+
+// Applies effect like run_mode_effect() and returns the reply with the output path, wall time,
+// sizes of input and output files and clip counts.
+template <typename O>
+std::string serve_effect(const std::string& mode, O& options);
+
+// Analyzes input file of options and returns the reply with the statistics of every channel and integrated loudness.
+std::string serve_analyze(AnalyzeOptions& options);
+
+// Makes peak file of the input file of options and returns the reply with the output path, wall time
+// and sizes of input and output files.
+std::string serve_peaks(PeaksOptions& options);
+
+// Path of the peak file of options: the output path, or the input path with ".peaks" added.
+std::string peaks_path(PeaksOptions& options);
+
+// Formats level from 0 to 1 of full scale in dBFS with two decimals, or "-inf" for 0.
+std::string level_to_dbfs(double level);
+
+// Returns text as a JSON string in quotes.
+std::string json_string(const std::string& text);
+
 
 /* Mode functions */
 
@@ -46,14 +121,75 @@ void run_mode_info(InfoOptions& options);
 // Throws std::runtime_error if error while reading file
 void run_mode_hex(HexOptions& options);
 
+// Show peak, RMS, DC offset and clipped samples of every channel and integrated loudness of WAVE file.
+//
+// Throws std::invalid_argument exception if filePath does not exist or WAV header is invalid
+// Throws std::runtime_error if error while reading file
+void run_mode_analyze(AnalyzeOptions& options);
+
+// Make peak file of WAVE file for drawing its waveform, see peak-file.h.
+//
+// Throws std::invalid_argument exception if filePath does not exist or WAV header is invalid
+// Throws std::runtime_error if error while reading or writing files
+void run_mode_peaks(PeaksOptions& options);
+
 // Apply sound effect to file.
 // The effect is chosen based on the O type of the options.
 template <typename O>
 void run_mode_effect(O& options);
 
+// Apply chain of effects to many files on a pool of threads and print the throughput.
+// Errors of single files are printed and don't stop the batch.
+//
+// Throws std::invalid_argument exception if source does not exist
+// Throws std::runtime_error if output directory could not be created
+void run_mode_batch(BatchOptions& options);
+
+// Serve requests on a local socket with a pool of threads till "shutdown" request, see ServeOptions.
+// Every connection is read by its own thread, so clients waiting between requests do not hold the pool,
+// its requests are run on the pool one after another and every reply is one line of JSON, see serve_request().
+//
+// Throws std::runtime_error if the socket could not be listened
+void run_mode_serve(ServeOptions& options);
+
 
-int main(const int argc, const char* argv[])
+int main(const int all_argc, const char* all_argv[])
 {
+  // Stats and output options can be anywhere on the command line, they are taken out before the mode options are parsed
+  std::vector<const char*> args;
+  for (int idx = 0; idx < all_argc; idx++)
+  {
+    const std::string arg = all_argv[idx];
+    if (arg == "--stats" || arg == "--stats=text")
+    {
+      stats::enable(false);
+    }
+    else if (arg == "--stats=json")
+    {
+      stats::enable(true);
+    }
+    else if (arg == "--yes")
+    {
+      flags::replace = flags::YES;
+    }
+    else if (arg == "--no-clobber")
+    {
+      flags::replace = flags::NO_CLOBBER;
+    }
+    else if (arg == "--in-place")
+    {
+      flags::in_place = true;
+    }
+    else
+    {
+      args.push_back(all_argv[idx]);
+    }
+  }
+  const int argc = args.size();
+  // Like in the program command line, argv[argc] is a null pointer
+  args.push_back(nullptr);
+  const char** argv = &args[0];
+
   if (argc > 1)
   {
     const std::string mode = std::string(argv[1]);
@@ -73,6 +209,16 @@ int main(const int argc, const char* argv[])
         HexOptions options = HexOptions(argc, argv);
         run_mode_hex(options);
       }
+      else if (mode == modes::analyze)
+      {
+        AnalyzeOptions options = AnalyzeOptions(argc, argv);
+        run_mode_analyze(options);
+      }
+      else if (mode == modes::peaks)
+      {
+        PeaksOptions options = PeaksOptions(argc, argv);
+        run_mode_peaks(options);
+      }
       else if (mode == modes::trim)
       {
         TrimOptions options = TrimOptions(argc, argv);
@@ -83,11 +229,36 @@ int main(const int argc, const char* argv[])
         FadeOptions options = FadeOptions(argc, argv);
         run_mode_effect<FadeOptions>(options);
       }
+      else if (mode == modes::normalize)
+      {
+        NormalizeOptions options = NormalizeOptions(argc, argv);
+        run_mode_effect<NormalizeOptions>(options);
+      }
       else if (mode == modes::reverb)
       {
         ReverbOptions options = ReverbOptions(argc, argv);
         run_mode_effect<ReverbOptions>(options);
       }
+      else if (mode == modes::freeverb)
+      {
+        FreeverbOptions options = FreeverbOptions(argc, argv);
+        run_mode_effect<FreeverbOptions>(options);
+      }
+      else if (mode == modes::chain)
+      {
+        ChainOptions options = ChainOptions(argc, argv);
+        run_mode_effect<ChainOptions>(options);
+      }
+      else if (mode == modes::batch)
+      {
+        BatchOptions options = BatchOptions(argc, argv);
+        run_mode_batch(options);
+      }
+      else if (mode == modes::serve)
+      {
+        ServeOptions options = ServeOptions(argc, argv);
+        run_mode_serve(options);
+      }
       else
       {
         std::cerr << "Error: " << mode << " is an invalid mode. See 'wav-edit[.exe] help'.";
@@ -112,7 +283,18 @@ void run_mode_help()
 {
   std::cout
     << "USAGE:\n"
-    << "wav-edit[.exe] MODE [FILEPATH] [OPTIONS]...\n\n"
+    << "wav-edit[.exe] MODE [FILEPATH] [OPTIONS]...\n"
+    << "Modes that change samples print the number of clipped samples of every channel\n"
+    << "--stats = print time, bytes and speed of header parsing, reading, effect and writing with peak memory use\n"
+    << "    after analyze, peaks, trim, fade, normalize, reverb, freeverb, chain and batch modes, '--stats=json' prints them as a JSON object line\n"
+    << "Output is written to a temporary file in the output directory and renamed over the output file when complete,\n"
+    << "    links to the output are followed and the replaced file keeps its permissions and owner\n"
+    << "--yes = replace existing output files without asking, '--no-clobber' keeps them instead,\n"
+    << "    without these options the user is asked, and a run without terminal input stops with an error\n"
+    << "--in-place = edit the input file directly when it is the output and the effect keeps its size,\n"
+    << "    faster for large files, but a crash leaves the file half edited, it is needed when the directory is read-only\n"
+    << "TIME = time point or length: milliseconds (1500 or 1500.25ms), seconds (1.5s), frame index (66150smp)\n"
+    << "    or timecode [hours:]minutes:seconds[.fraction] (1:02:03.25), rounded to the nearest frame\n\n"
 
     << "MODE = help\n"
     << "    Will print this help\n\n"
@@ -125,27 +307,98 @@ void run_mode_help()
     << "    OPTIONS:\n"
     << "    -c = maximum number of bytes to print (256 by default)\n\n"
 
+    << "MODE = analyze FILEPATH\n"
+    << "    Will print peak, RMS, DC offset and number of full scale (clipped) samples of every channel\n"
+    << "    and integrated loudness by EBU R128 in one pass, the file is not changed\n"
+    << "    Loudness weighs channels by the speaker positions of WAVE_FORMAT_EXTENSIBLE channel mask:\n"
+    << "    side and back left and right surround channels by 1.41, LFE is not measured, other channels by 1,\n"
+    << "    all channels weigh 1 in files without a channel mask\n"
+    << "    OPTIONS:\n"
+    << "    -j = number of threads, 0 for one thread per CPU core (1 by default)\n\n"
+
+    << "MODE = peaks FILEPATH\n"
+    << "    Will write peak file with the lowest and the highest sample of every channel in buckets of frames,\n"
+    << "    and in levels of buckets twice as long up to the whole file, for drawing waveforms at any zoom\n"
+    << "    OPTIONS:\n"
+    << "    -b = frames of a bucket of the finest level (256 by default)\n"
+    << "    -j = number of threads, 0 for one thread per CPU core (1 by default)\n"
+    << "    -o = output file path (FILEPATH.peaks by default)\n\n"
+
     << "MODE = trim FILEPATH\n"
     << "    Will trim WAVE data from start point to end point\n"
     << "    OPTIONS:\n"
-    << "    -s = start point of the trimmed fragment in milliseconds (start of data by default)\n"
-    << "    -e = end point of the trimmed fragment in milliseconds (end of data by default)\n"
+    << "    -s = start point of the trimmed fragment, TIME (start of data by default)\n"
+    << "    -e = end point of the trimmed fragment, TIME (end of data by default)\n"
     << "    -o = output file path (same file by default)\n\n"
 
     << "MODE = fade FILEPATH\n"
     << "    Will add a 'fade away' effect with volume decreasing from start point to end point\n"
     << "    OPTIONS:\n"
-    << "    -s = start point of the effect in milliseconds (start of data by default)\n"
-    << "    -e = end point of the effect in milliseconds (end of data by default)\n"
+    << "    -s = start point of the effect, TIME (start of data by default)\n"
+    << "    -e = end point of the effect, TIME (end of data by default)\n"
     << "    -l = volume level at end point from 0 to 1 (0 by default)\n"
+    << "    -j = number of threads, 0 for one thread per CPU core (1 by default)\n"
+    << "    -o = output file path (same file by default)\n\n"
+
+    << "MODE = normalize FILEPATH\n"
+    << "    Will measure the file like analyze mode and change its volume by one gain to reach the target level\n"
+    << "    OPTIONS:\n"
+    << "    -m = 'loudness' to reach the target loudness with the peak not above the peak level,\n"
+    << "         'peak' to bring the peak to the peak level ('loudness' by default)\n"
+    << "    -l = target integrated loudness from -70 to 0 LUFS (-23 by default)\n"
+    << "    -p = peak level from -70 to 0 dBFS (-1 by default)\n"
+    << "    -j = number of threads, 0 for one thread per CPU core (1 by default)\n"
     << "    -o = output file path (same file by default)\n\n"
 
     << "MODE = reverb FILEPATH\n"
     << "    Will add a 'reverb' effect with selected delay and decay coefficient\n"
     << "    OPTIONS:\n"
-    << "    -d = reverb delay in milliseconds (1000 by default)\n"
+    << "    -d = reverb delay, TIME (1000 ms by default)\n"
     << "    -k = reverb decay coefficient from 0 to 1 (0.1 by default)\n"
-    << "    -o = output file path (same file by default)\n" << std::endl;
+    << "    -t = length of reverb tail added after the end of data, TIME (0 by default)\n"
+    << "    -o = output file path (same file by default)\n\n"
+
+    << "MODE = freeverb FILEPATH\n"
+    << "    Will add a room reverb made of parallel comb and series all-pass filters (Freeverb)\n"
+    << "    OPTIONS:\n"
+    << "    -r = room size from 0 to 1 (0.5 by default)\n"
+    << "    -p = damping of high frequencies from 0 to 1 (0.5 by default)\n"
+    << "    -w = reverb (wet) level from 0 to 1 (0.3 by default)\n"
+    << "    -y = original (dry) level from 0 to 1 (1 by default)\n"
+    << "    -t = length of reverb tail added after the end of data, TIME (0 by default)\n"
+    << "    -o = output file path (same file by default)\n\n"
+
+    << "MODE = chain FILEPATH [OPTIONS]... [EFFECT [EFFECT OPTIONS]...]...\n"
+    << "    Will apply trim, fade, reverb and freeverb effects one after another in a single pass\n"
+    << "    EFFECT is one of these modes with its options except -o, effects run on one thread,\n"
+    << "    time points of every effect are measured in the result of the effects before it\n"
+    << "    Samples are rounded only after the last effect, so the result can differ from running the effects\n"
+    << "    one by one by up to one LSB per effect, and more where samples between effects are above full scale\n"
+    << "    Example: wav-edit chain in.wav -o out.wav trim -s 500 fade -s 2000 reverb -d 250 -t 1000\n"
+    << "    OPTIONS:\n"
+    << "    -f = spec file with effects in the same form, '#' starts a comment (applied before command line effects)\n"
+    << "    -o = output file path (same file by default)\n\n"
+
+    << "MODE = batch SOURCE [OPTIONS]... [EFFECT [EFFECT OPTIONS]...]...\n"
+    << "    Will apply effects like chain mode to every WAVE file of SOURCE on several threads\n"
+    << "    SOURCE is a directory with *.wav files or a file with one input path per line\n"
+    << "    Output files are replaced without asking, unless --no-clobber is passed\n"
+    << "    Files with clipped samples are printed with the number of clipped samples of every channel\n"
+    << "    OPTIONS:\n"
+    << "    -d = output directory, files keep their names (required)\n"
+    << "    -j = number of threads, 0 for one thread per CPU core (0 by default)\n"
+    << "    -f = spec file with effects like in chain mode\n\n"
+
+    << "MODE = serve SOCKETPATH [OPTIONS]...\n"
+    << "    Will listen on Unix domain socket SOCKETPATH and run requests on several threads till 'shutdown' request\n"
+    << "    Every request is one line with info, analyze, peaks, trim, fade, normalize, reverb, freeverb or chain mode\n"
+    << "    and its arguments, paths with spaces are put in double quotes, relative paths start from the server directory\n"
+    << "    Every reply is one line of JSON with \"status\" \"ok\" or \"error\", effects reply with output path,\n"
+    << "    time, file sizes and clip counts, output files are replaced without asking,\n"
+    << "    analyze replies with the levels of every channel and integrated loudness, peaks with output path, time and sizes\n"
+    << "    Example: echo 'fade /data/in.wav -o /data/out.wav -s 500' | nc -U /tmp/wav-edit.sock\n"
+    << "    OPTIONS:\n"
+    << "    -j = number of requests run at the same time, 0 for one per CPU core (0 by default)\n" << std::endl;
 }
 
 void run_mode_info(InfoOptions& options)
@@ -167,46 +420,248 @@ void run_mode_hex(HexOptions& options)
   print_as_hex_columns(bytes, 16, options.max_print_count);
 }
 
-// Trim effect.
-void effect(std::vector<uint8_t>& bytes, TrimOptions& options)
+void run_mode_analyze(AnalyzeOptions& options)
 {
-  effects::trim(bytes, options);
-}
+  auto start_time = std::chrono::steady_clock::now();
+  stats::StageTimer header_timer(stats::HEADER);
+  WavReader reader(options.infile_path);
+  header_timer.stop(reader.get_header_bytes().size());
+  Analysis analysis = wavedit::analyze(reader, options);
+  double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
 
-// Fade effect.
-void effect(std::vector<uint8_t>& bytes, FadeOptions& options)
-{
-  effects::fade(bytes, options);
+  std::cout << std::left << std::setw(8) << "Channel" << std::right << std::setw(12) << "Peak, dBFS" << std::setw(12)
+            << "RMS, dBFS" << std::setw(12) << "DC offset" << std::setw(12) << "Clipped" << '\n';
+  for (size_t channel = 0; channel < analysis.channels.size(); channel++)
+  {
+    const ChannelAnalysis& result = analysis.channels[channel];
+    std::cout << std::left << std::setw(8) << channel << std::right << std::setw(12) << level_to_dbfs(result.peak)
+              << std::setw(12) << level_to_dbfs(result.rms) << std::setw(12) << std::fixed << std::setprecision(6)
+              << result.dc_offset << std::setw(12) << result.clip_count << '\n';
+  }
+  std::cout << "Integrated loudness, LUFS: ";
+  if (std::isinf(analysis.integrated_lufs))
+  {
+    std::cout << "-inf" << std::endl;
+  }
+  else
+  {
+    std::cout << std::setprecision(1) << analysis.integrated_lufs << std::endl;
+  }
+
+  if (stats::enabled)
+  {
+    stats::print(std::cout, wall_seconds);
+  }
 }
 
-// Reverb effect.
-void effect(std::vector<uint8_t>& bytes, ReverbOptions& options)
+void run_mode_peaks(PeaksOptions& options)
 {
-  effects::reverb(bytes, options);
+  std::string outfile_path = peaks_path(options);
+  auto start_time = std::chrono::steady_clock::now();
+  stats::StageTimer header_timer(stats::HEADER);
+  WavReader reader(options.infile_path);
+  header_timer.stop(reader.get_header_bytes().size());
+  auto header_time = std::chrono::steady_clock::now() - start_time;
+
+  if (!check_for_replace_dialogue(outfile_path.c_str()))
+  {
+    return;
+  }
+
+  start_time = std::chrono::steady_clock::now();
+  uint64_t byte_count = wavedit::peaks_file(options, reader, outfile_path.c_str());
+  double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time + header_time).count();
+  std::cout << "Peak file of " << byte_count << " bytes succesfully written to " << outfile_path << std::endl;
+
+  if (stats::enabled)
+  {
+    stats::print(std::cout, wall_seconds);
+  }
 }
 
 template <typename O>
 void run_mode_effect(O& options)
 {
   const char* outfile_path = options.out_flag ? options.outfile_path : options.infile_path;
-  std::vector<uint8_t> bytes = readfile(options.infile_path);
+  auto start_time = std::chrono::steady_clock::now();
+  stats::StageTimer header_timer(stats::HEADER);
+  WavReader reader(options.infile_path);
+  header_timer.stop(reader.get_header_bytes().size());
+  auto header_time = std::chrono::steady_clock::now() - start_time;
+
+  if (!check_for_replace_dialogue(outfile_path))
+  {
+    return;
+  }
 
-  // Effect function is selected based on options type
-  effect(bytes, options);
+  // Wall time does not include waiting for the answer of the user
+  start_time = std::chrono::steady_clock::now();
+  std::vector<uint64_t> clip_counts;
+  bool in_place = wavedit::edit_file(options, reader, outfile_path, clip_counts, flags::in_place);
+  double wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time + header_time).count();
 
-  if (check_for_replace_dialogue(outfile_path))
+  if (in_place)
+  {
+    std::cout << "WAVE file succesfully edited in place " << outfile_path << std::endl;
+  }
+  else
   {
-    writefile(bytes, outfile_path);
     std::cout << "WAVE file succesfully edited and written to " << outfile_path << std::endl;
   }
+
+  if (!clip_counts.empty())
+  {
+    std::cout << "Clipped samples per channel: " << clip_counts_to_string(clip_counts) << std::endl;
+  }
+
+  if (stats::enabled)
+  {
+    stats::print(std::cout, wall_seconds);
+  }
 };
 
+void run_mode_batch(BatchOptions& options)
+{
+  make_directory(options.outdir_path);
+  ThreadPool pool(options.thread_count);
+
+  std::mutex mutex;
+  size_t done_count = 0;
+  uint64_t byte_count = 0;
+  std::set<std::string> outfile_paths;
+  auto start_time = std::chrono::steady_clock::now();
+
+  for (const std::string& infile_path : options.infile_paths)
+  {
+    std::string name = infile_path.substr(infile_path.find_last_of("/\\") + 1);
+    std::string outfile_path = std::string(options.outdir_path) + "/" + name;
+    if (!outfile_paths.insert(outfile_path).second)
+    {
+      std::cerr << infile_path << ": Error: Output file '" << outfile_path << "' is already written by this batch.\n";
+      continue;
+    }
+    if (flags::replace == flags::NO_CLOBBER && file_exists(outfile_path.c_str()))
+    {
+      std::cerr << infile_path << ": Output file '" << outfile_path << "' already exists and is kept (--no-clobber).\n";
+      continue;
+    }
+
+    // Every file gets its own copy of options with its input path
+    pool.submit([&options, &mutex, &done_count, &byte_count, infile_path, outfile_path]()
+    {
+      try
+      {
+        ChainOptions chain = options.chain;
+        chain.infile_path = infile_path.c_str();
+        uint64_t file_size = get_file_size(chain.infile_path);
+        stats::StageTimer header_timer(stats::HEADER);
+        WavReader reader(chain.infile_path);
+        header_timer.stop(reader.get_header_bytes().size());
+        std::vector<uint64_t> clip_counts;
+        wavedit::edit_file(chain, reader, outfile_path.c_str(), clip_counts);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        done_count++;
+        byte_count += file_size;
+        // Only files with clipped samples are reported, so a clean batch prints nothing but the summary
+        if (std::any_of(clip_counts.begin(), clip_counts.end(), [](uint64_t count) { return count > 0; }))
+        {
+          std::cout << infile_path << ": Clipped samples per channel: " << clip_counts_to_string(clip_counts) << '\n';
+        }
+      }
+      catch (const std::exception& e)
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::cerr << infile_path << ": " << e.what() << '\n';
+      }
+    });
+  }
+  pool.wait();
+
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+  std::cout << "Processed " << done_count << " of " << options.infile_paths.size() << " files ("
+            << byte_count / 1e6 << " MB) in " << seconds << " s on " << pool.get_thread_count() << " threads: "
+            << done_count / seconds << " files/s, " << byte_count / 1e6 / seconds << " MB/s" << std::endl;
+
+  // Stage times are summed over all threads, so they can be longer than the wall time
+  if (stats::enabled)
+  {
+    stats::print(std::cout, seconds);
+  }
+}
+
+void run_mode_serve(ServeOptions& options)
+{
+  LocalServer server(options.socket_path);
+
+  // Requests run only on the workers of the pool, the calling thread of the pool accepts connections,
+  // so the pool has one thread more than the requests run at the same time
+  size_t request_count = options.thread_count > 0 ? options.thread_count : std::max(1u, std::thread::hardware_concurrency());
+  ThreadPool pool(request_count + 1);
+  std::cout << "Serving requests on " << options.socket_path << " with " << request_count << " threads" << std::endl;
+
+  std::mutex mutex;
+  std::condition_variable connection_closed;
+  size_t connection_count = 0;
+
+  int connection_fd;
+  while ((connection_fd = server.accept_connection()) != -1)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    try
+    {
+      std::thread([&server, &pool, &mutex, &connection_closed, &connection_count, connection_fd]()
+      {
+        serve_connection(server, connection_fd, pool);
+
+        // Notified under the lock, so the server waiting below is not gone before this thread stops using it
+        std::lock_guard<std::mutex> lock(mutex);
+        connection_count--;
+        connection_closed.notify_all();
+      }).detach();
+      connection_count++;
+    }
+    catch (const std::system_error& e)
+    {
+      LocalConnection connection(server, connection_fd);
+      try
+      {
+        connection.write_line("{\"status\":\"error\",\"message\":" + json_string("Error: " + std::string(e.what())) + "}");
+      }
+      catch (const std::exception&)
+      {
+      }
+    }
+  }
+
+  // Stopped server ended reading of all connections, their threads finish the running requests
+  std::unique_lock<std::mutex> lock(mutex);
+  connection_closed.wait(lock, [&connection_count] { return connection_count == 0; });
+  std::cout << "Server is stopped" << std::endl;
+}
+
 /* Support functions implementation */
 
 bool check_for_replace_dialogue(const char* file_path)
 {
-  if (file_exists(file_path))
+  if (file_exists(file_path) && flags::replace != flags::YES)
   {
+    if (flags::replace == flags::NO_CLOBBER)
+    {
+      std::cout << "File " << file_path << " already exists and is kept (--no-clobber)" << std::endl;
+      return false;
+    }
+#ifdef _WIN32
+    bool interactive = _isatty(_fileno(stdin));
+#else
+    bool interactive = isatty(STDIN_FILENO);
+#endif
+    if (!interactive)
+    {
+      throw std::invalid_argument("Error: File " + std::string(file_path) +
+                                  " already exists. Pass --yes to replace it or --no-clobber to keep it.");
+    }
+
     std::string answer;
     std::cout << "File " << file_path << " already exists. Would you like to replace it (y/n)?: ";
     std::getline(std::cin, answer);
@@ -217,3 +672,260 @@ bool check_for_replace_dialogue(const char* file_path)
   }
   return true;
 }
+
+std::string clip_counts_to_string(const std::vector<uint64_t>& clip_counts)
+{
+  std::string text;
+  for (size_t channel = 0; channel < clip_counts.size(); channel++)
+  {
+    text += (channel > 0 ? " " : "") + std::to_string(clip_counts[channel]);
+  }
+  return text;
+}
+
+std::string serve_request(const std::string& line, LocalServer& server)
+{
+  try
+  {
+    ArgList args(ArgList::split_line(line));
+    int argc = args.get_argc();
+    const char** argv = args.get_argv();
+    const std::string mode = argv[1];
+
+    if (mode == modes::info)
+    {
+      InfoOptions options = InfoOptions(argc, argv);
+      WavHeader header = WavHeader(options.infile_path);
+      if (!header.check_validity())
+      {
+        throw std::invalid_argument("Error: This is not a correct WAV file.");
+      }
+      return "{\"status\":\"ok\",\"mode\":\"info\",\"info\":" + json_string(header.to_string()) + "}";
+    }
+    else if (mode == modes::analyze)
+    {
+      AnalyzeOptions options = AnalyzeOptions(argc, argv);
+      return serve_analyze(options);
+    }
+    else if (mode == modes::peaks)
+    {
+      PeaksOptions options = PeaksOptions(argc, argv);
+      return serve_peaks(options);
+    }
+    else if (mode == modes::trim)
+    {
+      TrimOptions options = TrimOptions(argc, argv);
+      return serve_effect(mode, options);
+    }
+    else if (mode == modes::fade)
+    {
+      FadeOptions options = FadeOptions(argc, argv);
+      return serve_effect(mode, options);
+    }
+    else if (mode == modes::normalize)
+    {
+      NormalizeOptions options = NormalizeOptions(argc, argv);
+      return serve_effect(mode, options);
+    }
+    else if (mode == modes::reverb)
+    {
+      ReverbOptions options = ReverbOptions(argc, argv);
+      return serve_effect(mode, options);
+    }
+    else if (mode == modes::freeverb)
+    {
+      FreeverbOptions options = FreeverbOptions(argc, argv);
+      return serve_effect(mode, options);
+    }
+    else if (mode == modes::chain)
+    {
+      ChainOptions options = ChainOptions(argc, argv);
+      return serve_effect(mode, options);
+    }
+    else if (mode == modes::shutdown)
+    {
+      server.stop();
+      return "{\"status\":\"ok\",\"mode\":\"shutdown\"}";
+    }
+    throw std::invalid_argument("Error: " + mode + " is an invalid request mode.");
+  }
+  catch (const std::exception& e)
+  {
+    return "{\"status\":\"error\",\"message\":" + json_string(e.what()) + "}";
+  }
+}
+
+void serve_connection(LocalServer& server, int connection_fd, ThreadPool& pool)
+{
+  LocalConnection connection(server, connection_fd);
+  try
+  {
+    std::string line;
+    while (connection.read_line(line))
+    {
+      if (line.find_first_not_of(" \t") == std::string::npos)
+      {
+        continue;
+      }
+
+      // Promise is shared with the task, so it outlives set_value() even if the reply is written before it returns
+      std::shared_ptr<std::promise<std::string>> reply = std::make_shared<std::promise<std::string>>();
+      std::future<std::string> reply_future = reply->get_future();
+      pool.submit([&server, reply, line]()
+      {
+        reply->set_value(serve_request(line, server));
+      });
+      connection.write_line(reply_future.get());
+    }
+  }
+  catch (const std::exception& e)
+  {
+    // The connection is broken or the client sent a too long line, so it is closed
+    try
+    {
+      connection.write_line("{\"status\":\"error\",\"message\":" + json_string(e.what()) + "}");
+    }
+    catch (const std::exception&)
+    {
+    }
+  }
+}
+
+template <typename O>
+std::string serve_effect(const std::string& mode, O& options)
+{
+  const char* outfile_path = options.out_flag ? options.outfile_path : options.infile_path;
+  auto start_time = std::chrono::steady_clock::now();
+  uint64_t in_bytes = get_file_size(options.infile_path);
+
+  WavReader reader(options.infile_path);
+  std::vector<uint64_t> clip_counts;
+  bool in_place = wavedit::edit_file(options, reader, outfile_path, clip_counts);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  std::ostringstream reply;
+  reply << "{\"status\":\"ok\",\"mode\":\"" << mode << "\",\"output\":" << json_string(outfile_path)
+        << ",\"in_place\":" << (in_place ? "true" : "false") << ",\"seconds\":" << seconds
+        << ",\"in_bytes\":" << in_bytes << ",\"out_bytes\":" << get_file_size(outfile_path) << ",\"clip_counts\":[";
+  for (size_t channel = 0; channel < clip_counts.size(); channel++)
+  {
+    reply << (channel > 0 ? "," : "") << clip_counts[channel];
+  }
+  reply << "]}";
+  return reply.str();
+}
+
+// JSON has no infinity, so levels of silence and loudness below the gate are null.
+std::string serve_analyze(AnalyzeOptions& options)
+{
+  WavReader reader(options.infile_path);
+  Analysis analysis = wavedit::analyze(reader, options);
+
+  std::ostringstream reply;
+  reply << std::setprecision(9) << "{\"status\":\"ok\",\"mode\":\"analyze\",\"frames\":" << analysis.frame_count
+        << ",\"integrated_lufs\":";
+  if (std::isinf(analysis.integrated_lufs))
+  {
+    reply << "null";
+  }
+  else
+  {
+    reply << analysis.integrated_lufs;
+  }
+  reply << ",\"channels\":[";
+  for (size_t channel = 0; channel < analysis.channels.size(); channel++)
+  {
+    const ChannelAnalysis& result = analysis.channels[channel];
+    reply << (channel > 0 ? "," : "") << "{\"peak\":" << result.peak << ",\"peak_dbfs\":";
+    if (result.peak > 0.)
+    {
+      reply << 20. * std::log10(result.peak);
+    }
+    else
+    {
+      reply << "null";
+    }
+    reply << ",\"rms\":" << result.rms << ",\"rms_dbfs\":";
+    if (result.rms > 0.)
+    {
+      reply << 20. * std::log10(result.rms);
+    }
+    else
+    {
+      reply << "null";
+    }
+    reply << ",\"dc_offset\":" << result.dc_offset << ",\"clip_count\":" << result.clip_count << "}";
+  }
+  reply << "]}";
+  return reply.str();
+}
+
+std::string serve_peaks(PeaksOptions& options)
+{
+  std::string outfile_path = peaks_path(options);
+  auto start_time = std::chrono::steady_clock::now();
+  uint64_t in_bytes = get_file_size(options.infile_path);
+
+  WavReader reader(options.infile_path);
+  uint64_t out_bytes = wavedit::peaks_file(options, reader, outfile_path.c_str());
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+  std::ostringstream reply;
+  reply << "{\"status\":\"ok\",\"mode\":\"peaks\",\"output\":" << json_string(outfile_path)
+        << ",\"seconds\":" << seconds << ",\"in_bytes\":" << in_bytes << ",\"out_bytes\":" << out_bytes << "}";
+  return reply.str();
+}
+
+std::string peaks_path(PeaksOptions& options)
+{
+  return options.out_flag ? std::string(options.outfile_path) : std::string(options.infile_path) + ".peaks";
+}
+
+std::string level_to_dbfs(double level)
+{
+  if (level <= 0.)
+  {
+    return "-inf";
+  }
+  std::ostringstream text;
+  text << std::fixed << std::setprecision(2) << 20. * std::log10(level);
+  return text.str();
+}
+
+std::string json_string(const std::string& text)
+{
+  std::string quoted = "\"";
+  for (char symbol : text)
+  {
+    switch (symbol)
+    {
+    case '"':
+      quoted += "\\\"";
+      break;
+    case '\\':
+      quoted += "\\\\";
+      break;
+    case '\n':
+      quoted += "\\n";
+      break;
+    case '\t':
+      quoted += "\\t";
+      break;
+    case '\r':
+      quoted += "\\r";
+      break;
+    default:
+      if ((unsigned char)symbol < 0x20)
+      {
+        char escaped[8];
+        std::snprintf(escaped, sizeof(escaped), "\\u%04x", symbol);
+        quoted += escaped;
+      }
+      else
+      {
+        quoted += symbol;
+      }
+    }
+  }
+  return quoted + "\"";
+}
@@ -0,0 +1,129 @@
+#include "mapped-file.h"
+#include "stage-stats.h"
+
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char* file_path)
+{
+  file_handle = CreateFileA(file_path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file_handle == INVALID_HANDLE_VALUE)
+  {
+    throw std::invalid_argument("Error: File path '" + std::string(file_path) + "' could not be opened.");
+  }
+
+  LARGE_INTEGER file_size;
+  GetFileSizeEx(file_handle, &file_size);
+  size = (size_t)file_size.QuadPart;
+
+  if (size > 0)
+  {
+    mapping_handle = CreateFileMappingA(file_handle, NULL, PAGE_READWRITE, 0, 0, NULL);
+    if (mapping_handle != NULL)
+    {
+      data = (uint8_t*)MapViewOfFile(mapping_handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    }
+    if (data == nullptr)
+    {
+      if (mapping_handle != NULL)
+      {
+        CloseHandle(mapping_handle);
+      }
+      CloseHandle(file_handle);
+      throw std::runtime_error("Error: File '" + std::string(file_path) + "' could not be mapped to memory.");
+    }
+  }
+}
+
+MappedFile::~MappedFile()
+{
+  if (data != nullptr)
+  {
+    UnmapViewOfFile(data);
+    CloseHandle(mapping_handle);
+  }
+  CloseHandle(file_handle);
+}
+
+void MappedFile::flush()
+{
+  stats::StageTimer write_timer(stats::WRITE);
+  if (data != nullptr && (!FlushViewOfFile(data, 0) || !FlushFileBuffers(file_handle)))
+  {
+    throw std::runtime_error("Error: Failed to write changes of mapped file.");
+  }
+  write_timer.stop(0);
+}
+
+#else
+
+MappedFile::MappedFile(const char* file_path)
+{
+  fd = open(file_path, O_RDWR);
+  if (fd == -1)
+  {
+    throw std::invalid_argument("Error: File path '" + std::string(file_path) + "' could not be opened.");
+  }
+
+  struct stat results;
+  if (fstat(fd, &results) != 0)
+  {
+    close(fd);
+    throw std::runtime_error("Error: Couldn't get stat file size.");
+  }
+  size = results.st_size;
+
+  if (size > 0)
+  {
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+      close(fd);
+      throw std::runtime_error("Error: File '" + std::string(file_path) + "' could not be mapped to memory.");
+    }
+    data = (uint8_t*)mapping;
+  }
+}
+
+MappedFile::~MappedFile()
+{
+  if (data != nullptr)
+  {
+    munmap(data, size);
+  }
+  close(fd);
+}
+
+void MappedFile::flush()
+{
+  stats::StageTimer write_timer(stats::WRITE);
+  if (data != nullptr && msync(data, size, MS_SYNC) != 0)
+  {
+    throw std::runtime_error("Error: Failed to write changes of mapped file.");
+  }
+  write_timer.stop(0);
+}
+
+#endif
+
+uint8_t* MappedFile::get_data()
+{
+  return data;
+}
+
+size_t MappedFile::get_size()
+{
+  return size;
+}
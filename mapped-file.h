@@ -0,0 +1,39 @@
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Read-write memory mapping of a whole file.
+// Only the pages that are accessed are read, and only the changed pages are written back to the file.
+//
+// Throws std::invalid_argument exception if file_path could not be opened
+// Throws std::runtime_error if file could not be mapped
+class MappedFile
+{
+private:
+  uint8_t* data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  void* file_handle;
+  void* mapping_handle = nullptr;
+#else
+  int fd;
+#endif
+
+public:
+  MappedFile(const char* file_path);
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  uint8_t* get_data();
+  size_t get_size();
+
+  // Writes changed pages to the file.
+  // The time is added to the write stage of stats, but not the bytes: only the system knows which pages changed.
+  // Throws std::runtime_error if pages could not be written.
+  void flush();
+};
+
+#endif
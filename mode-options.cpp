@@ -3,6 +3,8 @@
 
 #include <stdexcept>
 #include <sstream>
+#include <fstream>
+#include <algorithm>
 #include <sys/stat.h>
 
 /* Support functions */
@@ -11,8 +13,82 @@ int32_t cstr_to_int(const char* cstr);
 
 double cstr_to_double(const char* cstr);
 
+// Parses time point, see TimePoint::parse().
+TimePoint cstr_to_time(const char* cstr);
+
+// Builds chain options from the chain options and effects of batch mode command line.
+ChainOptions batch_chain_options(const int argc, const char* argv[]);
+
+// Reads lines of file that are not empty and are not comments starting with "#".
+std::vector<std::string> read_list_file(const char* file_path);
+
+// Reads whitespace separated words of file, skipping comments from "#" to the end of line.
+std::vector<std::string> read_spec_file(const char* file_path);
+
 /* Option parsing implementation */
 
+ArgList::ArgList(const std::vector<std::string>& words) : words(words)
+{
+  argv.push_back("wav-edit");
+  for (const std::string& word : this->words)
+  {
+    argv.push_back(word.c_str());
+  }
+  // Like in the program command line, argv[argc] is a null pointer
+  argv.push_back(nullptr);
+}
+
+int ArgList::get_argc()
+{
+  return argv.size() - 1;
+}
+
+const char** ArgList::get_argv()
+{
+  return &argv[0];
+}
+
+std::vector<std::string> ArgList::split_line(const std::string& line)
+{
+  std::vector<std::string> words;
+  size_t idx = 0;
+  while (idx < line.size())
+  {
+    if (line[idx] == ' ' || line[idx] == '\t')
+    {
+      idx++;
+      continue;
+    }
+
+    std::string word;
+    if (line[idx] == '"')
+    {
+      for (idx++; idx < line.size() && line[idx] != '"'; idx++)
+      {
+        if (line[idx] == '\\' && idx + 1 < line.size() && (line[idx + 1] == '"' || line[idx + 1] == '\\'))
+        {
+          idx++;
+        }
+        word += line[idx];
+      }
+      if (idx == line.size())
+      {
+        throw std::invalid_argument("Error: Quote is not closed.");
+      }
+      idx++;
+    }
+    else
+    {
+      for (; idx < line.size() && line[idx] != ' ' && line[idx] != '\t'; idx++)
+      {
+        word += line[idx];
+      }
+    }
+    words.push_back(word);
+  }
+  return words;
+}
+
 BaseOptions::BaseOptions(const int argc, const char* argv[])
 {
   if (argc < 3)
@@ -52,31 +128,58 @@ HexOptions::HexOptions(const int argc, const char* argv[])
   }
 }
 
-TrimOptions::TrimOptions(const int argc, const char* argv[])
+AnalyzeOptions::AnalyzeOptions(const int argc, const char* argv[])
   : BaseOptions(argc, argv)
-{ 
-  int32_t start_arg, end_arg, idx = 3;
+{
+  int32_t thread_arg, idx = 3;
   while (idx < argc && argv[idx][0] == '-')
   {
     switch (argv[idx][1])
     {
-      case 's':
-        start_arg = cstr_to_int(argv[idx + 1]);
-        if (start_arg < 0)
+      case 'j':
+        thread_arg = cstr_to_int(argv[idx + 1]);
+        if (thread_arg < 0)
         {
-          throw std::invalid_argument("Error: Start point (-s) should be positive or zero.");
+          throw std::invalid_argument("Error: Number of threads (-j) should be positive or zero.");
         }
-        start_ms = (uint32_t)start_arg;
+        thread_count = thread_arg;
         break;
 
-      case 'e':
-        end_flag = true;
-        end_arg = cstr_to_int(argv[idx + 1]);
-        if (end_arg < 0)
+      default:
+        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'analyze' mode.");
+    }
+    idx += 2;
+  }
+  if (idx != argc)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
+  }
+}
+
+PeaksOptions::PeaksOptions(const int argc, const char* argv[])
+  : BaseOptions(argc, argv)
+{
+  int32_t bucket_arg, thread_arg, idx = 3;
+  while (idx < argc && argv[idx][0] == '-')
+  {
+    switch (argv[idx][1])
+    {
+      case 'b':
+        bucket_arg = cstr_to_int(argv[idx + 1]);
+        if (bucket_arg < 1 || bucket_arg > (1 << 20))
+        {
+          throw std::invalid_argument("Error: Frames of a bucket (-b) should be from 1 to 1048576.");
+        }
+        bucket_frames = bucket_arg;
+        break;
+
+      case 'j':
+        thread_arg = cstr_to_int(argv[idx + 1]);
+        if (thread_arg < 0)
         {
-          throw std::invalid_argument("Error: End point (-e) should be positive or zero.");
+          throw std::invalid_argument("Error: Number of threads (-j) should be positive or zero.");
         }
-        end_ms = (uint32_t)end_arg;
+        thread_count = thread_arg;
         break;
 
       case 'o':
@@ -85,7 +188,7 @@ TrimOptions::TrimOptions(const int argc, const char* argv[])
         break;
 
       default:
-        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'trim' mode.");
+        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'peaks' mode.");
     }
     idx += 2;
   }
@@ -93,37 +196,56 @@ TrimOptions::TrimOptions(const int argc, const char* argv[])
   {
     throw std::invalid_argument("Error: Invalid options format.");
   }
-  if (end_flag && start_arg > end_arg)
+}
+
+TrimOptions::TrimOptions(const int argc, const char* argv[])
+  : BaseOptions(argc, argv)
+{ 
+  int32_t idx = 3;
+  while (idx < argc && argv[idx][0] == '-')
   {
-    throw std::invalid_argument("Error: Start point (-s) must be lesser than or equal to end point (-e).");
+    switch (argv[idx][1])
+    {
+      case 's':
+        start = cstr_to_time(argv[idx + 1]);
+        break;
+
+      case 'e':
+        end_flag = true;
+        end = cstr_to_time(argv[idx + 1]);
+        break;
+
+      case 'o':
+        out_flag = true;
+        outfile_path = argv[idx + 1];
+        break;
+
+      default:
+        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'trim' mode.");
+    }
+    idx += 2;
+  }
+  if (idx != argc)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
   }
 }
 
 FadeOptions::FadeOptions(const int argc, const char* argv[])
   : BaseOptions(argc, argv)
 {
-  int32_t start_arg, end_arg, idx = 3;
+  int32_t thread_arg, idx = 3;
   while (idx < argc && argv[idx][0] == '-')
   {
     switch (argv[idx][1])
     {
       case 's':
-        start_arg = cstr_to_int(argv[idx + 1]);
-        if (start_arg < 0)
-        {
-          throw std::invalid_argument("Error: Start point (-s) should be positive or zero.");
-        }
-        start_ms = (uint32_t)start_arg;
+        start = cstr_to_time(argv[idx + 1]);
         break;
 
       case 'e':
         end_flag = true;
-        end_arg = cstr_to_int(argv[idx + 1]);
-        if (end_arg < 0)
-        {
-          throw std::invalid_argument("Error: End point (-e) should be positive or zero.");
-        }
-        end_ms = end_arg;
+        end = cstr_to_time(argv[idx + 1]);
         break;
 
       case 'l':
@@ -132,7 +254,15 @@ FadeOptions::FadeOptions(const int argc, const char* argv[])
         {
           throw std::invalid_argument("Error: End volume level (-l) should be a float from 0 to 1.");
         }
-        end_ms = (uint32_t)end_arg;
+        break;
+
+      case 'j':
+        thread_arg = cstr_to_int(argv[idx + 1]);
+        if (thread_arg < 0)
+        {
+          throw std::invalid_argument("Error: Number of threads (-j) should be positive or zero.");
+        }
+        thread_count = thread_arg;
         break;
 
       case 'o':
@@ -151,21 +281,86 @@ FadeOptions::FadeOptions(const int argc, const char* argv[])
   }
 }
 
-ReverbOptions::ReverbOptions(const int argc, const char* argv[])
+NormalizeOptions::NormalizeOptions(const int argc, const char* argv[])
   : BaseOptions(argc, argv)
 {
-  int32_t delay_arg, idx = 3;
+  int32_t thread_arg, idx = 3;
+  std::string mode_arg;
   while (idx < argc && argv[idx][0] == '-')
   {
     switch (argv[idx][1])
     {
-      case 'd':
-        delay_arg = cstr_to_int(argv[idx + 1]);
-        if (delay_arg < 0)
+      case 'm':
+        mode_arg = argv[idx + 1] != nullptr ? argv[idx + 1] : "";
+        if (mode_arg == "peak")
+        {
+          peak_mode = true;
+        }
+        else if (mode_arg == "loudness")
+        {
+          peak_mode = false;
+        }
+        else
+        {
+          throw std::invalid_argument("Error: Normalization mode (-m) should be 'loudness' or 'peak'.");
+        }
+        break;
+
+      case 'l':
+        target_lufs = cstr_to_double(argv[idx + 1]);
+        if (target_lufs < -70 || target_lufs > 0)
+        {
+          throw std::invalid_argument("Error: Target loudness (-l) should be a float from -70 to 0 LUFS.");
+        }
+        break;
+
+      case 'p':
+        peak_dbfs = cstr_to_double(argv[idx + 1]);
+        if (peak_dbfs < -70 || peak_dbfs > 0)
         {
-          throw std::invalid_argument("Error: Delay time (-d) should be positive or zero.");
+          throw std::invalid_argument("Error: Peak level (-p) should be a float from -70 to 0 dBFS.");
         }
-        delay_ms = delay_arg;
+        break;
+
+      case 'j':
+        thread_arg = cstr_to_int(argv[idx + 1]);
+        if (thread_arg < 0)
+        {
+          throw std::invalid_argument("Error: Number of threads (-j) should be positive or zero.");
+        }
+        thread_count = thread_arg;
+        break;
+
+      case 'o':
+        out_flag = true;
+        outfile_path = argv[idx + 1];
+        break;
+
+      default:
+        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'normalize' mode.");
+    }
+    idx += 2;
+  }
+  if (idx != argc)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
+  }
+}
+
+ReverbOptions::ReverbOptions(const int argc, const char* argv[])
+  : BaseOptions(argc, argv)
+{
+  int32_t idx = 3;
+  while (idx < argc && argv[idx][0] == '-')
+  {
+    switch (argv[idx][1])
+    {
+      case 'd':
+        delay = cstr_to_time(argv[idx + 1]);
+        break;
+
+      case 't':
+        tail = cstr_to_time(argv[idx + 1]);
         break;
 
       case 'k':
@@ -192,10 +387,285 @@ ReverbOptions::ReverbOptions(const int argc, const char* argv[])
   } 
 }
 
+FreeverbOptions::FreeverbOptions(const int argc, const char* argv[])
+  : BaseOptions(argc, argv)
+{
+  int32_t idx = 3;
+  while (idx < argc && argv[idx][0] == '-')
+  {
+    switch (argv[idx][1])
+    {
+      case 'r':
+        room_size_01 = cstr_to_double(argv[idx + 1]);
+        if (room_size_01 < 0 || room_size_01 > 1)
+        {
+          throw std::invalid_argument("Error: Room size (-r) should be a float from 0 to 1.");
+        }
+        break;
+
+      case 'p':
+        damping_01 = cstr_to_double(argv[idx + 1]);
+        if (damping_01 < 0 || damping_01 > 1)
+        {
+          throw std::invalid_argument("Error: Damping (-p) should be a float from 0 to 1.");
+        }
+        break;
+
+      case 'w':
+        wet_01 = cstr_to_double(argv[idx + 1]);
+        if (wet_01 < 0 || wet_01 > 1)
+        {
+          throw std::invalid_argument("Error: Wet level (-w) should be a float from 0 to 1.");
+        }
+        break;
+
+      case 'y':
+        dry_01 = cstr_to_double(argv[idx + 1]);
+        if (dry_01 < 0 || dry_01 > 1)
+        {
+          throw std::invalid_argument("Error: Dry level (-y) should be a float from 0 to 1.");
+        }
+        break;
+
+      case 't':
+        tail = cstr_to_time(argv[idx + 1]);
+        break;
+
+      case 'o':
+        out_flag = true;
+        outfile_path = argv[idx + 1];
+        break;
+
+      default:
+        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'freeverb' mode.");
+    }
+    idx += 2;
+  }
+  if (idx != argc)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
+  }
+}
+
+ChainOptions::ChainOptions(const int argc, const char* argv[])
+  : BaseOptions(argc, argv)
+{
+  const char* spec_path = nullptr;
+  int32_t idx = 3;
+  while (idx < argc && argv[idx][0] == '-')
+  {
+    switch (argv[idx][1])
+    {
+      case 'f':
+        spec_path = argv[idx + 1];
+        break;
+
+      case 'o':
+        out_flag = true;
+        outfile_path = argv[idx + 1];
+        break;
+
+      default:
+        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'chain' mode.");
+    }
+    idx += 2;
+  }
+  if (idx > argc)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
+  }
+
+  if (spec_path != nullptr)
+  {
+    add_stages(read_spec_file(spec_path));
+  }
+  add_stages(std::vector<std::string>(argv + idx, argv + argc));
+
+  if (stages.empty())
+  {
+    throw std::invalid_argument("Error: No effects passed.");
+  }
+}
+
+void ChainOptions::add(const TrimOptions& options)
+{
+  trim.push_back(options);
+  stages.push_back({ TRIM, trim.size() - 1 });
+}
+
+void ChainOptions::add(const FadeOptions& options)
+{
+  fade.push_back(options);
+  stages.push_back({ FADE, fade.size() - 1 });
+}
+
+void ChainOptions::add(const ReverbOptions& options)
+{
+  reverb.push_back(options);
+  stages.push_back({ REVERB, reverb.size() - 1 });
+}
+
+void ChainOptions::add(const FreeverbOptions& options)
+{
+  freeverb.push_back(options);
+  stages.push_back({ FREEVERB, freeverb.size() - 1 });
+}
+
+bool ChainOptions::changes_length()
+{
+  for (const Stage& stage : stages)
+  {
+    if (stage.type == TRIM || (stage.type == REVERB && !reverb[stage.idx].tail.is_zero()) ||
+        (stage.type == FREEVERB && !freeverb[stage.idx].tail.is_zero()))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+void ChainOptions::add_stages(const std::vector<std::string>& args)
+{
+  size_t idx = 0;
+  while (idx < args.size())
+  {
+    const std::string& mode = args[idx];
+
+    // Arguments of the effect in the form of its own mode command line
+    std::vector<const char*> effect_argv = { "wav-edit", mode.c_str(), infile_path };
+    for (idx++; idx < args.size() && args[idx][0] == '-'; idx += 2)
+    {
+      if (idx + 1 == args.size())
+      {
+        throw std::invalid_argument("Error: Invalid options format.");
+      }
+      effect_argv.push_back(args[idx].c_str());
+      effect_argv.push_back(args[idx + 1].c_str());
+    }
+    int effect_argc = effect_argv.size();
+
+    bool out_flag;
+    if (mode == "trim")
+    {
+      add(TrimOptions(effect_argc, &effect_argv[0]));
+      out_flag = trim.back().out_flag;
+    }
+    else if (mode == "fade")
+    {
+      add(FadeOptions(effect_argc, &effect_argv[0]));
+      out_flag = fade.back().out_flag;
+    }
+    else if (mode == "reverb")
+    {
+      add(ReverbOptions(effect_argc, &effect_argv[0]));
+      out_flag = reverb.back().out_flag;
+    }
+    else if (mode == "freeverb")
+    {
+      add(FreeverbOptions(effect_argc, &effect_argv[0]));
+      out_flag = freeverb.back().out_flag;
+    }
+    else
+    {
+      throw std::invalid_argument("Error: " + mode + " is not an effect that can be chained.");
+    }
+
+    if (out_flag)
+    {
+      throw std::invalid_argument("Error: Output file (-o) should be passed to 'chain' mode, not to its effects.");
+    }
+  }
+}
+
+BatchOptions::BatchOptions(const int argc, const char* argv[])
+  : BaseOptions(argc, argv), chain(batch_chain_options(argc, argv))
+{
+  int32_t thread_arg, idx = 3;
+  bool outdir_flag = false;
+  while (idx < argc && argv[idx][0] == '-')
+  {
+    switch (argv[idx][1])
+    {
+      case 'd':
+        outdir_flag = true;
+        outdir_path = argv[idx + 1];
+        break;
+
+      case 'j':
+        thread_arg = cstr_to_int(argv[idx + 1]);
+        if (thread_arg < 0)
+        {
+          throw std::invalid_argument("Error: Number of threads (-j) should be positive or zero.");
+        }
+        thread_count = thread_arg;
+        break;
+
+      case 'f':
+        break;
+
+      default:
+        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'batch' mode.");
+    }
+    idx += 2;
+  }
+  if (!outdir_flag)
+  {
+    throw std::invalid_argument("Error: Output directory (-d) is not passed.");
+  }
+
+  if (directory_exists(infile_path))
+  {
+    infile_paths = list_files(infile_path, ".wav");
+  }
+  else
+  {
+    infile_paths = read_list_file(infile_path);
+  }
+}
+
+ServeOptions::ServeOptions(const int argc, const char* argv[])
+{
+  if (argc < 3)
+  {
+    throw std::invalid_argument("Error: No socket path passed.");
+  }
+  socket_path = argv[2];
+
+  int32_t thread_arg, idx = 3;
+  while (idx < argc && argv[idx][0] == '-')
+  {
+    switch (argv[idx][1])
+    {
+      case 'j':
+        thread_arg = cstr_to_int(argv[idx + 1]);
+        if (thread_arg < 0)
+        {
+          throw std::invalid_argument("Error: Number of threads (-j) should be positive or zero.");
+        }
+        thread_count = thread_arg;
+        break;
+
+      default:
+        throw std::invalid_argument("Error: Invalid option '" + std::string(argv[idx]) + "' for 'serve' mode.");
+    }
+    idx += 2;
+  }
+  if (idx != argc)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
+  }
+}
+
 /* Support functions implementation */
 
 int32_t cstr_to_int(const char* cstr)
 {
+  // Option without value at the end of command line
+  if (cstr == nullptr)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
+  }
+
   int32_t cstr_int;
   std::stringstream conversion;
   conversion << cstr;
@@ -211,6 +681,12 @@ int32_t cstr_to_int(const char* cstr)
 
 double cstr_to_double(const char* cstr)
 {
+  // Option without value at the end of command line
+  if (cstr == nullptr)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
+  }
+
   double cstr_double;
   std::stringstream conversion;
   conversion << cstr;
@@ -223,3 +699,78 @@ double cstr_to_double(const char* cstr)
 
   return cstr_double;
 }
+
+TimePoint cstr_to_time(const char* cstr)
+{
+  // Option without value at the end of command line
+  if (cstr == nullptr)
+  {
+    throw std::invalid_argument("Error: Invalid options format.");
+  }
+  return TimePoint::parse(cstr);
+}
+
+std::vector<std::string> read_spec_file(const char* file_path)
+{
+  std::ifstream infile(file_path);
+  if (!infile.is_open())
+  {
+    throw std::invalid_argument("Error: Spec file '" + std::string(file_path) + "' could not be opened.");
+  }
+
+  std::vector<std::string> words;
+  std::string line, word;
+  while (std::getline(infile, line))
+  {
+    std::stringstream line_stream(line.substr(0, line.find('#')));
+    while (line_stream >> word)
+    {
+      words.push_back(word);
+    }
+  }
+  return words;
+}
+
+ChainOptions batch_chain_options(const int argc, const char* argv[])
+{
+  // Batch options except "-f" are left out, the rest is passed as chain mode command line
+  std::vector<const char*> chain_argv(argv, argv + std::min(argc, 3));
+  int32_t idx = 3;
+  while (idx < argc && argv[idx][0] == '-')
+  {
+    if (idx + 1 == argc)
+    {
+      throw std::invalid_argument("Error: Invalid options format.");
+    }
+    if (argv[idx][1] == 'f')
+    {
+      chain_argv.push_back(argv[idx]);
+      chain_argv.push_back(argv[idx + 1]);
+    }
+    idx += 2;
+  }
+  chain_argv.insert(chain_argv.end(), argv + idx, argv + argc);
+  return ChainOptions(chain_argv.size(), &chain_argv[0]);
+}
+
+std::vector<std::string> read_list_file(const char* file_path)
+{
+  std::ifstream infile(file_path);
+  if (!infile.is_open())
+  {
+    throw std::invalid_argument("Error: File list '" + std::string(file_path) + "' could not be opened.");
+  }
+
+  std::vector<std::string> lines;
+  std::string line;
+  while (std::getline(infile, line))
+  {
+    size_t first = line.find_first_not_of(" \t\r");
+    size_t last = line.find_last_not_of(" \t\r");
+    if (first != std::string::npos && line[first] != '#')
+    {
+      lines.push_back(line.substr(first, last - first + 1));
+    }
+  }
+  return lines;
+}
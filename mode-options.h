@@ -1,12 +1,46 @@
 #ifndef MODEOPTIONS_H
 #define MODEOPTIONS_H
 
+#include "time-point.h"
+
 #include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Command line of a mode made of separate words, e.g. of a request to the server (see ServeOptions),
+// so options structs can be built from it like from the command line of the program.
+// Options keep pointers to the words, so the ArgList has to live as long as the options are used.
+class ArgList
+{
+private:
+  std::vector<std::string> words;
+  std::vector<const char*> argv;
+
+public:
+  // words start with the mode name, the program name is put before them.
+  ArgList(const std::vector<std::string>& words);
+  ArgList(const ArgList&) = delete;
+  ArgList& operator=(const ArgList&) = delete;
+
+  int get_argc();
+  const char** get_argv();
+
+  // Splits line into words separated by spaces or tabs.
+  // A word in double quotes can contain spaces, there \" and \\ stand for " and \.
+  // Throws std::invalid_argument exception if a quote is not closed.
+  static std::vector<std::string> split_line(const std::string& line);
+};
 
+// Options are parsed from the command line of a mode, or made by the default constructor
+// and filled field by field for library calls on frames in memory (see wavedit.h), where there is no input file.
+// Time options are parsed with TimePoint::parse(): milliseconds, seconds, frame index or timecode.
+//
 // Throws std::invalid_argument exception if input file is not passed or is not exist.;
 struct BaseOptions
 {
-  const char* infile_path;
+  const char* infile_path = nullptr;
+  BaseOptions() {}
   BaseOptions(const int argc, const char* argv[]);
 };
 
@@ -27,37 +61,170 @@ struct HexOptions : BaseOptions
 
 // Throws std::invalid_argument exception if input file is not passed or is not exist.;
 // Throws std::invalid_argument exception if invalid option or options value was passed.;
-// In particular, "-s" and "-e" parameters should be positive or zero and "-s" lesser than or equal to "-e".
+// In particular, "-j" parameter should be positive or zero.
+struct AnalyzeOptions : BaseOptions
+{
+  uint32_t thread_count = 1;  // 0 means one thread for every CPU core
+  AnalyzeOptions() {}
+  AnalyzeOptions(const int argc, const char* argv[]);
+};
+
+// Throws std::invalid_argument exception if input file is not passed or is not exist.;
+// Throws std::invalid_argument exception if invalid option or options value was passed.;
+// In particular, "-b" parameter should be from 1 to 1048576 and "-j" parameter should be positive or zero.
+struct PeaksOptions : BaseOptions
+{
+  uint32_t bucket_frames = 256;  // frames of a bucket of the finest level, see peak-file.h
+  uint32_t thread_count = 1;     // 0 means one thread for every CPU core
+  const char* outfile_path = nullptr;
+  bool out_flag = false;
+  PeaksOptions() {}
+  PeaksOptions(const int argc, const char* argv[]);
+};
+
+// Throws std::invalid_argument exception if input file is not passed or is not exist.;
+// Throws std::invalid_argument exception if invalid option or options value was passed.;
+// In particular, "-s" and "-e" parameters should be time points, "-s" is checked to be before "-e" by the effect.
 struct TrimOptions : BaseOptions
 {
-  uint32_t start_ms = 0, end_ms;
-  const char* outfile_path;
+  TimePoint start, end;  // end is used only if end_flag is set, otherwise it is the end of data
+  const char* outfile_path = nullptr;
   bool end_flag = false, out_flag = false;
+  TrimOptions() {}
   TrimOptions(const int argc, const char* argv[]);
 };
 
 // Throws std::invalid_argument exception if input file is not passed or is not exist.;
 // Throws std::invalid_argument exception if invalid option or options value was passed.;
-// In particular, "-s" and "-e" parameters should be positive or zero and "-l" parameter should be float from 0 to 1.
+// In particular, "-s" and "-e" parameters should be time points, "-j" parameter should be positive or zero
+// and "-l" parameter should be float from 0 to 1.
 struct FadeOptions : BaseOptions
 {
-  uint32_t start_ms = 0, end_ms;
+  TimePoint start, end;  // end is used only if end_flag is set, otherwise it is the end of data
+  uint32_t thread_count = 1;  // 0 means one thread for every CPU core
   double end_lvl_01 = 0.;
-  const char* outfile_path;
+  const char* outfile_path = nullptr;
   bool end_flag = false, out_flag = false;
+  FadeOptions() {}
   FadeOptions(const int argc, const char* argv[]);
 };
 
 // Throws std::invalid_argument exception if input file is not passed or is not exist.;
 // Throws std::invalid_argument exception if invalid option or options value was passed.;
-// In particular, "-d" parameter should be positive or zero and "-k" parametr should be float from 0 to 1.
+// In particular, "-m" parameter should be "loudness" or "peak", "-l" parameter should be from -70 to 0 LUFS,
+// "-p" parameter should be from -70 to 0 dBFS and "-j" parameter should be positive or zero.
+struct NormalizeOptions : BaseOptions
+{
+  bool peak_mode = false;        // normalize the peak to peak_dbfs instead of the loudness to target_lufs
+  double target_lufs = -23.;
+  double peak_dbfs = -1.;        // target of peak mode, the highest peak in loudness mode
+  uint32_t thread_count = 1;     // 0 means one thread for every CPU core
+  const char* outfile_path = nullptr;
+  bool out_flag = false;
+  NormalizeOptions() {}
+  NormalizeOptions(const int argc, const char* argv[]);
+};
+
+// Throws std::invalid_argument exception if input file is not passed or is not exist.;
+// Throws std::invalid_argument exception if invalid option or options value was passed.;
+// In particular, "-d" and "-t" parameters should be time points and "-k" parametr should be float from 0 to 1.
 struct ReverbOptions : BaseOptions
 {
-  uint32_t delay_ms = 1000;
+  TimePoint delay = TimePoint::from_ms(1000), tail;
   double decay_01 = 0.1;
-  const char* outfile_path;
+  const char* outfile_path = nullptr;
   bool out_flag = false;
+  ReverbOptions() {}
   ReverbOptions(const int argc, const char* argv[]);
 };
 
+// Throws std::invalid_argument exception if input file is not passed or is not exist.;
+// Throws std::invalid_argument exception if invalid option or options value was passed.;
+// In particular, "-r", "-p", "-w" and "-y" parameters should be floats from 0 to 1 and "-t" parameter should be a time point.
+struct FreeverbOptions : BaseOptions
+{
+  double room_size_01 = 0.5, damping_01 = 0.5, wet_01 = 0.3, dry_01 = 1.;
+  TimePoint tail;
+  const char* outfile_path = nullptr;
+  bool out_flag = false;
+  FreeverbOptions() {}
+  FreeverbOptions(const int argc, const char* argv[]);
+};
+
+// Effects of the chain are parsed with the options structs of their modes, but they can't have "-o" option.
+// Effects are listed after the chain options on the command line or in spec file (-f):
+// every effect starts with its mode name followed by its options. In spec file "#" starts a comment.
+// Effects from spec file go before the effects from the command line.
+// Chain made by the default constructor is built with add(), effects run in the order they are added.
+//
+// Throws std::invalid_argument exception if input file is not passed or is not exist.;
+// Throws std::invalid_argument exception if invalid option or options value was passed.;
+// Throws std::invalid_argument exception if spec file could not be read or the chain has no effects.
+struct ChainOptions : BaseOptions
+{
+  enum EffectType { TRIM, FADE, REVERB, FREEVERB };
+
+  // Effect of the chain and its index in the vector of options of its type.
+  struct Stage
+  {
+    EffectType type;
+    size_t idx;
+  };
+
+  std::vector<Stage> stages;
+  std::vector<TrimOptions> trim;
+  std::vector<FadeOptions> fade;
+  std::vector<ReverbOptions> reverb;
+  std::vector<FreeverbOptions> freeverb;
+  const char* outfile_path = nullptr;
+  bool out_flag = false;
+  ChainOptions() {}
+  ChainOptions(const int argc, const char* argv[]);
+
+  // Adds effect to the end of the chain.
+  void add(const TrimOptions& options);
+  void add(const FadeOptions& options);
+  void add(const ReverbOptions& options);
+  void add(const FreeverbOptions& options);
+
+  // Returns true if some effect of the chain changes the number of frames.
+  bool changes_length();
+
+private:
+  void add_stages(const std::vector<std::string>& args);
+};
+
+// Input files of the batch are all WAVE files (*.wav) of the source directory,
+// or the files listed in the source file, one path per line ("#" starts a comment line).
+// Effects are passed like in chain mode, the batch options go before them.
+// Results are written to the output directory (-d) under the names of input files without asking to replace them
+// (existing files are kept with --no-clobber option of the program).
+//
+// Throws std::invalid_argument exception if source is not passed or is not exist.;
+// Throws std::invalid_argument exception if invalid option or options value was passed.;
+// In particular, "-d" option is required and "-j" parameter should be positive or zero.
+// Throws std::invalid_argument exception if source file could not be read.
+struct BatchOptions : BaseOptions
+{
+  std::vector<std::string> infile_paths;
+  const char* outdir_path;
+  uint32_t thread_count = 0;  // 0 means one thread for every CPU core
+  ChainOptions chain;
+  BatchOptions(const int argc, const char* argv[]);
+};
+
+// Server listens on a Unix domain socket (not on Windows) and runs requests on a pool of threads.
+// Every request is one line with the words of a mode command line without the program name:
+// info, analyze, peaks, trim, fade, normalize, reverb, freeverb or chain mode with its file paths and options, or "shutdown".
+//
+// Throws std::invalid_argument exception if socket path is not passed.;
+// Throws std::invalid_argument exception if invalid option or options value was passed.;
+// In particular, "-j" parameter should be positive or zero.
+struct ServeOptions
+{
+  const char* socket_path;
+  uint32_t thread_count = 0;  // 0 means one thread for every CPU core
+  ServeOptions(const int argc, const char* argv[]);
+};
+
 #endif
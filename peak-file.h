@@ -0,0 +1,251 @@
+#ifndef PEAKFILE_H
+#define PEAKFILE_H
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstddef>
+
+// Peak file: overview of WAVE data for drawing its waveform at any zoom, made by peaks mode.
+// Frames are split into buckets, every bucket keeps the lowest and the highest sample of every channel
+// as 16-bit values of full scale. Buckets of level 0 have bucket_frames frames, every next level
+// merges pairs of buckets of the level before it, up to the level with one bucket.
+//
+// Layout, all numbers are little-endian:
+//   "WEPK", uint16 version, uint16 number of channels, uint32 frequency, uint32 frames in a bucket of level 0,
+//   uint32 number of levels, uint32 zero, uint64 number of frames;
+//   then levels from level 0, every level is its buckets one after another,
+//   every bucket is int16 min and int16 max of every channel.
+// This header has no dependencies, so a viewer can query peak files without the rest of wav-edit.
+namespace peaks
+{
+  const uint8_t MAGIC[4] = { 'W', 'E', 'P', 'K' };
+  const uint16_t VERSION = 1;
+  const size_t HEADER_SIZE = 32;
+  const size_t RANGE_SIZE = 4;
+
+  // Lowest and highest sample of a bucket or of a pixel, full scale is from -32768 to 32767.
+  struct Range
+  {
+    int16_t min, max;
+
+    Range() : min(0), max(0) {}
+    Range(int16_t min, int16_t max) : min(min), max(max) {}
+
+    // Range of samples from -1 to 1 of full scale, rounded outwards, so it covers them all.
+    static Range from_float(float min_val, float max_val)
+    {
+      float low = std::floor(min_val * 32768.f), high = std::ceil(max_val * 32768.f);
+      return Range(static_cast<int16_t>(std::max(-32768.f, std::min(32767.f, low))),
+                   static_cast<int16_t>(std::max(-32768.f, std::min(32767.f, high))));
+    }
+
+    void merge(const Range& other)
+    {
+      min = std::min(min, other.min);
+      max = std::max(max, other.max);
+    }
+  };
+
+  // Number of buckets of bucket_frames frames that cover frame_count frames, the last bucket can be shorter.
+  inline uint64_t bucket_count(uint64_t frame_count, uint64_t bucket_frames)
+  {
+    return (frame_count + bucket_frames - 1) / bucket_frames;
+  }
+
+  // Number of levels from level 0 to the level with one bucket, or 1 if there are no frames.
+  inline uint32_t level_count(uint64_t frame_count, uint32_t bucket_frames)
+  {
+    uint32_t levels = 1;
+    for (uint64_t buckets = bucket_count(frame_count, bucket_frames); buckets > 1; buckets = (buckets + 1) / 2)
+    {
+      levels++;
+    }
+    return levels;
+  }
+
+  inline void put_le(uint8_t* bytes, uint64_t value, size_t byte_count)
+  {
+    for (size_t idx = 0; idx < byte_count; idx++)
+    {
+      bytes[idx] = static_cast<uint8_t>(value >> (8 * idx));
+    }
+  }
+
+  inline uint64_t get_le(const uint8_t* bytes, size_t byte_count)
+  {
+    uint64_t value = 0;
+    for (size_t idx = 0; idx < byte_count; idx++)
+    {
+      value |= static_cast<uint64_t>(bytes[idx]) << (8 * idx);
+    }
+    return value;
+  }
+
+  // Makes peak file from the buckets of level 0, ranges has the ranges of all channels of the first bucket,
+  // then of the second one and so on. The other levels are merged from it.
+  inline std::vector<uint8_t> make_peak_file(const std::vector<Range>& ranges, uint16_t num_of_chan, uint32_t frequency,
+                                             uint32_t bucket_frames, uint64_t frame_count)
+  {
+    uint32_t levels = level_count(frame_count, bucket_frames);
+    size_t range_count = 0;
+    for (uint64_t buckets = bucket_count(frame_count, bucket_frames), level = 0; level < levels; level++)
+    {
+      range_count += buckets * num_of_chan;
+      buckets = (buckets + 1) / 2;
+    }
+
+    std::vector<uint8_t> bytes(HEADER_SIZE + range_count * RANGE_SIZE);
+    std::copy(MAGIC, MAGIC + 4, bytes.begin());
+    put_le(&bytes[4], VERSION, 2);
+    put_le(&bytes[6], num_of_chan, 2);
+    put_le(&bytes[8], frequency, 4);
+    put_le(&bytes[12], bucket_frames, 4);
+    put_le(&bytes[16], levels, 4);
+    put_le(&bytes[24], frame_count, 8);
+
+    std::vector<Range> level_ranges = ranges, next_ranges;
+    uint8_t* out = &bytes[HEADER_SIZE];
+    for (uint32_t level = 0; level < levels; level++)
+    {
+      for (const Range& range : level_ranges)
+      {
+        put_le(out, static_cast<uint16_t>(range.min), 2);
+        put_le(out + 2, static_cast<uint16_t>(range.max), 2);
+        out += RANGE_SIZE;
+      }
+
+      // Bucket of the next level is a pair of buckets, or the last bucket alone
+      size_t buckets = level_ranges.size() / std::max<size_t>(num_of_chan, 1);
+      next_ranges.assign((buckets + 1) / 2 * num_of_chan, Range());
+      for (size_t bucket = 0; bucket < buckets; bucket++)
+      {
+        for (uint16_t channel = 0; channel < num_of_chan; channel++)
+        {
+          Range& next = next_ranges[bucket / 2 * num_of_chan + channel];
+          if (bucket % 2 == 0)
+          {
+            next = level_ranges[bucket * num_of_chan + channel];
+          }
+          else
+          {
+            next.merge(level_ranges[bucket * num_of_chan + channel]);
+          }
+        }
+      }
+      level_ranges.swap(next_ranges);
+    }
+    return bytes;
+  }
+
+  // Reader of peak file in memory, e.g. read by readfile() or mapped. It does not copy the bytes,
+  // so they must stay in place while it is used.
+  class PeakFile
+  {
+  private:
+    const uint8_t* bytes;
+    uint16_t num_of_chan;
+    uint32_t frequency, bucket_frames, levels;
+    uint64_t frame_count;
+    std::vector<size_t> level_offsets;
+
+  public:
+    // Throws std::invalid_argument exception if bytes are not a peak file of this version or are cut short
+    PeakFile(const uint8_t* bytes, size_t byte_count) : bytes(bytes)
+    {
+      if (byte_count < HEADER_SIZE || !std::equal(MAGIC, MAGIC + 4, bytes) || get_le(bytes + 4, 2) != VERSION)
+      {
+        throw std::invalid_argument("Error: This is not a peak file of version " + std::to_string(VERSION) + ".");
+      }
+      num_of_chan = static_cast<uint16_t>(get_le(bytes + 6, 2));
+      frequency = static_cast<uint32_t>(get_le(bytes + 8, 4));
+      bucket_frames = static_cast<uint32_t>(get_le(bytes + 12, 4));
+      levels = static_cast<uint32_t>(get_le(bytes + 16, 4));
+      frame_count = get_le(bytes + 24, 8);
+      if (num_of_chan == 0 || bucket_frames == 0 || levels != level_count(frame_count, bucket_frames))
+      {
+        throw std::invalid_argument("Error: Peak file header is invalid.");
+      }
+
+      size_t offset = HEADER_SIZE;
+      for (uint32_t level = 0; level < levels; level++)
+      {
+        level_offsets.push_back(offset);
+        offset += get_bucket_count(level) * num_of_chan * RANGE_SIZE;
+      }
+      if (offset > byte_count)
+      {
+        throw std::invalid_argument("Error: Peak file is cut short.");
+      }
+    }
+
+    uint16_t get_num_of_channels() const { return num_of_chan; }
+    uint32_t get_frequency() const { return frequency; }
+    uint64_t get_frame_count() const { return frame_count; }
+    uint32_t get_level_count() const { return levels; }
+
+    uint64_t get_bucket_frames(uint32_t level) const
+    {
+      return static_cast<uint64_t>(bucket_frames) << level;
+    }
+
+    uint64_t get_bucket_count(uint32_t level) const
+    {
+      return bucket_count(frame_count, get_bucket_frames(level));
+    }
+
+    // Range of bucket of level, the bucket and the channel must be in the file.
+    Range get_bucket(uint32_t level, uint64_t bucket, uint16_t channel) const
+    {
+      const uint8_t* range = bytes + level_offsets[level] + (bucket * num_of_chan + channel) * RANGE_SIZE;
+      return Range(static_cast<int16_t>(get_le(range, 2)), static_cast<int16_t>(get_le(range + 2, 2)));
+    }
+
+    // Ranges of channel in pixel_count pixels that split frames [first_frame, end_frame) evenly,
+    // e.g. in the columns of a view. Pixels are read from the coarsest level with buckets not longer than a pixel,
+    // so every pixel merges 3 buckets at most and the time does not depend on the number of frames.
+    // A pixel narrower than a bucket of level 0 gets the range of its bucket.
+    // Throws std::invalid_argument exception if channel or frames are not in the file
+    std::vector<Range> query(uint64_t first_frame, uint64_t end_frame, size_t pixel_count, uint16_t channel) const
+    {
+      if (channel >= num_of_chan || first_frame >= end_frame || end_frame > frame_count)
+      {
+        throw std::invalid_argument("Error: Frames [" + std::to_string(first_frame) + ", " + std::to_string(end_frame) +
+                                    ") of channel " + std::to_string(channel) + " are not in the peak file.");
+      }
+      std::vector<Range> pixels(pixel_count);
+      if (pixel_count == 0)
+      {
+        return pixels;
+      }
+
+      uint64_t frames = end_frame - first_frame;
+      uint64_t pixel_frames = frames / pixel_count, pixel_rest = frames % pixel_count;
+      uint32_t level = 0;
+      while (level + 1 < levels && get_bucket_frames(level + 1) <= pixel_frames)
+      {
+        level++;
+      }
+      uint64_t level_frames = get_bucket_frames(level);
+
+      // Pixel borders are computed without multiplying frames by pixel indexes, so they don't overflow
+      for (size_t pixel = 0; pixel < pixel_count; pixel++)
+      {
+        uint64_t start = first_frame + pixel * pixel_frames + pixel * pixel_rest / pixel_count;
+        uint64_t end = first_frame + (pixel + 1) * pixel_frames + (pixel + 1) * pixel_rest / pixel_count;
+        uint64_t last_bucket = (std::max(end, start + 1) - 1) / level_frames;
+        pixels[pixel] = get_bucket(level, start / level_frames, channel);
+        for (uint64_t bucket = start / level_frames + 1; bucket <= last_bucket; bucket++)
+        {
+          pixels[pixel].merge(get_bucket(level, bucket, channel));
+        }
+      }
+      return pixels;
+    }
+  };
+}
+
+#endif
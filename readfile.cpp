@@ -2,9 +2,122 @@
 
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
 #include <sys/stat.h>
 
-/* Support functions */
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/* InputFile implementation */
+
+// Builds error message with file path and the reason of the failed read.
+std::string read_error(const std::string& file_path, uint64_t pos, size_t byte_count, const char* reason)
+{
+  return "Error: Failed to read '" + std::to_string(byte_count) + "' bytes at " + std::to_string(pos) + " of '" +
+         file_path + "': " + reason + ".";
+}
+
+#ifdef _WIN32
+
+InputFile::InputFile(const char* file_path) : file_path(file_path)
+{
+  file = std::fopen(file_path, "rb");
+  if (file == nullptr)
+  {
+    throw std::invalid_argument("Error: File path '" + this->file_path + "' could not be opened.");
+  }
+}
+
+InputFile::~InputFile()
+{
+  std::fclose(file);
+}
+
+uint64_t InputFile::get_size()
+{
+  struct _stat64 results;
+  if (_fstat64(_fileno(file), &results) != 0)
+  {
+    throw std::runtime_error("Error: Couldn't get stat file size.");
+  }
+  return results.st_size;
+}
+
+void InputFile::read_at(uint64_t pos, uint8_t* bytes, size_t byte_count)
+{
+  if (_fseeki64(file, (int64_t)pos, SEEK_SET) != 0 || std::fread(bytes, 1, byte_count, file) != byte_count)
+  {
+    throw std::runtime_error(read_error(file_path, pos, byte_count, std::feof(file) ? "unexpected end of file"
+                                                                                      : std::strerror(errno)));
+  }
+}
+
+#else
+
+InputFile::InputFile(const char* file_path) : file_path(file_path)
+{
+  fd = open(file_path, O_RDONLY);
+  if (fd == -1)
+  {
+    throw std::invalid_argument("Error: File path '" + this->file_path + "' could not be opened.");
+  }
+}
+
+InputFile::~InputFile()
+{
+  close(fd);
+}
+
+uint64_t InputFile::get_size()
+{
+  struct stat results;
+  if (fstat(fd, &results) != 0)
+  {
+    throw std::runtime_error("Error: Couldn't get stat file size.");
+  }
+  return results.st_size;
+}
+
+void InputFile::read_at(uint64_t pos, uint8_t* bytes, size_t byte_count)
+{
+  size_t total_count = byte_count;
+  uint64_t first_pos = pos;
+  while (byte_count > 0)
+  {
+    ssize_t read_count = pread(fd, bytes, byte_count, (off_t)pos);
+    if (read_count < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (read_count <= 0)
+    {
+      throw std::runtime_error(read_error(file_path, first_pos, total_count, read_count == 0 ? "unexpected end of file"
+                                                                                                : std::strerror(errno)));
+    }
+    bytes += read_count;
+    byte_count -= read_count;
+    pos += read_count;
+  }
+}
+
+#endif
+
+#ifdef __linux__
+int InputFile::get_fd()
+{
+  return fd;
+}
+#endif
+
+/* Header functions */
 
 size_t get_file_size(const char* file_path)
 {
@@ -19,8 +132,6 @@ size_t get_file_size(const char* file_path)
   }
 }
 
-/* Header functions */
-
 bool file_exists(const char* file_path)
 {
   struct stat results;
@@ -31,6 +142,86 @@ bool file_exists(const char* file_path)
   return false;
 }
 
+bool directory_exists(const char* dir_path)
+{
+  struct stat results;
+  return stat(dir_path, &results) == 0 && (results.st_mode & S_IFMT) == S_IFDIR;
+}
+
+// Returns true if name ends with extension, letters are compared in any case.
+bool has_extension(const std::string& name, const char* extension)
+{
+  size_t ext_size = std::strlen(extension);
+  if (name.size() <= ext_size)
+  {
+    return false;
+  }
+  return std::equal(name.end() - ext_size, name.end(), extension, [](char a, char b)
+  {
+    return std::tolower((unsigned char)a) == std::tolower((unsigned char)b);
+  });
+}
+
+std::vector<std::string> list_files(const char* dir_path, const char* extension)
+{
+  std::string dir = dir_path;
+  if (!dir.empty() && dir.back() != '/' && dir.back() != '\\')
+  {
+    dir += '/';
+  }
+
+  std::vector<std::string> paths;
+#ifdef _WIN32
+  WIN32_FIND_DATAA entry;
+  HANDLE find_handle = FindFirstFileA((dir + "*").c_str(), &entry);
+  if (find_handle == INVALID_HANDLE_VALUE)
+  {
+    throw std::invalid_argument("Error: Directory '" + std::string(dir_path) + "' could not be opened.");
+  }
+  do
+  {
+    if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && has_extension(entry.cFileName, extension))
+    {
+      paths.push_back(dir + entry.cFileName);
+    }
+  } while (FindNextFileA(find_handle, &entry));
+  FindClose(find_handle);
+#else
+  DIR* dir_stream = opendir(dir_path);
+  if (dir_stream == nullptr)
+  {
+    throw std::invalid_argument("Error: Directory '" + std::string(dir_path) + "' could not be opened.");
+  }
+  while (dirent* entry = readdir(dir_stream))
+  {
+    std::string path = dir + entry->d_name;
+    if (has_extension(entry->d_name, extension) && !directory_exists(path.c_str()))
+    {
+      paths.push_back(path);
+    }
+  }
+  closedir(dir_stream);
+#endif
+
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+bool same_file(const char* first_path, const char* second_path)
+{
+  struct stat first, second;
+  if (stat(first_path, &first) != 0 || stat(second_path, &second) != 0)
+  {
+    return false;
+  }
+  // Inode numbers are not filled on Windows, so paths are compared there
+  if (first.st_ino == 0)
+  {
+    return std::strcmp(first_path, second_path) == 0;
+  }
+  return first.st_dev == second.st_dev && first.st_ino == second.st_ino;
+}
+
 std::vector<uint8_t> readfile_count(const char* file_path, size_t read_byte_count)
 {
   std::ifstream infile(file_path, std::ios_base::in | std::ios_base::binary);
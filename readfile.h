@@ -3,10 +3,63 @@
 
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <cstdio>
 #include <string>
 
+// Input file read at explicit positions, so reads don't move a shared position
+// and can be done by another thread than the one that opened the file.
+// On Windows reads of one file must not run at the same time.
+//
+// Throws std::invalid_argument exception if file could not be opened
+// Throws std::runtime_error if file could not be read
+class InputFile
+{
+private:
+  std::string file_path;
+#ifdef _WIN32
+  std::FILE* file;
+#else
+  int fd;
+#endif
+
+public:
+  InputFile(const char* file_path);
+  ~InputFile();
+  InputFile(const InputFile&) = delete;
+  InputFile& operator=(const InputFile&) = delete;
+
+  uint64_t get_size();
+
+  // Reads byte_count bytes at pos from the file start. Short reads are continued until all bytes are read.
+  // Throws std::runtime_error if the file ends before.
+  void read_at(uint64_t pos, uint8_t* bytes, size_t byte_count);
+
+#ifdef __linux__
+  // Descriptor of the file for asynchronous reads by the kernel.
+  int get_fd();
+#endif
+};
+
 bool file_exists(const char* file_path);
 
+// Returns true if dir_path is an existing directory.
+bool directory_exists(const char* dir_path);
+
+// Returns size of file in bytes.
+//
+// Throws std::runtime_error if file size could not be got
+size_t get_file_size(const char* file_path);
+
+// Returns paths of files in directory dir_path whose names end with extension (in any case), sorted by name.
+// Subdirectories are not searched.
+//
+// Throws std::invalid_argument exception if directory could not be opened
+std::vector<std::string> list_files(const char* dir_path, const char* extension);
+
+// Returns true if both paths point to the same existing file.
+bool same_file(const char* first_path, const char* second_path);
+
 // Reads file from file_path into std::vector of bytes.
 // If max_byte_read is more than 0 and less than file size, only reads max_byte_read bytes.
 //
@@ -0,0 +1,103 @@
+#include "reverb-network.h"
+
+/* Freeverb tunings */
+
+namespace tuning
+{
+  const uint32_t SAMPLE_RATE = 44100;
+  const uint32_t COMB[ReverbNetwork::COMB_COUNT] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 };
+  const uint32_t ALLPASS[ReverbNetwork::ALLPASS_COUNT] = { 556, 441, 341, 225 };
+  const uint32_t CHANNEL_SPREAD = 23;
+
+  const float FIXED_GAIN = 0.015f;
+  const float ALLPASS_FEEDBACK = 0.5f;
+  const float SCALE_WET = 3.f;
+  const float SCALE_DAMP = 0.4f;
+  const float SCALE_ROOM = 0.28f;
+  const float OFFSET_ROOM = 0.7f;
+
+  // Added to filter input to keep the feedback loops out of slow denormal numbers.
+  const float DENORMAL_GUARD = 1e-20f;
+}
+
+/* ReverbNetwork implementation */
+
+ReverbNetwork::ReverbNetwork(uint32_t sample_rate, uint16_t num_of_chan, double room_size_01, double damping_01,
+                             double wet_01, double dry_01)
+  : num_of_chan(num_of_chan)
+{
+  feedback = static_cast<float>(room_size_01) * tuning::SCALE_ROOM + tuning::OFFSET_ROOM;
+  damp = static_cast<float>(damping_01) * tuning::SCALE_DAMP;
+  wet = static_cast<float>(wet_01) * tuning::SCALE_WET;
+  dry = static_cast<float>(dry_01);
+
+  double scale = static_cast<double>(sample_rate) / tuning::SAMPLE_RATE;
+  uint32_t offset = 0;
+
+  for (uint16_t channel = 0; channel < num_of_chan; channel++)
+  {
+    uint32_t spread = channel * tuning::CHANNEL_SPREAD;
+    for (size_t idx = 0; idx < COMB_COUNT + ALLPASS_COUNT; idx++)
+    {
+      uint32_t length = idx < COMB_COUNT ? tuning::COMB[idx] : tuning::ALLPASS[idx - COMB_COUNT];
+      length = static_cast<uint32_t>((length + spread) * scale);
+      if (length == 0)
+      {
+        length = 1;
+      }
+
+      DelayFilter filter = { offset, length, 0, 0.f };
+      filters.push_back(filter);
+      offset += length;
+    }
+  }
+
+  arena.assign(offset, 0.f);
+}
+
+void ReverbNetwork::process(float* planes, size_t plane_size, size_t frame_count)
+{
+  float* lines = &arena[0];
+
+  for (uint16_t channel = 0; channel < num_of_chan; channel++)
+  {
+    float* samples = planes + channel * plane_size;
+    DelayFilter* channel_filters = &filters[channel * (COMB_COUNT + ALLPASS_COUNT)];
+
+    for (size_t frame = 0; frame < frame_count; frame++)
+    {
+      DelayFilter* filter = channel_filters;
+      float input = samples[frame] * tuning::FIXED_GAIN + tuning::DENORMAL_GUARD;
+      float out = 0.f;
+
+      // Parallel comb filters
+      for (size_t idx = 0; idx < COMB_COUNT; idx++, filter++)
+      {
+        float* line = lines + filter->offset;
+        float delayed = line[filter->pos];
+        filter->store = delayed * (1.f - damp) + filter->store * damp;
+        line[filter->pos] = input + filter->store * feedback;
+        if (++filter->pos == filter->length)
+        {
+          filter->pos = 0;
+        }
+        out += delayed;
+      }
+
+      // Series all-pass filters
+      for (size_t idx = 0; idx < ALLPASS_COUNT; idx++, filter++)
+      {
+        float* line = lines + filter->offset;
+        float delayed = line[filter->pos];
+        line[filter->pos] = out + delayed * tuning::ALLPASS_FEEDBACK;
+        if (++filter->pos == filter->length)
+        {
+          filter->pos = 0;
+        }
+        out = delayed - out;
+      }
+
+      samples[frame] = out * wet + samples[frame] * dry;
+    }
+  }
+}
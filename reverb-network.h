@@ -0,0 +1,44 @@
+#ifndef REVERBNETWORK_H
+#define REVERBNETWORK_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Schroeder/Freeverb-style reverb network.
+// Every channel runs 8 parallel lowpass-feedback comb filters followed by 4 series all-pass filters.
+// Filter lengths are the Freeverb tunings scaled to the sample rate, and every next channel
+// gets them longer by a spread of 23 samples (at 44.1 kHz), so channels don't sound alike.
+//
+// All delay lines live in one contiguous arena, channel after channel,
+// and frames are processed channel after channel, so the filters of one channel stay in cache.
+class ReverbNetwork
+{
+private:
+  // Comb or all-pass filter: its delay line in the arena and its state.
+  struct DelayFilter
+  {
+    uint32_t offset, length, pos;
+    float store;  // Lowpass state of comb filter
+  };
+
+  uint16_t num_of_chan;
+  float feedback, damp, wet, dry;
+  std::vector<float> arena;
+  std::vector<DelayFilter> filters;  // COMB_COUNT + ALLPASS_COUNT filters of every channel
+
+public:
+  static const size_t COMB_COUNT = 8;
+  static const size_t ALLPASS_COUNT = 4;
+
+  // room_size_01 sets comb feedback (longer reverb), damping_01 sets lowpass damping of combs,
+  // wet_01 and dry_01 are the levels of reverb and original signal in the output.
+  ReverbNetwork(uint32_t sample_rate, uint16_t num_of_chan, double room_size_01, double damping_01,
+                double wet_01, double dry_01);
+
+  // Processes planar frames in place, the plane of channel c starts at planes + c * plane_size.
+  // Frames have to be passed in stream order.
+  void process(float* planes, size_t plane_size, size_t frame_count);
+};
+
+#endif
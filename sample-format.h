@@ -0,0 +1,170 @@
+#ifndef SAMPLEFORMAT_H
+#define SAMPLEFORMAT_H
+
+#include <cstdint>
+#include <cmath>
+
+// Conversion of samples between on-disk types and float from -1 to 1.
+// 8-bit samples are unsigned with silence at 128, other integer samples are signed.
+// Conversion to integer types rounds to nearest and saturates at the type limits.
+namespace samples
+{
+  // Packed 24-bit signed sample, little-endian.
+  struct Int24
+  {
+    uint8_t bytes[3];
+  };
+
+  template <typename T>
+  float to_float(T smpl);
+
+  template <typename T>
+  T from_float(float val);
+
+  // Largest float that is not beyond the largest sample of type T, the lower limit is -1 for all types.
+  // from_float() clips samples beyond these limits. Float samples are not clipped,
+  // but samples beyond full scale are counted as clipped for them too.
+  template <typename T>
+  float clip_level();
+
+  template <>
+  inline float clip_level<uint8_t>()
+  {
+    return 127.f / 128.f;
+  }
+
+  template <>
+  inline float clip_level<int16_t>()
+  {
+    return 32767.f / 32768.f;
+  }
+
+  template <>
+  inline float clip_level<Int24>()
+  {
+    return 8388607.f / 8388608.f;
+  }
+
+  // Every float below 1 is rounded to a sample in range, so the limit is the largest float below 1.
+  template <>
+  inline float clip_level<int32_t>()
+  {
+    return 1.f - 1.f / 16777216.f;
+  }
+
+  template <>
+  inline float clip_level<int64_t>()
+  {
+    return 1.f - 1.f / 16777216.f;
+  }
+
+  template <>
+  inline float clip_level<float>()
+  {
+    return 1.f;
+  }
+
+  template <>
+  inline float clip_level<double>()
+  {
+    return 1.f;
+  }
+
+  // Rounds val and limits it to [min_val, max_val].
+  inline double round_clamp(double val, double min_val, double max_val)
+  {
+    val = std::nearbyint(val);
+    return val < min_val ? min_val : (val > max_val ? max_val : val);
+  }
+
+  template <>
+  inline float to_float<uint8_t>(uint8_t smpl)
+  {
+    return (static_cast<float>(smpl) - 128.f) * (1.f / 128.f);
+  }
+
+  template <>
+  inline uint8_t from_float<uint8_t>(float val)
+  {
+    return static_cast<uint8_t>(round_clamp(val * 128. + 128., 0., 255.));
+  }
+
+  template <>
+  inline float to_float<int16_t>(int16_t smpl)
+  {
+    return static_cast<float>(smpl) * (1.f / 32768.f);
+  }
+
+  template <>
+  inline int16_t from_float<int16_t>(float val)
+  {
+    return static_cast<int16_t>(round_clamp(val * 32768., -32768., 32767.));
+  }
+
+  template <>
+  inline float to_float<Int24>(Int24 smpl)
+  {
+    int32_t val = static_cast<int32_t>(static_cast<uint32_t>(smpl.bytes[0]) << 8 | static_cast<uint32_t>(smpl.bytes[1]) << 16 |
+                                       static_cast<uint32_t>(smpl.bytes[2]) << 24);
+    return static_cast<float>(val) * (1.f / 2147483648.f);
+  }
+
+  template <>
+  inline Int24 from_float<Int24>(float val)
+  {
+    int32_t smpl = static_cast<int32_t>(round_clamp(val * 8388608., -8388608., 8388607.));
+    Int24 packed = { { static_cast<uint8_t>(smpl), static_cast<uint8_t>(smpl >> 8), static_cast<uint8_t>(smpl >> 16) } };
+    return packed;
+  }
+
+  template <>
+  inline float to_float<int32_t>(int32_t smpl)
+  {
+    return static_cast<float>(static_cast<double>(smpl) * (1. / 2147483648.));
+  }
+
+  template <>
+  inline int32_t from_float<int32_t>(float val)
+  {
+    return static_cast<int32_t>(round_clamp(val * 2147483648., -2147483648., 2147483647.));
+  }
+
+  template <>
+  inline float to_float<int64_t>(int64_t smpl)
+  {
+    return static_cast<float>(static_cast<double>(smpl) * (1. / 9223372036854775808.));
+  }
+
+  // 2^63 - 1 is not representable in double, the largest double below 2^63 is used as the limit.
+  template <>
+  inline int64_t from_float<int64_t>(float val)
+  {
+    return static_cast<int64_t>(round_clamp(val * 9223372036854775808., -9223372036854775808., 9223372036854774784.));
+  }
+
+  template <>
+  inline float to_float<float>(float smpl)
+  {
+    return smpl;
+  }
+
+  template <>
+  inline float from_float<float>(float val)
+  {
+    return val;
+  }
+
+  template <>
+  inline float to_float<double>(double smpl)
+  {
+    return static_cast<float>(smpl);
+  }
+
+  template <>
+  inline double from_float<double>(float val)
+  {
+    return val;
+  }
+}
+
+#endif
@@ -0,0 +1,1094 @@
+#include "simd-kernels.h"
+#include "sample-format.h"
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+using samples::Int24;
+
+/* Support functions */
+
+namespace isa
+{
+  const int SCALAR = 0;
+  const int SSE2   = 1;
+  const int AVX2   = 2;
+}
+
+// Picks the best instruction set supported by CPU.
+// It can be lowered with WAVEDIT_KERNELS environment variable set to "scalar" or "sse2".
+int detect_instruction_set();
+
+const int instruction_set_id = detect_instruction_set();
+
+// Number of samples converted at once into a buffer on stack before they are spread to planes.
+const size_t CONVERT_SAMPLES = 1024;
+
+// End of SIMD loop steps of lanes samples. A vector load of packed 24-bit samples takes 4 bytes
+// more than its samples, so there the steps end 2 samples earlier to stay inside the buffer.
+template <typename T>
+inline size_t vector_steps_end(size_t sample_count, size_t lanes)
+{
+  size_t spare = sizeof(T) == 3 ? 2 : 0;
+  return sample_count < spare ? 0 : (sample_count - spare) / lanes * lanes;
+}
+
+void gain_ramp_scalar(float* samples, size_t sample_count, double start_gain, double step, uint64_t first_idx)
+{
+  for (size_t idx = 0; idx < sample_count; idx++)
+  {
+    samples[idx] *= static_cast<float>(kernels::ramp_gain(start_gain, step, first_idx + idx));
+  }
+}
+
+// The original sample is stored to delay line before the result, so delay_line can be samples.
+void add_echo_scalar(float* samples, float* delay_line, size_t sample_count, float decay)
+{
+  for (size_t idx = 0; idx < sample_count; idx++)
+  {
+    float smpl = samples[idx];
+    float delayed = delay_line[idx];
+    delay_line[idx] = smpl;
+    samples[idx] = smpl + decay * delayed;
+  }
+}
+
+uint64_t count_clips_scalar(const float* samples, size_t sample_count, float max_val)
+{
+  uint64_t count = 0;
+  for (size_t idx = 0; idx < sample_count; idx++)
+  {
+    count += (samples[idx] > max_val) | (samples[idx] < -1.f);
+  }
+  return count;
+}
+
+void add_plane_stats_scalar(const float* samples, size_t sample_count, float max_val, kernels::PlaneStats& stats)
+{
+  double sum = 0., square_sum = 0.;
+  for (size_t idx = 0; idx < sample_count; idx++)
+  {
+    float smpl = samples[idx];
+    stats.peak = std::max(stats.peak, std::fabs(smpl));
+    sum += smpl;
+    square_sum += static_cast<double>(smpl) * smpl;
+    stats.full_scale_count += (smpl >= max_val) | (smpl <= -1.f);
+  }
+  stats.sum += sum;
+  stats.square_sum += square_sum;
+}
+
+void min_max_scalar(const float* samples, size_t sample_count, float& min_val, float& max_val)
+{
+  for (size_t idx = 0; idx < sample_count; idx++)
+  {
+    min_val = std::min(min_val, samples[idx]);
+    max_val = std::max(max_val, samples[idx]);
+  }
+}
+
+template <typename T>
+void to_float_scalar(const uint8_t* in, float* out, size_t sample_count)
+{
+  for (size_t idx = 0; idx < sample_count; idx++)
+  {
+    T smpl;
+    memcpy(&smpl, in + idx * sizeof(T), sizeof(T));
+    out[idx] = samples::to_float<T>(smpl);
+  }
+}
+
+template <typename T>
+void from_float_scalar(const float* in, uint8_t* out, size_t sample_count)
+{
+  for (size_t idx = 0; idx < sample_count; idx++)
+  {
+    T smpl = samples::from_float<T>(in[idx]);
+    memcpy(out + idx * sizeof(T), &smpl, sizeof(T));
+  }
+}
+
+void deinterleave_scalar(const float* samples, size_t frame_count, uint16_t channels, float* planes, size_t plane_size)
+{
+  for (size_t frame = 0; frame < frame_count; frame++)
+  {
+    for (uint16_t channel = 0; channel < channels; channel++)
+    {
+      planes[channel * plane_size + frame] = *samples++;
+    }
+  }
+}
+
+void interleave_scalar(const float* planes, size_t plane_size, size_t frame_count, uint16_t channels, float* samples)
+{
+  for (size_t frame = 0; frame < frame_count; frame++)
+  {
+    for (uint16_t channel = 0; channel < channels; channel++)
+    {
+      *samples++ = planes[channel * plane_size + frame];
+    }
+  }
+}
+
+// Gain is computed once for every frame.
+void gain_ramp_s16_scalar(uint8_t* frames, size_t frame_count, uint16_t channels, double start_gain, double step,
+                          uint64_t first_idx, uint64_t* clip_counts)
+{
+  float max_val = samples::clip_level<int16_t>();
+  for (size_t frame = 0; frame < frame_count; frame++)
+  {
+    float gain = static_cast<float>(kernels::ramp_gain(start_gain, step, first_idx + frame));
+    for (uint16_t channel = 0; channel < channels; channel++)
+    {
+      uint8_t* sample = frames + (frame * channels + channel) * sizeof(int16_t);
+      int16_t smpl;
+      memcpy(&smpl, sample, sizeof(int16_t));
+      float val = samples::to_float<int16_t>(smpl) * gain;
+      clip_counts[channel] += (val > max_val) | (val < -1.f);
+      smpl = samples::from_float<int16_t>(val);
+      memcpy(sample, &smpl, sizeof(int16_t));
+    }
+  }
+}
+
+
+/* SSE2 kernels */
+
+#ifdef KERNELS_X86
+
+void gain_ramp_sse2(float* samples, size_t sample_count, double start_gain, double step, uint64_t first_idx)
+{
+  __m128d start_vec = _mm_set1_pd(start_gain), step_vec = _mm_set1_pd(step);
+  __m128d offsets_lo = _mm_setr_pd(0., 1.), offsets_hi = _mm_setr_pd(2., 3.);
+
+  size_t idx = 0;
+  for (; idx + 4 <= sample_count; idx += 4)
+  {
+    __m128d base = _mm_set1_pd(static_cast<double>(first_idx + idx));
+    __m128d gain_lo = _mm_sub_pd(start_vec, _mm_mul_pd(_mm_add_pd(base, offsets_lo), step_vec));
+    __m128d gain_hi = _mm_sub_pd(start_vec, _mm_mul_pd(_mm_add_pd(base, offsets_hi), step_vec));
+    __m128 gain = _mm_movelh_ps(_mm_cvtpd_ps(gain_lo), _mm_cvtpd_ps(gain_hi));
+    _mm_storeu_ps(samples + idx, _mm_mul_ps(_mm_loadu_ps(samples + idx), gain));
+  }
+  gain_ramp_scalar(samples + idx, sample_count - idx, start_gain, step, first_idx + idx);
+}
+
+void add_echo_sse2(float* samples, float* delay_line, size_t sample_count, float decay)
+{
+  __m128 decay_vec = _mm_set1_ps(decay);
+
+  size_t idx = 0;
+  for (; idx + 4 <= sample_count; idx += 4)
+  {
+    __m128 smpl = _mm_loadu_ps(samples + idx);
+    __m128 delayed = _mm_loadu_ps(delay_line + idx);
+    _mm_storeu_ps(delay_line + idx, smpl);
+    _mm_storeu_ps(samples + idx, _mm_add_ps(smpl, _mm_mul_ps(decay_vec, delayed)));
+  }
+  add_echo_scalar(samples + idx, delay_line + idx, sample_count - idx, decay);
+}
+
+// Lanes count clips in 32 bits, so they are summed up after at most CLIP_COUNT_STEPS steps.
+const size_t CLIP_COUNT_STEPS = 1 << 24;
+
+// Clip test gives all bits set in the lane of a clipped sample, that is -1, so it is subtracted from lane counts.
+uint64_t count_clips_sse2(const float* samples, size_t sample_count, float max_val)
+{
+  __m128 max_vec = _mm_set1_ps(max_val), min_vec = _mm_set1_ps(-1.f);
+  uint64_t count = 0;
+
+  size_t idx = 0;
+  while (idx + 4 <= sample_count)
+  {
+    size_t steps_end = std::min(sample_count - (sample_count - idx) % 4, idx + CLIP_COUNT_STEPS * 4);
+    __m128i lane_counts = _mm_setzero_si128();
+    for (; idx < steps_end; idx += 4)
+    {
+      __m128 smpl = _mm_loadu_ps(samples + idx);
+      __m128 clipped = _mm_or_ps(_mm_cmpgt_ps(smpl, max_vec), _mm_cmplt_ps(smpl, min_vec));
+      lane_counts = _mm_sub_epi32(lane_counts, _mm_castps_si128(clipped));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, lane_counts);
+    count += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+  return count + count_clips_scalar(samples + idx, sample_count - idx, max_val);
+}
+
+// Absolute values are taken by clearing the sign bit, sums of the low and high pairs go to double lanes.
+void add_plane_stats_sse2(const float* samples, size_t sample_count, float max_val, kernels::PlaneStats& stats)
+{
+  __m128 max_vec = _mm_set1_ps(max_val), min_vec = _mm_set1_ps(-1.f);
+  __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+  __m128 peak = _mm_set1_ps(stats.peak);
+  __m128d sum = _mm_setzero_pd(), square_sum = _mm_setzero_pd();
+
+  size_t idx = 0;
+  while (idx + 4 <= sample_count)
+  {
+    size_t steps_end = std::min(sample_count - (sample_count - idx) % 4, idx + CLIP_COUNT_STEPS * 4);
+    __m128i lane_counts = _mm_setzero_si128();
+    for (; idx < steps_end; idx += 4)
+    {
+      __m128 smpl = _mm_loadu_ps(samples + idx);
+      peak = _mm_max_ps(peak, _mm_and_ps(smpl, abs_mask));
+      __m128d low = _mm_cvtps_pd(smpl), high = _mm_cvtps_pd(_mm_movehl_ps(smpl, smpl));
+      sum = _mm_add_pd(sum, _mm_add_pd(low, high));
+      square_sum = _mm_add_pd(square_sum, _mm_add_pd(_mm_mul_pd(low, low), _mm_mul_pd(high, high)));
+      __m128 full_scale = _mm_or_ps(_mm_cmpge_ps(smpl, max_vec), _mm_cmple_ps(smpl, min_vec));
+      lane_counts = _mm_sub_epi32(lane_counts, _mm_castps_si128(full_scale));
+    }
+    uint32_t lanes[4];
+    _mm_storeu_si128((__m128i*)lanes, lane_counts);
+    stats.full_scale_count += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+
+  float peaks[4];
+  double sums[2], square_sums[2];
+  _mm_storeu_ps(peaks, peak);
+  _mm_storeu_pd(sums, sum);
+  _mm_storeu_pd(square_sums, square_sum);
+  stats.peak = std::max(std::max(peaks[0], peaks[1]), std::max(peaks[2], peaks[3]));
+  stats.sum += sums[0] + sums[1];
+  stats.square_sum += square_sums[0] + square_sums[1];
+  add_plane_stats_scalar(samples + idx, sample_count - idx, max_val, stats);
+}
+
+void min_max_sse2(const float* samples, size_t sample_count, float& min_val, float& max_val)
+{
+  __m128 min_vec = _mm_set1_ps(min_val), max_vec = _mm_set1_ps(max_val);
+
+  size_t idx = 0;
+  for (; idx + 4 <= sample_count; idx += 4)
+  {
+    __m128 smpl = _mm_loadu_ps(samples + idx);
+    min_vec = _mm_min_ps(min_vec, smpl);
+    max_vec = _mm_max_ps(max_vec, smpl);
+  }
+
+  float mins[4], maxs[4];
+  _mm_storeu_ps(mins, min_vec);
+  _mm_storeu_ps(maxs, max_vec);
+  min_val = *std::min_element(mins, mins + 4);
+  max_val = *std::max_element(maxs, maxs + 4);
+  min_max_scalar(samples + idx, sample_count - idx, min_val, max_val);
+}
+
+// Converts 4 int32 values to float and multiplies them by scale.
+inline __m128 scale4_sse2(__m128i val, float scale)
+{
+  return _mm_mul_ps(_mm_cvtepi32_ps(val), _mm_set1_ps(scale));
+}
+
+// Multiplies 4 floats by scale, limits them to [min_val, max_val] and rounds them to nearest int32.
+// Both limits must be exact in float.
+inline __m128i round4_sse2(__m128 val, float scale, float min_val, float max_val)
+{
+  val = _mm_min_ps(_mm_max_ps(_mm_mul_ps(val, _mm_set1_ps(scale)), _mm_set1_ps(min_val)), _mm_set1_ps(max_val));
+  return _mm_cvtps_epi32(val);
+}
+
+inline __m128 load4_sse2(const uint8_t* in, uint8_t)
+{
+  int32_t bytes;
+  memcpy(&bytes, in, 4);
+  __m128i zero = _mm_setzero_si128();
+  __m128i val = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(bytes), zero), zero);
+  return scale4_sse2(_mm_sub_epi32(val, _mm_set1_epi32(128)), 1.f / 128.f);
+}
+
+inline void store4_sse2(uint8_t* out, __m128 val, uint8_t)
+{
+  __m128i smpl = _mm_add_epi32(round4_sse2(val, 128.f, -128.f, 127.f), _mm_set1_epi32(128));
+  smpl = _mm_packs_epi32(smpl, smpl);
+  int32_t bytes = _mm_cvtsi128_si32(_mm_packus_epi16(smpl, smpl));
+  memcpy(out, &bytes, 4);
+}
+
+inline __m128 load4_sse2(const uint8_t* in, int16_t)
+{
+  __m128i val = _mm_loadl_epi64((const __m128i*)in);
+  return scale4_sse2(_mm_srai_epi32(_mm_unpacklo_epi16(val, val), 16), 1.f / 32768.f);
+}
+
+inline void store4_sse2(uint8_t* out, __m128 val, int16_t)
+{
+  __m128i smpl = round4_sse2(val, 32768.f, -32768.f, 32767.f);
+  _mm_storel_epi64((__m128i*)out, _mm_packs_epi32(smpl, smpl));
+}
+
+// 4 samples are taken from 12 bytes to the upper bytes of 4 int32 values, but 16 bytes are loaded.
+inline __m128 load4_sse2(const uint8_t* in, Int24)
+{
+  __m128i val = _mm_loadu_si128((const __m128i*)in);
+  __m128i first = _mm_unpacklo_epi32(val, _mm_srli_si128(val, 3));
+  __m128i second = _mm_unpacklo_epi32(_mm_srli_si128(val, 6), _mm_srli_si128(val, 9));
+  return scale4_sse2(_mm_slli_epi32(_mm_unpacklo_epi64(first, second), 8), 1.f / 2147483648.f);
+}
+
+inline void store4_sse2(uint8_t* out, __m128 val, Int24)
+{
+  const __m128i low_bytes = _mm_set1_epi32(0xFFFFFF);
+  const __m128i low_dwords = _mm_set_epi32(0, -1, 0, -1);
+  const __m128i low_qword = _mm_set_epi32(0, 0, -1, -1);
+  __m128i smpl = _mm_and_si128(round4_sse2(val, 8388608.f, -8388608.f, 8388607.f), low_bytes);
+
+  // 3 bytes of every sample are joined into 6 bytes of every qword, then into 12 bytes
+  __m128i joined = _mm_or_si128(_mm_and_si128(smpl, low_dwords), _mm_srli_epi64(_mm_andnot_si128(low_dwords, smpl), 8));
+  joined = _mm_or_si128(_mm_and_si128(joined, low_qword), _mm_srli_si128(_mm_andnot_si128(low_qword, joined), 2));
+
+  _mm_storel_epi64((__m128i*)out, joined);
+  int32_t last = _mm_cvtsi128_si32(_mm_srli_si128(joined, 8));
+  memcpy(out + 8, &last, 4);
+}
+
+inline __m128 load4_sse2(const uint8_t* in, int32_t)
+{
+  return scale4_sse2(_mm_loadu_si128((const __m128i*)in), 1.f / 2147483648.f);
+}
+
+// 2^31 is out of int32 range, conversion turns it and larger values to INT32_MIN.
+// The mask of these values turns them to INT32_MAX.
+inline void store4_sse2(uint8_t* out, __m128 val, int32_t)
+{
+  val = _mm_max_ps(_mm_mul_ps(val, _mm_set1_ps(2147483648.f)), _mm_set1_ps(-2147483648.f));
+  __m128i overflow = _mm_castps_si128(_mm_cmpge_ps(val, _mm_set1_ps(2147483648.f)));
+  _mm_storeu_si128((__m128i*)out, _mm_xor_si128(_mm_cvtps_epi32(val), overflow));
+}
+
+inline __m128 load4_sse2(const uint8_t* in, float)
+{
+  return _mm_loadu_ps((const float*)in);
+}
+
+inline void store4_sse2(uint8_t* out, __m128 val, float)
+{
+  _mm_storeu_ps((float*)out, val);
+}
+
+inline __m128 load4_sse2(const uint8_t* in, double)
+{
+  __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd((const double*)in));
+  __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd((const double*)in + 2));
+  return _mm_movelh_ps(lo, hi);
+}
+
+inline void store4_sse2(uint8_t* out, __m128 val, double)
+{
+  _mm_storeu_pd((double*)out, _mm_cvtps_pd(val));
+  _mm_storeu_pd((double*)out + 2, _mm_cvtps_pd(_mm_movehl_ps(val, val)));
+}
+
+template <typename T>
+void to_float_sse2(const uint8_t* in, float* out, size_t sample_count)
+{
+  size_t steps_end = vector_steps_end<T>(sample_count, 4);
+  for (size_t idx = 0; idx < steps_end; idx += 4)
+  {
+    _mm_storeu_ps(out + idx, load4_sse2(in + idx * sizeof(T), T()));
+  }
+  to_float_scalar<T>(in + steps_end * sizeof(T), out + steps_end, sample_count - steps_end);
+}
+
+template <typename T>
+void from_float_sse2(const float* in, uint8_t* out, size_t sample_count)
+{
+  size_t steps_end = sample_count / 4 * 4;
+  for (size_t idx = 0; idx < steps_end; idx += 4)
+  {
+    store4_sse2(out + idx * sizeof(T), _mm_loadu_ps(in + idx), T());
+  }
+  from_float_scalar<T>(in + steps_end, out + steps_end * sizeof(T), sample_count - steps_end);
+}
+
+// Mono and stereo frames take 4 samples a step, lane counts of clips are added to the channels of the lanes.
+// Other frames are faded by the scalar kernel.
+void gain_ramp_s16_sse2(uint8_t* frames, size_t frame_count, uint16_t channels, double start_gain, double step,
+                        uint64_t first_idx, uint64_t* clip_counts)
+{
+  size_t frame = 0;
+  if (channels <= 2)
+  {
+    __m128d start_vec = _mm_set1_pd(start_gain), step_vec = _mm_set1_pd(step);
+    __m128d offsets_lo = _mm_setr_pd(0., 1.), offsets_hi = _mm_setr_pd(2., 3.);
+    __m128 max_vec = _mm_set1_ps(samples::clip_level<int16_t>()), min_vec = _mm_set1_ps(-1.f);
+    size_t frame_step = 4 / channels;
+
+    while (frame + frame_step <= frame_count)
+    {
+      size_t steps_end = std::min(frame_count - (frame_count - frame) % frame_step, frame + CLIP_COUNT_STEPS * frame_step);
+      __m128i lane_counts = _mm_setzero_si128();
+      for (; frame < steps_end; frame += frame_step)
+      {
+        __m128d base = _mm_set1_pd(static_cast<double>(first_idx + frame));
+        __m128 gain = _mm_cvtpd_ps(_mm_sub_pd(start_vec, _mm_mul_pd(_mm_add_pd(base, offsets_lo), step_vec)));
+        if (channels == 1)
+        {
+          __m128d gain_hi = _mm_sub_pd(start_vec, _mm_mul_pd(_mm_add_pd(base, offsets_hi), step_vec));
+          gain = _mm_movelh_ps(gain, _mm_cvtpd_ps(gain_hi));
+        }
+        else
+        {
+          gain = _mm_unpacklo_ps(gain, gain);
+        }
+
+        uint8_t* sample = frames + frame * channels * sizeof(int16_t);
+        __m128 val = _mm_mul_ps(load4_sse2(sample, int16_t()), gain);
+        __m128 clipped = _mm_or_ps(_mm_cmpgt_ps(val, max_vec), _mm_cmplt_ps(val, min_vec));
+        lane_counts = _mm_sub_epi32(lane_counts, _mm_castps_si128(clipped));
+        store4_sse2(sample, val, int16_t());
+      }
+      uint32_t lanes[4];
+      _mm_storeu_si128((__m128i*)lanes, lane_counts);
+      for (size_t lane = 0; lane < 4; lane++)
+      {
+        clip_counts[lane % channels] += lanes[lane];
+      }
+    }
+  }
+  gain_ramp_s16_scalar(frames + frame * channels * sizeof(int16_t), frame_count - frame, channels, start_gain, step,
+                       first_idx + frame, clip_counts);
+}
+
+// Stereo frames are split into two planes by shuffles of 4 frames.
+void deinterleave_stereo_sse2(const float* samples, size_t frame_count, float* planes, size_t plane_size)
+{
+  float* left = planes;
+  float* right = planes + plane_size;
+
+  size_t frame = 0;
+  for (; frame + 4 <= frame_count; frame += 4, samples += 8)
+  {
+    __m128 first = _mm_loadu_ps(samples);
+    __m128 second = _mm_loadu_ps(samples + 4);
+    _mm_storeu_ps(left + frame, _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)));
+    _mm_storeu_ps(right + frame, _mm_shuffle_ps(first, second, _MM_SHUFFLE(3, 1, 3, 1)));
+  }
+  deinterleave_scalar(samples, frame_count - frame, 2, planes + frame, plane_size);
+}
+
+void interleave_stereo_sse2(const float* planes, size_t plane_size, size_t frame_count, float* samples)
+{
+  const float* left = planes;
+  const float* right = planes + plane_size;
+
+  size_t frame = 0;
+  for (; frame + 4 <= frame_count; frame += 4, samples += 8)
+  {
+    __m128 left_vec = _mm_loadu_ps(left + frame);
+    __m128 right_vec = _mm_loadu_ps(right + frame);
+    _mm_storeu_ps(samples, _mm_unpacklo_ps(left_vec, right_vec));
+    _mm_storeu_ps(samples + 4, _mm_unpackhi_ps(left_vec, right_vec));
+  }
+  interleave_scalar(planes + frame, plane_size, frame_count - frame, 2, samples);
+}
+
+
+/* AVX2 kernels */
+
+__attribute__((target("avx2")))
+void gain_ramp_avx2(float* samples, size_t sample_count, double start_gain, double step, uint64_t first_idx)
+{
+  __m256d start_vec = _mm256_set1_pd(start_gain), step_vec = _mm256_set1_pd(step);
+  __m256d offsets_lo = _mm256_setr_pd(0., 1., 2., 3.), offsets_hi = _mm256_setr_pd(4., 5., 6., 7.);
+
+  size_t idx = 0;
+  for (; idx + 8 <= sample_count; idx += 8)
+  {
+    __m256d base = _mm256_set1_pd(static_cast<double>(first_idx + idx));
+    __m256d gain_lo = _mm256_sub_pd(start_vec, _mm256_mul_pd(_mm256_add_pd(base, offsets_lo), step_vec));
+    __m256d gain_hi = _mm256_sub_pd(start_vec, _mm256_mul_pd(_mm256_add_pd(base, offsets_hi), step_vec));
+    __m256 gain = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(gain_lo)), _mm256_cvtpd_ps(gain_hi), 1);
+    _mm256_storeu_ps(samples + idx, _mm256_mul_ps(_mm256_loadu_ps(samples + idx), gain));
+  }
+  gain_ramp_sse2(samples + idx, sample_count - idx, start_gain, step, first_idx + idx);
+}
+
+__attribute__((target("avx2")))
+void add_echo_avx2(float* samples, float* delay_line, size_t sample_count, float decay)
+{
+  __m256 decay_vec = _mm256_set1_ps(decay);
+
+  size_t idx = 0;
+  for (; idx + 8 <= sample_count; idx += 8)
+  {
+    __m256 smpl = _mm256_loadu_ps(samples + idx);
+    __m256 delayed = _mm256_loadu_ps(delay_line + idx);
+    _mm256_storeu_ps(delay_line + idx, smpl);
+    _mm256_storeu_ps(samples + idx, _mm256_add_ps(smpl, _mm256_mul_ps(decay_vec, delayed)));
+  }
+  add_echo_sse2(samples + idx, delay_line + idx, sample_count - idx, decay);
+}
+
+__attribute__((target("avx2")))
+uint64_t count_clips_avx2(const float* samples, size_t sample_count, float max_val)
+{
+  __m256 max_vec = _mm256_set1_ps(max_val), min_vec = _mm256_set1_ps(-1.f);
+  uint64_t count = 0;
+
+  size_t idx = 0;
+  while (idx + 8 <= sample_count)
+  {
+    size_t steps_end = std::min(sample_count - (sample_count - idx) % 8, idx + CLIP_COUNT_STEPS * 8);
+    __m256i lane_counts = _mm256_setzero_si256();
+    for (; idx < steps_end; idx += 8)
+    {
+      __m256 smpl = _mm256_loadu_ps(samples + idx);
+      __m256 clipped = _mm256_or_ps(_mm256_cmp_ps(smpl, max_vec, _CMP_GT_OQ), _mm256_cmp_ps(smpl, min_vec, _CMP_LT_OQ));
+      lane_counts = _mm256_sub_epi32(lane_counts, _mm256_castps_si256(clipped));
+    }
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, lane_counts);
+    for (uint32_t lane : lanes)
+    {
+      count += lane;
+    }
+  }
+  return count + count_clips_sse2(samples + idx, sample_count - idx, max_val);
+}
+
+__attribute__((target("avx2")))
+void add_plane_stats_avx2(const float* samples, size_t sample_count, float max_val, kernels::PlaneStats& stats)
+{
+  __m256 max_vec = _mm256_set1_ps(max_val), min_vec = _mm256_set1_ps(-1.f);
+  __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+  __m256 peak = _mm256_set1_ps(stats.peak);
+  __m256d sum = _mm256_setzero_pd(), square_sum = _mm256_setzero_pd();
+
+  size_t idx = 0;
+  while (idx + 8 <= sample_count)
+  {
+    size_t steps_end = std::min(sample_count - (sample_count - idx) % 8, idx + CLIP_COUNT_STEPS * 8);
+    __m256i lane_counts = _mm256_setzero_si256();
+    for (; idx < steps_end; idx += 8)
+    {
+      __m256 smpl = _mm256_loadu_ps(samples + idx);
+      peak = _mm256_max_ps(peak, _mm256_and_ps(smpl, abs_mask));
+      __m256d low = _mm256_cvtps_pd(_mm256_castps256_ps128(smpl)), high = _mm256_cvtps_pd(_mm256_extractf128_ps(smpl, 1));
+      sum = _mm256_add_pd(sum, _mm256_add_pd(low, high));
+      square_sum = _mm256_add_pd(square_sum, _mm256_add_pd(_mm256_mul_pd(low, low), _mm256_mul_pd(high, high)));
+      __m256 full_scale = _mm256_or_ps(_mm256_cmp_ps(smpl, max_vec, _CMP_GE_OQ), _mm256_cmp_ps(smpl, min_vec, _CMP_LE_OQ));
+      lane_counts = _mm256_sub_epi32(lane_counts, _mm256_castps_si256(full_scale));
+    }
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, lane_counts);
+    for (uint32_t lane : lanes)
+    {
+      stats.full_scale_count += lane;
+    }
+  }
+
+  float peaks[8];
+  double sums[4], square_sums[4];
+  _mm256_storeu_ps(peaks, peak);
+  _mm256_storeu_pd(sums, sum);
+  _mm256_storeu_pd(square_sums, square_sum);
+  stats.peak = *std::max_element(peaks, peaks + 8);
+  stats.sum += (sums[0] + sums[1]) + (sums[2] + sums[3]);
+  stats.square_sum += (square_sums[0] + square_sums[1]) + (square_sums[2] + square_sums[3]);
+  add_plane_stats_sse2(samples + idx, sample_count - idx, max_val, stats);
+}
+
+__attribute__((target("avx2")))
+void min_max_avx2(const float* samples, size_t sample_count, float& min_val, float& max_val)
+{
+  __m256 min_vec = _mm256_set1_ps(min_val), max_vec = _mm256_set1_ps(max_val);
+
+  size_t idx = 0;
+  for (; idx + 8 <= sample_count; idx += 8)
+  {
+    __m256 smpl = _mm256_loadu_ps(samples + idx);
+    min_vec = _mm256_min_ps(min_vec, smpl);
+    max_vec = _mm256_max_ps(max_vec, smpl);
+  }
+
+  float mins[8], maxs[8];
+  _mm256_storeu_ps(mins, min_vec);
+  _mm256_storeu_ps(maxs, max_vec);
+  min_val = *std::min_element(mins, mins + 8);
+  max_val = *std::max_element(maxs, maxs + 8);
+  min_max_sse2(samples + idx, sample_count - idx, min_val, max_val);
+}
+
+__attribute__((target("avx2")))
+inline __m256 scale8_avx2(__m256i val, float scale)
+{
+  return _mm256_mul_ps(_mm256_cvtepi32_ps(val), _mm256_set1_ps(scale));
+}
+
+__attribute__((target("avx2")))
+inline __m256i round8_avx2(__m256 val, float scale, float min_val, float max_val)
+{
+  val = _mm256_mul_ps(val, _mm256_set1_ps(scale));
+  val = _mm256_min_ps(_mm256_max_ps(val, _mm256_set1_ps(min_val)), _mm256_set1_ps(max_val));
+  return _mm256_cvtps_epi32(val);
+}
+
+__attribute__((target("avx2")))
+inline __m256 load8_avx2(const uint8_t* in, uint8_t)
+{
+  __m256i val = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)in));
+  return scale8_avx2(_mm256_sub_epi32(val, _mm256_set1_epi32(128)), 1.f / 128.f);
+}
+
+__attribute__((target("avx2")))
+inline void store8_avx2(uint8_t* out, __m256 val, uint8_t)
+{
+  __m256i smpl = _mm256_add_epi32(round8_avx2(val, 128.f, -128.f, 127.f), _mm256_set1_epi32(128));
+  __m128i words = _mm_packs_epi32(_mm256_castsi256_si128(smpl), _mm256_extracti128_si256(smpl, 1));
+  _mm_storel_epi64((__m128i*)out, _mm_packus_epi16(words, words));
+}
+
+__attribute__((target("avx2")))
+inline __m256 load8_avx2(const uint8_t* in, int16_t)
+{
+  return scale8_avx2(_mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)in)), 1.f / 32768.f);
+}
+
+__attribute__((target("avx2")))
+inline void store8_avx2(uint8_t* out, __m256 val, int16_t)
+{
+  __m256i smpl = round8_avx2(val, 32768.f, -32768.f, 32767.f);
+  _mm_storeu_si128((__m128i*)out, _mm_packs_epi32(_mm256_castsi256_si128(smpl), _mm256_extracti128_si256(smpl, 1)));
+}
+
+// Every 128-bit lane takes 4 samples from 12 bytes, but 16 bytes are loaded for every lane.
+__attribute__((target("avx2")))
+inline __m256 load8_avx2(const uint8_t* in, Int24)
+{
+  const __m256i spread = _mm256_setr_epi8(-1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+                                          -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11);
+  __m256i val = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)in)),
+                                        _mm_loadu_si128((const __m128i*)(in + 12)), 1);
+  return scale8_avx2(_mm256_shuffle_epi8(val, spread), 1.f / 2147483648.f);
+}
+
+// The lower lane is stored with 4 extra bytes, which the upper lane overwrites.
+__attribute__((target("avx2")))
+inline void store8_avx2(uint8_t* out, __m256 val, Int24)
+{
+  const __m256i join = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                        0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  __m256i smpl = _mm256_shuffle_epi8(round8_avx2(val, 8388608.f, -8388608.f, 8388607.f), join);
+
+  __m128i high = _mm256_extracti128_si256(smpl, 1);
+  _mm_storeu_si128((__m128i*)out, _mm256_castsi256_si128(smpl));
+  _mm_storel_epi64((__m128i*)(out + 12), high);
+  int32_t last = _mm_cvtsi128_si32(_mm_srli_si128(high, 8));
+  memcpy(out + 20, &last, 4);
+}
+
+__attribute__((target("avx2")))
+inline __m256 load8_avx2(const uint8_t* in, int32_t)
+{
+  return scale8_avx2(_mm256_loadu_si256((const __m256i*)in), 1.f / 2147483648.f);
+}
+
+// Overflow is fixed like in store4_sse2().
+__attribute__((target("avx2")))
+inline void store8_avx2(uint8_t* out, __m256 val, int32_t)
+{
+  val = _mm256_max_ps(_mm256_mul_ps(val, _mm256_set1_ps(2147483648.f)), _mm256_set1_ps(-2147483648.f));
+  __m256i overflow = _mm256_castps_si256(_mm256_cmp_ps(val, _mm256_set1_ps(2147483648.f), _CMP_GE_OQ));
+  _mm256_storeu_si256((__m256i*)out, _mm256_xor_si256(_mm256_cvtps_epi32(val), overflow));
+}
+
+__attribute__((target("avx2")))
+inline __m256 load8_avx2(const uint8_t* in, float)
+{
+  return _mm256_loadu_ps((const float*)in);
+}
+
+__attribute__((target("avx2")))
+inline void store8_avx2(uint8_t* out, __m256 val, float)
+{
+  _mm256_storeu_ps((float*)out, val);
+}
+
+__attribute__((target("avx2")))
+inline __m256 load8_avx2(const uint8_t* in, double)
+{
+  __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd((const double*)in));
+  __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd((const double*)in + 4));
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+}
+
+__attribute__((target("avx2")))
+inline void store8_avx2(uint8_t* out, __m256 val, double)
+{
+  _mm256_storeu_pd((double*)out, _mm256_cvtps_pd(_mm256_castps256_ps128(val)));
+  _mm256_storeu_pd((double*)out + 4, _mm256_cvtps_pd(_mm256_extractf128_ps(val, 1)));
+}
+
+template <typename T>
+__attribute__((target("avx2")))
+void to_float_avx2(const uint8_t* in, float* out, size_t sample_count)
+{
+  size_t steps_end = vector_steps_end<T>(sample_count, 8);
+  for (size_t idx = 0; idx < steps_end; idx += 8)
+  {
+    _mm256_storeu_ps(out + idx, load8_avx2(in + idx * sizeof(T), T()));
+  }
+  to_float_sse2<T>(in + steps_end * sizeof(T), out + steps_end, sample_count - steps_end);
+}
+
+template <typename T>
+__attribute__((target("avx2")))
+void from_float_avx2(const float* in, uint8_t* out, size_t sample_count)
+{
+  size_t steps_end = sample_count / 8 * 8;
+  for (size_t idx = 0; idx < steps_end; idx += 8)
+  {
+    store8_avx2(out + idx * sizeof(T), _mm256_loadu_ps(in + idx), T());
+  }
+  from_float_sse2<T>(in + steps_end, out + steps_end * sizeof(T), sample_count - steps_end);
+}
+
+// Like gain_ramp_s16_sse2(), with 8 samples a step.
+__attribute__((target("avx2")))
+void gain_ramp_s16_avx2(uint8_t* frames, size_t frame_count, uint16_t channels, double start_gain, double step,
+                        uint64_t first_idx, uint64_t* clip_counts)
+{
+  size_t frame = 0;
+  if (channels <= 2)
+  {
+    __m256d start_vec = _mm256_set1_pd(start_gain), step_vec = _mm256_set1_pd(step);
+    __m256d offsets_lo = _mm256_setr_pd(0., 1., 2., 3.), offsets_hi = _mm256_setr_pd(4., 5., 6., 7.);
+    __m256 max_vec = _mm256_set1_ps(samples::clip_level<int16_t>()), min_vec = _mm256_set1_ps(-1.f);
+    size_t frame_step = 8 / channels;
+
+    while (frame + frame_step <= frame_count)
+    {
+      size_t steps_end = std::min(frame_count - (frame_count - frame) % frame_step, frame + CLIP_COUNT_STEPS * frame_step);
+      __m256i lane_counts = _mm256_setzero_si256();
+      for (; frame < steps_end; frame += frame_step)
+      {
+        __m256d base = _mm256_set1_pd(static_cast<double>(first_idx + frame));
+        __m128 gain_lo = _mm256_cvtpd_ps(_mm256_sub_pd(start_vec, _mm256_mul_pd(_mm256_add_pd(base, offsets_lo), step_vec)));
+        __m128 gain_hi;
+        if (channels == 1)
+        {
+          gain_hi = _mm256_cvtpd_ps(_mm256_sub_pd(start_vec, _mm256_mul_pd(_mm256_add_pd(base, offsets_hi), step_vec)));
+        }
+        else
+        {
+          gain_hi = _mm_unpackhi_ps(gain_lo, gain_lo);
+          gain_lo = _mm_unpacklo_ps(gain_lo, gain_lo);
+        }
+        __m256 gain = _mm256_insertf128_ps(_mm256_castps128_ps256(gain_lo), gain_hi, 1);
+
+        uint8_t* sample = frames + frame * channels * sizeof(int16_t);
+        __m256 val = _mm256_mul_ps(load8_avx2(sample, int16_t()), gain);
+        __m256 clipped = _mm256_or_ps(_mm256_cmp_ps(val, max_vec, _CMP_GT_OQ), _mm256_cmp_ps(val, min_vec, _CMP_LT_OQ));
+        lane_counts = _mm256_sub_epi32(lane_counts, _mm256_castps_si256(clipped));
+        store8_avx2(sample, val, int16_t());
+      }
+      uint32_t lanes[8];
+      _mm256_storeu_si256((__m256i*)lanes, lane_counts);
+      for (size_t lane = 0; lane < 8; lane++)
+      {
+        clip_counts[lane % channels] += lanes[lane];
+      }
+    }
+  }
+  gain_ramp_s16_sse2(frames + frame * channels * sizeof(int16_t), frame_count - frame, channels, start_gain, step,
+                     first_idx + frame, clip_counts);
+}
+
+#endif
+
+
+/* Dispatch */
+
+template <typename T>
+void to_float_dispatch(const uint8_t* in, float* out, size_t sample_count)
+{
+#ifdef KERNELS_X86
+  if (instruction_set_id == isa::AVX2)
+  {
+    to_float_avx2<T>(in, out, sample_count);
+    return;
+  }
+  if (instruction_set_id == isa::SSE2)
+  {
+    to_float_sse2<T>(in, out, sample_count);
+    return;
+  }
+#endif
+  to_float_scalar<T>(in, out, sample_count);
+}
+
+template <typename T>
+void from_float_dispatch(const float* in, uint8_t* out, size_t sample_count)
+{
+#ifdef KERNELS_X86
+  if (instruction_set_id == isa::AVX2)
+  {
+    from_float_avx2<T>(in, out, sample_count);
+    return;
+  }
+  if (instruction_set_id == isa::SSE2)
+  {
+    from_float_sse2<T>(in, out, sample_count);
+    return;
+  }
+#endif
+  from_float_scalar<T>(in, out, sample_count);
+}
+
+template <>
+void to_float_dispatch<int64_t>(const uint8_t* in, float* out, size_t sample_count)
+{
+  to_float_scalar<int64_t>(in, out, sample_count);
+}
+
+template <>
+void from_float_dispatch<int64_t>(const float* in, uint8_t* out, size_t sample_count)
+{
+  from_float_scalar<int64_t>(in, out, sample_count);
+}
+
+void deinterleave_dispatch(const float* samples, size_t frame_count, uint16_t channels, float* planes, size_t plane_size)
+{
+#ifdef KERNELS_X86
+  if (channels == 2 && instruction_set_id != isa::SCALAR)
+  {
+    deinterleave_stereo_sse2(samples, frame_count, planes, plane_size);
+    return;
+  }
+#endif
+  deinterleave_scalar(samples, frame_count, channels, planes, plane_size);
+}
+
+void interleave_dispatch(const float* planes, size_t plane_size, size_t frame_count, uint16_t channels, float* samples)
+{
+#ifdef KERNELS_X86
+  if (channels == 2 && instruction_set_id != isa::SCALAR)
+  {
+    interleave_stereo_sse2(planes, plane_size, frame_count, samples);
+    return;
+  }
+#endif
+  interleave_scalar(planes, plane_size, frame_count, channels, samples);
+}
+
+void kernels::gain_ramp(float* samples, size_t sample_count, double start_gain, double step, uint64_t first_idx)
+{
+#ifdef KERNELS_X86
+  if (instruction_set_id == isa::AVX2)
+  {
+    gain_ramp_avx2(samples, sample_count, start_gain, step, first_idx);
+    return;
+  }
+  if (instruction_set_id == isa::SSE2)
+  {
+    gain_ramp_sse2(samples, sample_count, start_gain, step, first_idx);
+    return;
+  }
+#endif
+  gain_ramp_scalar(samples, sample_count, start_gain, step, first_idx);
+}
+
+void kernels::gain_ramp_s16(uint8_t* frames, size_t frame_count, uint16_t channels, double start_gain, double step,
+                            uint64_t first_idx, uint64_t* clip_counts)
+{
+#ifdef KERNELS_X86
+  if (instruction_set_id == isa::AVX2)
+  {
+    gain_ramp_s16_avx2(frames, frame_count, channels, start_gain, step, first_idx, clip_counts);
+    return;
+  }
+  if (instruction_set_id == isa::SSE2)
+  {
+    gain_ramp_s16_sse2(frames, frame_count, channels, start_gain, step, first_idx, clip_counts);
+    return;
+  }
+#endif
+  gain_ramp_s16_scalar(frames, frame_count, channels, start_gain, step, first_idx, clip_counts);
+}
+
+void kernels::add_echo(float* samples, float* delay_line, size_t sample_count, float decay)
+{
+#ifdef KERNELS_X86
+  if (instruction_set_id == isa::AVX2)
+  {
+    add_echo_avx2(samples, delay_line, sample_count, decay);
+    return;
+  }
+  if (instruction_set_id == isa::SSE2)
+  {
+    add_echo_sse2(samples, delay_line, sample_count, decay);
+    return;
+  }
+#endif
+  add_echo_scalar(samples, delay_line, sample_count, decay);
+}
+
+uint64_t kernels::count_clips(const float* samples, size_t sample_count, float max_val)
+{
+#ifdef KERNELS_X86
+  if (instruction_set_id == isa::AVX2)
+  {
+    return count_clips_avx2(samples, sample_count, max_val);
+  }
+  if (instruction_set_id == isa::SSE2)
+  {
+    return count_clips_sse2(samples, sample_count, max_val);
+  }
+#endif
+  return count_clips_scalar(samples, sample_count, max_val);
+}
+
+void kernels::add_plane_stats(const float* samples, size_t sample_count, float max_val, PlaneStats& stats)
+{
+#ifdef KERNELS_X86
+  if (instruction_set_id == isa::AVX2)
+  {
+    add_plane_stats_avx2(samples, sample_count, max_val, stats);
+    return;
+  }
+  if (instruction_set_id == isa::SSE2)
+  {
+    add_plane_stats_sse2(samples, sample_count, max_val, stats);
+    return;
+  }
+#endif
+  add_plane_stats_scalar(samples, sample_count, max_val, stats);
+}
+
+void kernels::min_max(const float* samples, size_t sample_count, float& min_val, float& max_val)
+{
+#ifdef KERNELS_X86
+  if (instruction_set_id == isa::AVX2)
+  {
+    min_max_avx2(samples, sample_count, min_val, max_val);
+    return;
+  }
+  if (instruction_set_id == isa::SSE2)
+  {
+    min_max_sse2(samples, sample_count, min_val, max_val);
+    return;
+  }
+#endif
+  min_max_scalar(samples, sample_count, min_val, max_val);
+}
+
+// Mono samples are converted right into the plane.
+// Other frames are converted by tiles of CONVERT_SAMPLES samples, which are spread to planes then.
+template <typename T>
+void kernels::to_planar(const uint8_t* frames, size_t frame_count, uint16_t channels, float* planes, size_t plane_size)
+{
+  if (channels == 1)
+  {
+    to_float_dispatch<T>(frames, planes, frame_count);
+    return;
+  }
+
+  float stack_buffer[CONVERT_SAMPLES];
+  std::vector<float> heap_buffer;
+  float* buffer = stack_buffer;
+  if (channels > CONVERT_SAMPLES)
+  {
+    heap_buffer.resize(channels);
+    buffer = &heap_buffer[0];
+  }
+
+  size_t tile_frames = std::max<size_t>(1, CONVERT_SAMPLES / channels);
+  for (size_t frame = 0; frame < frame_count; frame += tile_frames)
+  {
+    size_t count = std::min(tile_frames, frame_count - frame);
+    to_float_dispatch<T>(frames + frame * channels * sizeof(T), buffer, count * channels);
+    deinterleave_dispatch(buffer, count, channels, planes + frame, plane_size);
+  }
+}
+
+template <typename T>
+void kernels::from_planar(const float* planes, size_t plane_size, size_t frame_count, uint16_t channels, uint8_t* frames)
+{
+  if (channels == 1)
+  {
+    from_float_dispatch<T>(planes, frames, frame_count);
+    return;
+  }
+
+  float stack_buffer[CONVERT_SAMPLES];
+  std::vector<float> heap_buffer;
+  float* buffer = stack_buffer;
+  if (channels > CONVERT_SAMPLES)
+  {
+    heap_buffer.resize(channels);
+    buffer = &heap_buffer[0];
+  }
+
+  size_t tile_frames = std::max<size_t>(1, CONVERT_SAMPLES / channels);
+  for (size_t frame = 0; frame < frame_count; frame += tile_frames)
+  {
+    size_t count = std::min(tile_frames, frame_count - frame);
+    interleave_dispatch(planes + frame, plane_size, count, channels, buffer);
+    from_float_dispatch<T>(buffer, frames + frame * channels * sizeof(T), count * channels);
+  }
+}
+
+template void kernels::to_planar<uint8_t>(const uint8_t*, size_t, uint16_t, float*, size_t);
+template void kernels::to_planar<int16_t>(const uint8_t*, size_t, uint16_t, float*, size_t);
+template void kernels::to_planar<Int24>(const uint8_t*, size_t, uint16_t, float*, size_t);
+template void kernels::to_planar<int32_t>(const uint8_t*, size_t, uint16_t, float*, size_t);
+template void kernels::to_planar<int64_t>(const uint8_t*, size_t, uint16_t, float*, size_t);
+template void kernels::to_planar<float>(const uint8_t*, size_t, uint16_t, float*, size_t);
+template void kernels::to_planar<double>(const uint8_t*, size_t, uint16_t, float*, size_t);
+
+template void kernels::from_planar<uint8_t>(const float*, size_t, size_t, uint16_t, uint8_t*);
+template void kernels::from_planar<int16_t>(const float*, size_t, size_t, uint16_t, uint8_t*);
+template void kernels::from_planar<Int24>(const float*, size_t, size_t, uint16_t, uint8_t*);
+template void kernels::from_planar<int32_t>(const float*, size_t, size_t, uint16_t, uint8_t*);
+template void kernels::from_planar<int64_t>(const float*, size_t, size_t, uint16_t, uint8_t*);
+template void kernels::from_planar<float>(const float*, size_t, size_t, uint16_t, uint8_t*);
+template void kernels::from_planar<double>(const float*, size_t, size_t, uint16_t, uint8_t*);
+
+const char* kernels::instruction_set()
+{
+  switch (instruction_set_id)
+  {
+  case isa::AVX2:
+    return "avx2";
+  case isa::SSE2:
+    return "sse2";
+  default:
+    return "scalar";
+  }
+}
+
+
+/* Support functions implementation */
+
+int detect_instruction_set()
+{
+  int best = isa::SCALAR;
+#ifdef KERNELS_X86
+  __builtin_cpu_init();
+  best = __builtin_cpu_supports("avx2") ? isa::AVX2 : isa::SSE2;
+#endif
+
+  const char* requested = std::getenv("WAVEDIT_KERNELS");
+  if (requested != nullptr)
+  {
+    if (std::string(requested) == "scalar")
+    {
+      return isa::SCALAR;
+    }
+    if (std::string(requested) == "sse2" && best > isa::SSE2)
+    {
+      return isa::SSE2;
+    }
+  }
+  return best;
+}
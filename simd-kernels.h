@@ -0,0 +1,72 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+#include <cstdint>
+#include <cstddef>
+
+// Vectorized sample kernels.
+// Every kernel has SSE2 and AVX2 versions chosen at runtime by CPU support and a scalar fallback.
+// Effects work on planar float samples: the samples of every channel are a plane of their own,
+// the plane of channel c starts at planes + c * plane_size. Samples can be unaligned.
+namespace kernels
+{
+  // Gain of frame idx in a linear gain ramp.
+  // All kernel versions compute the gain with this exact expression, so their results are bit-exact.
+  inline double ramp_gain(double start_gain, double step, uint64_t idx)
+  {
+    return start_gain - static_cast<double>(idx) * step;
+  }
+
+  // Multiplies sample_count samples of a plane by a linear gain ramp.
+  // Sample k gets gain ramp_gain(start_gain, step, first_idx + k) rounded to float,
+  // so results do not depend on how the plane is split between calls.
+  void gain_ramp(float* samples, size_t sample_count, double start_gain, double step, uint64_t first_idx);
+
+  // Multiplies frame_count frames of interleaved 16-bit samples by a linear gain ramp right in place,
+  // without planar float samples between. Every sample of frame k gets gain ramp_gain(start_gain, step, first_idx + k),
+  // so results are bit-exact with to_planar(), gain_ramp() and from_planar(). Samples clipped on the way,
+  // see count_clips(), are added to the counts of their channels in clip_counts.
+  // Mono and stereo frames are faded with SIMD, other frames by the scalar fallback.
+  void gain_ramp_s16(uint8_t* frames, size_t frame_count, uint16_t channels, double start_gain, double step,
+                     uint64_t first_idx, uint64_t* clip_counts);
+
+  // Adds echo to sample_count samples of a plane: every sample gets the sample of delay_line
+  // multiplied by decay, and the original sample takes its place in delay_line.
+  // delay_line can be samples itself, then every sample gets its own echo.
+  void add_echo(float* samples, float* delay_line, size_t sample_count, float decay);
+
+  // Converts frame_count frames of interleaved samples of type T to planar float samples, see samples::to_float().
+  // T is uint8_t, int16_t, samples::Int24, int32_t, int64_t, float or double.
+  // Mono and stereo frames are spread to planes with SIMD too. 64-bit samples have no SIMD version.
+  template <typename T>
+  void to_planar(const uint8_t* frames, size_t frame_count, uint16_t channels, float* planes, size_t plane_size);
+
+  // Converts frame_count frames of planar float samples to interleaved samples of type T.
+  // Integer samples are rounded to nearest and saturated like samples::from_float().
+  template <typename T>
+  void from_planar(const float* planes, size_t plane_size, size_t frame_count, uint16_t channels, uint8_t* frames);
+
+  // Number of samples above max_val or below -1, see samples::clip_level().
+  uint64_t count_clips(const float* samples, size_t sample_count, float max_val);
+
+  // Statistics of the samples of a plane, see add_plane_stats().
+  struct PlaneStats
+  {
+    float peak = 0.f;                // largest absolute value
+    double sum = 0., square_sum = 0.;
+    uint64_t full_scale_count = 0;   // samples not below max_val or not above -1
+  };
+
+  // Adds sample_count samples of a plane to stats.
+  // Sums are accumulated in double, in a different order by every kernel version,
+  // so they can differ in the last bits between instruction sets.
+  void add_plane_stats(const float* samples, size_t sample_count, float max_val, PlaneStats& stats);
+
+  // Extends range [min_val, max_val] to the samples of a plane. Results are the same for all instruction sets.
+  void min_max(const float* samples, size_t sample_count, float& min_val, float& max_val);
+
+  // Name of the instruction set used by kernels on this CPU: "avx2", "sse2" or "scalar".
+  const char* instruction_set();
+}
+
+#endif
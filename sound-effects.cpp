@@ -1,80 +1,385 @@
 #include "sound-effects.h"
 #include "wav-header.h"
 #include "mode-options.h"
+#include "simd-kernels.h"
+#include "sample-format.h"
+#include "reverb-network.h"
+#include "thread-pool.h"
+#include "stage-stats.h"
+#include "peak-file.h"
 
 #include <stdexcept>
 #include <limits>
+#include <memory>
+#include <algorithm>
+#include <mutex>
+#include <cmath>
 #include <type_traits>
 
 
 /* Support functions */
 
-template<typename T>
-T read_from_bytes(std::vector<uint8_t>& bytes, uint32_t pos);
+// Index of the frame of time point in data, see TimePoint::to_frame().
+// Throws std::invalid_argument exception if the frame is after the end of data.
+uint64_t time_to_frame_count(WavHeader& header, const TimePoint& time);
 
-template<typename T>
-void write_to_bytes(std::vector<uint8_t>& bytes, uint32_t pos, T val);
+// Analyzes data in memory that starts with the first frame, see effects::analyze().
+Analysis analyze_data(WavHeader& header, const uint8_t* data, AnalyzeOptions& options);
 
-uint32_t ms_to_byte_count(WavHeader& header, uint32_t time_ms);
+// Measures data in memory and applies normalize effect to it in place.
+std::vector<uint64_t> normalize_data(WavHeader& header, uint8_t* data, NormalizeOptions& options);
 
+// Number of samples of all channels converted to the processing format at once.
+// Tiles of this size stay in cache while they go through effects.
+const size_t PLANAR_TILE_SAMPLES = 8192;
 
-/* How we launch effects */
+// Minimal number of frames processed by one thread.
+const size_t PARALLEL_CHUNK_FRAMES = 16384;
+
+// Loudness segments of 100 ms in a chunk of the analysis and before it to start the filter, see FrameAnalyzer.
+const uint64_t ANALYSIS_CHUNK_SEGMENTS = 10;
+const uint64_t ANALYSIS_WARMUP_SEGMENTS = 2;
+
+
+/* How effects work */
 
-// Trim effect.
+// Trim effect implementation.
 void effect(std::vector<uint8_t>& bytes, WavHeader& header, TrimOptions& options);
 
-// Fade effect.
-template <typename T>
-void effect(std::vector<uint8_t>& bytes, WavHeader& header, FadeOptions& options);
+class FrameConverter;
+
+// Effect on frames in the processing format: planar float samples from -1 to 1, see kernels::to_planar().
+// Every effect is written once for all sample types, frames are converted from and to
+// the samples of the file around it, see ConvertedEffect.
+class PlanarEffect
+{
+public:
+  virtual ~PlanarEffect() {}
+
+  // Processes frame_count frames, the plane of channel c starts at planes + c * plane_size.
+  // The first of them is first_frame of the data chunk.
+  virtual void process(float* planes, size_t plane_size, uint64_t first_frame, size_t frame_count) = 0;
+
+  // Processes frame_count frames of the effect range right in the samples of the file, if converter can do it
+  // with the same result as process(). Returns false if frames must be converted to planes.
+  virtual bool process_frames(FrameConverter& /*converter*/, uint8_t* /*frames*/, uint64_t /*first_frame*/,
+                              size_t /*frame_count*/, uint64_t* /*clip_counts*/)
+  {
+    return false;
+  }
+
+  // Frame range and tail frames like in BlockEffect.
+  virtual void get_frame_range(uint64_t& first_frame, uint64_t& end_frame) = 0;
+  virtual uint64_t get_tail_frames() { return 0; }
+};
+
+// Converter of frames between samples of the file and the processing format.
+// Samples clipped on the way back are added to the counts of their channels in clip_counts,
+// see samples::clip_level().
+class FrameConverter
+{
+public:
+  virtual ~FrameConverter() {}
+  virtual void to_planar(const uint8_t* frames, size_t frame_count, float* planes, size_t plane_size) = 0;
+  virtual void from_planar(const float* planes, size_t plane_size, size_t frame_count, uint8_t* frames,
+                           uint64_t* clip_counts) = 0;
+
+  // Largest value of the processing format that the samples of the file can hold, see samples::clip_level().
+  virtual float get_clip_level() = 0;
+
+  // Multiplies frames by a linear gain ramp right in the samples of the file, like kernels::gain_ramp() on planes.
+  // Returns false if the samples have no such kernel.
+  virtual bool gain_ramp(uint8_t* frames, size_t frame_count, double start_gain, double step, uint64_t first_idx,
+                         uint64_t* clip_counts) = 0;
+};
 
-// Reverb effect.
+// Converter of samples of type T with vectorized kernels.
 template <typename T>
-void effect(std::vector<uint8_t>& bytes, WavHeader& header, ReverbOptions& options);
+class SampleConverter : public FrameConverter
+{
+private:
+  uint16_t num_of_chan;
+
+public:
+  SampleConverter(uint16_t num_of_chan);
+  void to_planar(const uint8_t* frames, size_t frame_count, float* planes, size_t plane_size);
+  void from_planar(const float* planes, size_t plane_size, size_t frame_count, uint8_t* frames, uint64_t* clip_counts);
+  float get_clip_level();
+  bool gain_ramp(uint8_t* frames, size_t frame_count, double start_gain, double step, uint64_t first_idx,
+                 uint64_t* clip_counts);
+};
 
-// Switch function for effects that can work with different sample types.
-// The function gets sample size from WAV header and passes the sample type to effect template.
-// The effect template is then chosen based on the O type of the options.
-template <typename O>
-void effect_with_type_switch(std::vector<uint8_t>& bytes, O& options)
+// Planar effect on the frames of a file.
+// Frames of the effect range are converted to the processing format by tiles of PLANAR_TILE_SAMPLES samples,
+// processed and converted back, the frames out of the range are not touched.
+// An effect can skip the conversion and process the samples of the file, see PlanarEffect::process_frames().
+// An effect that keeps no state between frames can run on several threads, every thread with its own tiles
+// and clip counts, which are added up at the end of every block.
+class ConvertedEffect : public BlockEffect
 {
-  WavHeader header = WavHeader(bytes);
-  uint16_t sample_size = header.get_block_align() / header.get_num_of_channels();
+private:
+  std::unique_ptr<FrameConverter> converter;
+  std::unique_ptr<PlanarEffect> effect;
+  uint32_t block_size;
+  size_t tile_frames;
+  uint64_t range_first, range_end;
+  std::vector<float> planes;         // tile of one thread
+  std::vector<uint64_t> clip_counts;
+  std::unique_ptr<ThreadPool> pool;  // nullptr for one thread
+  std::mutex clip_mutex;
+
+  void process_tiles(uint8_t* frames, uint64_t first_frame, size_t frame_count, float* tile_planes,
+                     uint64_t* tile_clip_counts);
+
+public:
+  ConvertedEffect(WavHeader& header, std::unique_ptr<FrameConverter> converter, std::unique_ptr<PlanarEffect> effect,
+                  uint32_t thread_count);
+  void process(uint8_t* block, uint64_t first_frame, size_t frame_count);
+  void get_frame_range(uint64_t& first_frame, uint64_t& end_frame);
+  uint64_t get_tail_frames();
+  std::vector<uint64_t> get_clip_counts();
+};
+
+// Fade effect implementation.
+// Volume ratio changes linearly by the same step with every frame of the effect range.
+// The ratio of every frame is computed from its position, see kernels::ramp_gain(),
+// so frames can be faded by different threads with the same result.
+class FadeEffect : public PlanarEffect
+{
+private:
+  uint16_t num_of_chan;
+  uint64_t start_frame, end_frame;
+  double start_ratio, step;
+
+public:
+  FadeEffect(WavHeader& header, FadeOptions& options);
+  void process(float* planes, size_t plane_size, uint64_t first_frame, size_t frame_count);
+  bool process_frames(FrameConverter& converter, uint8_t* frames, uint64_t first_frame, size_t frame_count,
+                      uint64_t* clip_counts);
+  void get_frame_range(uint64_t& first_frame, uint64_t& end_frame);
+};
+
+// Gain effect implementation.
+// Every sample of data is multiplied by the same gain, which is a ramp of fade effect with zero step,
+// see kernels::gain_ramp().
+class GainEffect : public PlanarEffect
+{
+private:
+  uint16_t num_of_chan;
+  uint64_t frame_count;
+  double gain;
+
+public:
+  GainEffect(WavHeader& header, double gain);
+  void process(float* planes, size_t plane_size, uint64_t first_frame, size_t frame_count);
+  bool process_frames(FrameConverter& converter, uint8_t* frames, uint64_t first_frame, size_t frame_count,
+                      uint64_t* clip_counts);
+  void get_frame_range(uint64_t& first_frame, uint64_t& end_frame);
+};
+
+// Reverb effect implementation.
+// Every frame gets the original frame from delay before it added with decay coefficient.
+// Original samples of the last delay are kept in a circular delay line of every channel,
+// so frames are processed forward and memory use depends only on delay.
+class ReverbEffect : public PlanarEffect
+{
+private:
+  uint16_t num_of_chan;
+  uint32_t delay_frames;
+  uint64_t data_frames, tail_frames;
+  float decay;
+  std::vector<float> delay_line;  // delay_frames samples of every channel, channel after channel
+  uint32_t delay_pos = 0;
+
+public:
+  ReverbEffect(WavHeader& header, ReverbOptions& options);
+  void process(float* planes, size_t plane_size, uint64_t first_frame, size_t frame_count);
+  void get_frame_range(uint64_t& first_frame, uint64_t& end_frame);
+  uint64_t get_tail_frames();
+};
+
+
+// Freeverb effect implementation.
+// Frames are run through ReverbNetwork.
+class FreeverbEffect : public PlanarEffect
+{
+private:
+  uint64_t data_frames, tail_frames;
+  ReverbNetwork network;
+
+public:
+  FreeverbEffect(WavHeader& header, FreeverbOptions& options);
+  void process(float* planes, size_t plane_size, uint64_t first_frame, size_t frame_count);
+  void get_frame_range(uint64_t& first_frame, uint64_t& end_frame);
+  uint64_t get_tail_frames();
+};
+
+// Chain effect implementation.
+// Every effect of the chain is a stage made for the header of its input, so its time points
+// are measured in the output of the stages before it. Trim stage has no effect, it only passes
+// on its range of frames. Frames are converted to the processing format once per tile
+// and go through stages in place, trims move the start of frames and reduce their count.
+class EffectChain : public BlockEffect
+{
+private:
+  // Effect of the chain with the frames of its input.
+  struct Stage
+  {
+    std::unique_ptr<PlanarEffect> effect;  // nullptr for trim
+    uint64_t first_frame, end_frame;       // frames of input passed on
+    uint64_t in_frames, tail_frames;
+  };
+
+  std::vector<Stage> stages;
+  std::unique_ptr<FrameConverter> converter;
+  uint32_t block_size;
+  size_t tile_frames;
+  std::vector<float> planes;
+  std::vector<uint64_t> clip_counts;
+
+  // Passes planar frames through stages starting from stage_idx.
+  // planes is moved to the first frame left, the number of frames left is returned.
+  size_t run_planes(size_t stage_idx, float*& planes, size_t plane_size, uint64_t first_frame, size_t frame_count);
+
+public:
+  EffectChain(const std::vector<uint8_t>& header_bytes, ChainOptions& options);
+
+  // Passes frames through stages starting from stage_idx.
+  // The frames left are moved to the start of frames, their number is returned.
+  size_t run(size_t stage_idx, uint8_t* frames, uint64_t first_frame, size_t frame_count);
+
+  // Frames of the chain input that can get to the output.
+  void get_input_range(uint64_t& first_frame, uint64_t& end_frame);
+
+  size_t get_stage_count();
+  uint64_t get_stage_in_frames(size_t stage_idx);
+  uint64_t get_stage_tail_frames(size_t stage_idx);
+
+  // Runs all stages in place, so the chain must not contain trims and tails.
+  void process(uint8_t* block, uint64_t first_frame, size_t frame_count);
+  void get_frame_range(uint64_t& first_frame, uint64_t& end_frame);
+  std::vector<uint64_t> get_clip_counts();
+};
+
+// Analysis implementation.
+// Loudness is measured like in ITU-R BS.1770-4: samples go through K-weighting filter, their squares are summed
+// by segments of 100 ms with the weights of channels, and four segments make a gating block of 400 ms.
+// Frames are split into chunks of ANALYSIS_CHUNK_SEGMENTS segments at fixed positions of data, chunks of a block
+// are analyzed by the threads of the pool and their results are summed up in the order of chunks.
+// The filter of every chunk starts from silence on ANALYSIS_WARMUP_SEGMENTS segments before the chunk,
+// the response to the frames before them is far below the precision of the sums by then.
+class FrameAnalyzer
+{
+private:
+  // State of the K-weighting filter of one channel: high shelf and high pass biquads in transposed direct form II.
+  struct FilterState
+  {
+    double shelf1 = 0., shelf2 = 0., pass1 = 0., pass2 = 0.;
+  };
+
+  // Result of one chunk.
+  struct ChunkResult
+  {
+    std::vector<kernels::PlaneStats> stats;  // of every channel
+    uint64_t first_segment;
+    std::vector<double> segment_energies;    // weighted sums of squares of the filtered samples
+  };
+
+  std::unique_ptr<FrameConverter> converter;
+  uint16_t num_of_chan;
+  uint32_t block_size;
+  size_t tile_frames;
+  uint64_t segment_frames, chunk_frames, warmup_frames;
+  double shelf_b[3], shelf_a[3], pass_a[3];  // pass_b is 1, -2, 1
+  std::vector<double> channel_weights;
+  std::vector<kernels::PlaneStats> stats;
+  std::vector<double> segment_energies;
+  uint64_t frame_count = 0;
+  std::vector<uint8_t> warmup;               // last frames of the previous block
+  ThreadPool pool;
+
+  void analyze_chunk(const uint8_t* frames, uint64_t first_frame, size_t frame_count, const uint8_t* warmup_start,
+                     size_t warmup_count, ChunkResult& result);
+
+  // Filters sample_count samples of a plane and returns the sum of squares of the result.
+  double filter(const float* samples, size_t sample_count, FilterState& state);
+
+public:
+  FrameAnalyzer(WavHeader& header, AnalyzeOptions& options);
+
+  // Analyzes frames that follow the frames of the previous call, the first of them is first_frame of the data chunk.
+  // Every block but the last must have a whole number of chunks, see get_block_frames().
+  void process(const uint8_t* frames, uint64_t first_frame, size_t frame_count);
+
+  // Frames of a block with at least one chunk for every thread and about STREAM_BLOCK_BYTES bytes.
+  size_t get_block_frames();
+
+  Analysis get_result();
+};
+
+// Peaks implementation.
+// Puts ranges of the buckets of bucket_frames frames into ranges, the ranges of all channels of a bucket
+// one after another. Buckets are split between the threads of pool.
+void find_bucket_ranges(FrameConverter& converter, ThreadPool& pool, WavHeader& header, const uint8_t* frames,
+                        size_t frame_count, uint32_t bucket_frames, peaks::Range* ranges);
+
+// Extends data chunk of WAV file in memory by tail_frames frames of silence.
+void extend_data(std::vector<uint8_t>& bytes, WavHeader& header, uint64_t tail_frames);
+
+// Writes data size and RIFF size of WAV file in memory, see set_wav_sizes().
+void write_sizes(std::vector<uint8_t>& bytes, WavHeader& header, uint64_t data_size);
+
+
+/* How we launch effects */
+
+// Switch function for the sample types of WAV data.
+// The function gets sample size and format from WAV header and makes the converter of these samples.
+std::unique_ptr<FrameConverter> converter_with_type_switch(WavHeader& header)
+{
+  uint16_t num_of_chan = header.get_num_of_channels();
+  uint16_t sample_size = header.get_block_align() / num_of_chan;
+  bool is_float = header.get_audio_format() == format::WAVE_FORMAT_IEEE_FLOAT;
 
   switch (sample_size)
   {
   case 1:
-    effect<uint8_t>(bytes, header, options);
-    break;
+    return std::unique_ptr<FrameConverter>(new SampleConverter<uint8_t>(num_of_chan));
 
   case 2:
-    effect<int16_t>(bytes, header, options);
-    break;
+    return std::unique_ptr<FrameConverter>(new SampleConverter<int16_t>(num_of_chan));
 
-  case 4:
-    if (header.get_audio_format() != format::WAVE_FORMAT_IEEE_FLOAT)
-    {
-      effect<int32_t>(bytes, header, options);
-    }
-    else
+  case 3:
+    if (!is_float)
     {
-      effect<float>(bytes, header, options);
+      return std::unique_ptr<FrameConverter>(new SampleConverter<samples::Int24>(num_of_chan));
     }
     break;
 
-  case 8:
-    if (header.get_audio_format() != format::WAVE_FORMAT_IEEE_FLOAT)
+  case 4:
+    if (!is_float)
     {
-      effect<int64_t>(bytes, header, options);
+      return std::unique_ptr<FrameConverter>(new SampleConverter<int32_t>(num_of_chan));
     }
-    else
+    return std::unique_ptr<FrameConverter>(new SampleConverter<float>(num_of_chan));
+
+  case 8:
+    if (!is_float)
     {
-      effect<double>(bytes, header, options);
+      return std::unique_ptr<FrameConverter>(new SampleConverter<int64_t>(num_of_chan));
     }
-
-  default:
-    throw std::invalid_argument("Error: Invalid sample size or unsupported data format!");
-    break;
+    return std::unique_ptr<FrameConverter>(new SampleConverter<double>(num_of_chan));
   }
+  throw std::invalid_argument("Error: Invalid sample size or unsupported data format!");
+}
+
+// Makes planar effect E for WAV data and puts it between the converters of its samples.
+// thread_count is passed to ConvertedEffect.
+template <typename E, typename O>
+std::unique_ptr<BlockEffect> effect_with_type_switch(WavHeader& header, O& options, uint32_t thread_count = 1)
+{
+  std::unique_ptr<FrameConverter> converter = converter_with_type_switch(header);
+  std::unique_ptr<PlanarEffect> effect(new E(header, options));
+  return std::unique_ptr<BlockEffect>(new ConvertedEffect(header, std::move(converter), std::move(effect), thread_count));
 }
 
 // Trim effect launcher.
@@ -84,211 +389,1252 @@ void effects::trim(std::vector<uint8_t>& bytes, TrimOptions& options)
   effect(bytes, header, options);
 };
 
+void effects::trim(WavReader& reader, WavWriter& writer, TrimOptions& options)
+{
+  WavHeader& header = reader.get_header();
+  uint64_t first_frame, end_frame;
+  effects::trim_range(header, options, first_frame, end_frame);
+
+  // Selected frames are copied from file to file as one range
+  uint64_t start_off = header.get_data_offset() + first_frame * header.get_block_align();
+  uint64_t end_off = header.get_data_offset() + end_frame * header.get_block_align();
+
+  writer.expect_data_size(end_off - start_off);
+  writer.copy_data(reader.get_file_path(), start_off, end_off - start_off);
+  writer.finish(reader.read_trailer());
+}
+
+void effects::trim_range(WavHeader& header, TrimOptions& options, uint64_t& first_frame, uint64_t& end_frame)
+{
+  first_frame = time_to_frame_count(header, options.start);
+  end_frame = options.end_flag ? time_to_frame_count(header, options.end) : header.get_data_size() / header.get_block_align();
+  if (first_frame > end_frame)
+  {
+    throw std::invalid_argument("Error: Start point (-s) must be lesser than or equal to end point (-e).");
+  }
+}
+
 // Fade effect launcher.
-void effects::fade(std::vector<uint8_t>& bytes, FadeOptions& options)
+std::vector<uint64_t> effects::fade(std::vector<uint8_t>& bytes, FadeOptions& options)
 {
-  effect_with_type_switch<FadeOptions>(bytes, options);
+  WavHeader header = WavHeader(bytes);
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<FadeEffect>(header, options, options.thread_count);
+  effects::in_place(&bytes[0], bytes.size(), *effect);
+  return effect->get_clip_counts();
 };
 
-// Reverb effect launcher.
-void effects::reverb(std::vector<uint8_t>& bytes, ReverbOptions& options)
+std::vector<uint64_t> effects::fade(WavReader& reader, WavWriter& writer, FadeOptions& options)
 {
-  effect_with_type_switch<ReverbOptions>(bytes, options);
-};
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<FadeEffect>(reader.get_header(), options, options.thread_count);
+  effects::stream(reader, writer, effect.get());
+  return effect->get_clip_counts();
+}
 
+std::vector<uint64_t> effects::fade(MappedFile& file, FadeOptions& options)
+{
+  WavHeader header = WavHeader(file.get_data(), file.get_size());
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<FadeEffect>(header, options, options.thread_count);
+  effects::in_place(file.get_data(), file.get_size(), *effect);
+  return effect->get_clip_counts();
+}
 
-/* How effects work */
+std::vector<uint64_t> effects::fade(const std::vector<uint8_t>& header_bytes, uint8_t* data, FadeOptions& options)
+{
+  WavHeader header = WavHeader(header_bytes);
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<FadeEffect>(header, options, options.thread_count);
+  effects::in_place(header, data, *effect);
+  return effect->get_clip_counts();
+}
 
-// Trim effect implementation.
-void effect(std::vector<uint8_t>& bytes, WavHeader& header, TrimOptions& options)
+// Normalize effect launcher.
+// After the measure pass the reader is moved back to the first frame for the effect.
+std::vector<uint64_t> effects::normalize(WavReader& reader, WavWriter& writer, NormalizeOptions& options)
 {
-  uint32_t data_off = header.get_data_offset();
-  uint32_t data_size = header.get_data_size();
+  AnalyzeOptions analyze_options;
+  analyze_options.thread_count = options.thread_count;
+  Analysis analysis = effects::analyze(reader, analyze_options);
+  reader.select_frames(0, analysis.frame_count);
 
-  if (!options.end_flag)
-  {
-    options.end_ms = header.get_length_ms();
-  }
+  double gain = effects::normalize_gain(analysis, options);
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<GainEffect>(reader.get_header(), gain, options.thread_count);
+  effects::stream(reader, writer, effect.get());
+  return effect->get_clip_counts();
+}
 
-  uint32_t start_off = data_off + ms_to_byte_count(header, options.start_ms);
-  uint32_t end_off = data_off + ms_to_byte_count(header, options.end_ms);
+std::vector<uint64_t> effects::normalize(MappedFile& file, NormalizeOptions& options)
+{
+  WavHeader header = WavHeader(file.get_data(), file.get_size());
+  return normalize_data(header, file.get_data() + header.get_data_offset(), options);
+}
 
-  bytes.erase(bytes.begin() + end_off, bytes.begin() + data_off + data_size);
-  bytes.erase(bytes.begin() + data_off, bytes.begin() + start_off);
+std::vector<uint64_t> effects::normalize(const std::vector<uint8_t>& header_bytes, uint8_t* data,
+                                         NormalizeOptions& options)
+{
+  WavHeader header = WavHeader(header_bytes);
+  return normalize_data(header, data, options);
+}
 
-  uint32_t size_change = data_size - (end_off - start_off);
+double effects::normalize_gain(const Analysis& analysis, NormalizeOptions& options)
+{
+  double peak = 0.;
+  for (const ChannelAnalysis& channel : analysis.channels)
+  {
+    peak = std::max(peak, channel.peak);
+  }
+  if (peak == 0.)
+  {
+    return 1.;
+  }
 
-  if (data_size % 2 == 1)
+  double peak_gain = std::pow(10., options.peak_dbfs / 20.) / peak;
+  if (options.peak_mode)
+  {
+    return peak_gain;
+  }
+  if (std::isinf(analysis.integrated_lufs))
   {
-    bytes.insert(bytes.begin() + data_off + data_size - size_change, (uint8_t)0);
+    return 1.;
   }
+  return std::min(peak_gain, std::pow(10., (options.target_lufs - analysis.integrated_lufs) / 20.));
+}
 
-  // Changing Data Subchunk Size
-  write_to_bytes<uint32_t>(bytes, data_off - 4, data_size - size_change);
-  // Changing RIFF Chunk Size
-  write_to_bytes<uint32_t>(bytes, 4, header.get_file_size() - 8 - size_change);
+// Reverb effect launcher.
+std::vector<uint64_t> effects::reverb(std::vector<uint8_t>& bytes, ReverbOptions& options)
+{
+  WavHeader header = WavHeader(bytes);
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<ReverbEffect>(header, options);
+
+  extend_data(bytes, header, effect->get_tail_frames());
+  effects::in_place(&bytes[0], bytes.size(), *effect);
+  return effect->get_clip_counts();
+};
+
+std::vector<uint64_t> effects::reverb(WavReader& reader, WavWriter& writer, ReverbOptions& options)
+{
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<ReverbEffect>(reader.get_header(), options);
+  effects::stream(reader, writer, effect.get());
+  return effect->get_clip_counts();
 }
 
-// Fade effect implementation.
-template <typename T>
-void effect(std::vector<uint8_t>& bytes, WavHeader& header, FadeOptions& options)
+std::vector<uint64_t> effects::reverb(MappedFile& file, ReverbOptions& options)
 {
-  uint32_t data_off = header.get_data_offset();
-  uint32_t block_size = header.get_block_align();
-  uint32_t sample_size = block_size / header.get_num_of_channels();
+  WavHeader header = WavHeader(file.get_data(), file.get_size());
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<ReverbEffect>(header, options);
+  effects::in_place(file.get_data(), file.get_size(), *effect);
+  return effect->get_clip_counts();
+}
 
-  if (!options.end_flag)
-  {
-    options.end_ms = header.get_length_ms();
-  }
+std::vector<uint64_t> effects::reverb(const std::vector<uint8_t>& header_bytes, uint8_t* data, ReverbOptions& options)
+{
+  WavHeader header = WavHeader(header_bytes);
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<ReverbEffect>(header, options);
+  effects::in_place(header, data, *effect);
+  return effect->get_clip_counts();
+}
+
+// Freeverb effect launcher.
+std::vector<uint64_t> effects::freeverb(std::vector<uint8_t>& bytes, FreeverbOptions& options)
+{
+  WavHeader header = WavHeader(bytes);
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<FreeverbEffect>(header, options);
+  extend_data(bytes, header, effect->get_tail_frames());
+  effects::in_place(&bytes[0], bytes.size(), *effect);
+  return effect->get_clip_counts();
+}
+
+std::vector<uint64_t> effects::freeverb(WavReader& reader, WavWriter& writer, FreeverbOptions& options)
+{
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<FreeverbEffect>(reader.get_header(), options);
+  effects::stream(reader, writer, effect.get());
+  return effect->get_clip_counts();
+}
+
+std::vector<uint64_t> effects::freeverb(MappedFile& file, FreeverbOptions& options)
+{
+  WavHeader header = WavHeader(file.get_data(), file.get_size());
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<FreeverbEffect>(header, options);
+  effects::in_place(file.get_data(), file.get_size(), *effect);
+  return effect->get_clip_counts();
+}
+
+std::vector<uint64_t> effects::freeverb(const std::vector<uint8_t>& header_bytes, uint8_t* data, FreeverbOptions& options)
+{
+  WavHeader header = WavHeader(header_bytes);
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<FreeverbEffect>(header, options);
+  effects::in_place(header, data, *effect);
+  return effect->get_clip_counts();
+}
 
-  uint32_t start_off = data_off + ms_to_byte_count(header, options.start_ms);
-  uint32_t end_off = data_off + ms_to_byte_count(header, options.end_ms);
+// Chain effect launcher.
+std::vector<uint64_t> effects::chain(WavReader& reader, WavWriter& writer, ChainOptions& options)
+{
+  EffectChain chain(reader.get_header_bytes(), options);
+  size_t block_size = reader.get_header().get_block_align();
+  size_t max_frame_count = std::max<size_t>(1, STREAM_BLOCK_BYTES / block_size);
+
+  // Frames cut by trims are not read at all
+  uint64_t frame_pos, end_frame;
+  chain.get_input_range(frame_pos, end_frame);
+  reader.select_frames(frame_pos, end_frame);
 
-  uint32_t length;
-  double ratio = 1., reverse;
-  if (start_off < end_off)
+  uint64_t max_data_size = (end_frame - frame_pos) * block_size;
+  for (size_t stage_idx = 0; stage_idx < chain.get_stage_count(); stage_idx++)
   {
-    length = static_cast<double>(end_off - start_off);
-    ratio = 1.;
-    reverse = 1;
+    max_data_size += chain.get_stage_tail_frames(stage_idx) * block_size;
   }
-  else
+  writer.expect_data_size(max_data_size);
+
+  std::vector<uint8_t> block;
+  size_t frame_count;
+  while ((frame_count = reader.read_frames(block, max_frame_count)) > 0)
   {
-    length = static_cast<double>(start_off - end_off);
-    ratio = options.end_lvl_01;
-    reverse = -1;
-    std::swap(start_off, end_off);
+    uint8_t* frames = &block[0];
+    stats::StageTimer effect_timer(stats::EFFECT);
+    size_t out_count = chain.run(0, frames, frame_pos, frame_count);
+    effect_timer.stop(frame_count * block_size, frame_count);
+    writer.write_block(block, out_count * block_size);
+    frame_pos += frame_count;
   }
 
-  double diff = (1. - options.end_lvl_01) * static_cast<double>(block_size) / length;
+  // Tail of every stage is the end of input of the next stage, so tails go stage after stage
+  uint8_t silence = block_size == reader.get_header().get_num_of_channels() ? 0x80 : 0;
+  for (size_t stage_idx = 0; stage_idx < chain.get_stage_count(); stage_idx++)
+  {
+    frame_pos = chain.get_stage_in_frames(stage_idx);
+    uint64_t tail_frames = chain.get_stage_tail_frames(stage_idx);
+    while (tail_frames > 0)
+    {
+      frame_count = std::min<uint64_t>(max_frame_count, tail_frames);
+      block.assign(frame_count * block_size, silence);
+      uint8_t* frames = &block[0];
+      stats::StageTimer effect_timer(stats::EFFECT);
+      size_t out_count = chain.run(stage_idx, frames, frame_pos, frame_count);
+      effect_timer.stop(frame_count * block_size, frame_count);
+      writer.write_block(block, out_count * block_size);
+      frame_pos += frame_count;
+      tail_frames -= frame_count;
+    }
+  }
 
-  T smpl;
+  writer.finish(reader.read_trailer());
+  return chain.get_clip_counts();
+}
 
-  if (std::is_unsigned<T>::value)
+std::vector<uint64_t> effects::chain(MappedFile& file, ChainOptions& options)
+{
+  if (options.changes_length())
   {
-    T smpl_amp, mid_smpl = std::numeric_limits<T>::max() / 2;
-
-    for (uint32_t block_off = start_off; block_off < end_off; block_off += block_size)
-    {
-      for (uint32_t channel_off = 0; channel_off < block_size; channel_off += sample_size)
-      {
-        smpl = read_from_bytes<T>(bytes, block_off + channel_off);
+    throw std::invalid_argument("Error: Chain with trim or reverb tail can't be applied in place.");
+  }
 
-        if (smpl < mid_smpl)
-        {
-          smpl_amp = mid_smpl - smpl;
-          smpl_amp = static_cast<T>(static_cast<double>(smpl_amp) * ratio);
-          smpl = mid_smpl - smpl_amp;
-        }
-        else
-        {
-          smpl_amp = smpl - mid_smpl;
-          smpl_amp = static_cast<T>(static_cast<double>(smpl_amp) * ratio);
-          smpl = mid_smpl + smpl_amp;
-        }
+  WavHeader header = WavHeader(file.get_data(), file.get_size());
+  std::vector<uint8_t> header_bytes(file.get_data(), file.get_data() + header.get_data_offset());
+  EffectChain chain(header_bytes, options);
+  effects::in_place(file.get_data(), file.get_size(), chain);
+  return chain.get_clip_counts();
+}
 
-        write_to_bytes<T>(bytes, block_off + channel_off, smpl);
-      }
-      ratio -= diff * reverse;
+// All frames go through the chain in one run, so the frames left of every tile are packed
+// right after the frames left of the tiles before it.
+std::vector<uint64_t> effects::chain(const std::vector<uint8_t>& header_bytes, uint8_t* data, ChainOptions& options,
+                                     uint64_t& first_frame, uint64_t& frame_count)
+{
+  EffectChain chain(header_bytes, options);
+  for (size_t stage_idx = 0; stage_idx < chain.get_stage_count(); stage_idx++)
+  {
+    if (chain.get_stage_tail_frames(stage_idx) > 0)
+    {
+      throw std::invalid_argument("Error: Chain with reverb tail can't be applied to frames in memory.");
     }
   }
-  else
+
+  size_t block_size = WavHeader(header_bytes).get_block_align();
+  uint64_t end_frame;
+  chain.get_input_range(first_frame, end_frame);
+  stats::StageTimer effect_timer(stats::EFFECT);
+  frame_count = chain.run(0, data + (size_t)first_frame * block_size, first_frame, end_frame - first_frame);
+  effect_timer.stop((end_frame - first_frame) * block_size, end_frame - first_frame);
+  return chain.get_clip_counts();
+}
+
+// Streaming loop.
+void effects::stream(WavReader& reader, WavWriter& writer, BlockEffect* effect)
+{
+  size_t block_size = reader.get_header().get_block_align();
+  size_t max_frame_count = std::max<size_t>(1, STREAM_BLOCK_BYTES / block_size);
+
+  uint64_t tail_frames = effect != nullptr ? effect->get_tail_frames() : 0;
+  writer.expect_data_size(reader.get_header().get_data_size() + tail_frames * block_size);
+
+  std::vector<uint8_t> block;
+  uint64_t frame_pos = 0;
+  size_t frame_count;
+  while ((frame_count = reader.read_frames(block, max_frame_count)) > 0)
   {
-    for (uint32_t block_off = start_off; block_off < end_off; block_off += block_size)
+    if (effect != nullptr)
     {
-      for (uint32_t channel_off = 0; channel_off < block_size; channel_off += sample_size)
-      {
-        smpl = read_from_bytes<T>(bytes, block_off + channel_off);
-        smpl = static_cast<T>(static_cast<double>(smpl) * ratio);
-        write_to_bytes<T>(bytes, block_off + channel_off, smpl);
-      }
-      ratio -= diff * reverse;
+      stats::StageTimer effect_timer(stats::EFFECT);
+      effect->process(&block[0], frame_pos, frame_count);
+      effect_timer.stop(frame_count * block_size, frame_count);
     }
+    writer.write_block(block, frame_count * block_size);
+    frame_pos += frame_count;
+  }
+
+  // Tail frames start as silence, the middle value for 8-bit unsigned samples and zero otherwise
+  uint8_t silence = block_size == reader.get_header().get_num_of_channels() ? 0x80 : 0;
+  while (tail_frames > 0)
+  {
+    frame_count = std::min<uint64_t>(max_frame_count, tail_frames);
+    block.assign(frame_count * block_size, silence);
+    stats::StageTimer effect_timer(stats::EFFECT);
+    effect->process(&block[0], frame_pos, frame_count);
+    effect_timer.stop(frame_count * block_size, frame_count);
+    writer.write_block(block, frame_count * block_size);
+    frame_pos += frame_count;
+    tail_frames -= frame_count;
   }
+
+  writer.finish(reader.read_trailer());
 }
 
-// Reverb effect implementation.
-template <typename T>
-void effect(std::vector<uint8_t>& bytes, WavHeader& header, ReverbOptions& options)
+// In place loop.
+void effects::in_place(uint8_t* bytes, size_t byte_count, BlockEffect& effect)
 {
-  uint32_t block_size = header.get_block_align();
-  uint32_t num_of_chan = header.get_num_of_channels();
-  uint32_t sample_size = block_size / num_of_chan;
-  uint32_t start_off = header.get_data_offset();
-  uint32_t end_off = start_off + header.get_data_size() - block_size;
+  WavHeader header = WavHeader(bytes, byte_count);
+  if (header.get_data_offset() + header.get_data_size() > byte_count)
+  {
+    throw std::invalid_argument("Error: Bad file - WAVE data is larger than the file!");
+  }
+  effects::in_place(header, bytes + header.get_data_offset(), effect);
+}
 
-  uint32_t delay = ms_to_byte_count(header, options.delay_ms);
-  uint32_t delay_start = start_off + delay;
+void effects::in_place(WavHeader& header, uint8_t* data, BlockEffect& effect)
+{
+  size_t block_size = header.get_block_align();
+  size_t max_frame_count = std::max<size_t>(1, STREAM_BLOCK_BYTES / block_size);
 
-  T smpl, delay_smpl;
+  uint64_t frame_pos, end_frame;
+  effect.get_frame_range(frame_pos, end_frame);
+  end_frame = std::min<uint64_t>(end_frame, header.get_data_size() / block_size);
 
-  if (std::is_unsigned<T>::value)
+  while (frame_pos < end_frame)
   {
-    T mid_smpl = std::numeric_limits<T>::max() / 2;
+    size_t frame_count = std::min<uint64_t>(max_frame_count, end_frame - frame_pos);
+    // With a mapped file the effect time includes reading pages of the file
+    stats::StageTimer effect_timer(stats::EFFECT);
+    effect.process(data + (size_t)frame_pos * block_size, frame_pos, frame_count);
+    effect_timer.stop(frame_count * block_size, frame_count);
+    frame_pos += frame_count;
+  }
+}
 
-    for (uint32_t block_off = end_off; block_off >= delay_start; block_off -= block_size)
-    {
-      for (uint32_t channel_off = 0; channel_off < block_size; channel_off += sample_size)
-      {
-        smpl = read_from_bytes<T>(bytes, block_off + channel_off);
-        delay_smpl = read_from_bytes<T>(bytes, block_off - delay + channel_off);
+Analysis effects::analyze(WavReader& reader, AnalyzeOptions& options)
+{
+  FrameAnalyzer analyzer(reader.get_header(), options);
+  size_t max_frame_count = analyzer.get_block_frames();
 
-        if (delay_smpl < mid_smpl)
-        {
-          delay_smpl = mid_smpl - delay_smpl;
-          smpl -= static_cast<T>(options.decay_01 * static_cast<double>(delay_smpl));
-        }
-        else
-        {
-          delay_smpl = delay_smpl - mid_smpl;
-          smpl += static_cast<T>(options.decay_01 * static_cast<double>(delay_smpl));
-        }
+  std::vector<uint8_t> block;
+  uint64_t frame_pos = 0;
+  size_t frame_count;
+  while ((frame_count = reader.read_frames(block, max_frame_count)) > 0)
+  {
+    analyzer.process(&block[0], frame_pos, frame_count);
+    frame_pos += frame_count;
+  }
+  return analyzer.get_result();
+}
 
-        write_to_bytes<T>(bytes, block_off + channel_off, smpl);
-      }
-    }
+Analysis effects::analyze(const std::vector<uint8_t>& header_bytes, const uint8_t* data, AnalyzeOptions& options)
+{
+  WavHeader header = WavHeader(header_bytes);
+  return analyze_data(header, data, options);
+}
+
+// Peaks launcher.
+// Blocks are made of whole buckets, so every bucket is found in one block.
+std::vector<uint8_t> effects::peaks(WavReader& reader, PeaksOptions& options)
+{
+  WavHeader& header = reader.get_header();
+  uint16_t num_of_chan = header.get_num_of_channels();
+  size_t block_size = header.get_block_align();
+  uint64_t frame_count = header.get_data_size() / block_size;
+  std::unique_ptr<FrameConverter> converter = converter_with_type_switch(header);
+  ThreadPool pool(options.thread_count);
+
+  std::vector<peaks::Range> ranges(peaks::bucket_count(frame_count, options.bucket_frames) * num_of_chan);
+  size_t max_frame_count = std::max<size_t>(1, STREAM_BLOCK_BYTES / ((size_t)options.bucket_frames * block_size)) *
+                           options.bucket_frames;
+
+  std::vector<uint8_t> block;
+  uint64_t frame_pos = 0;
+  size_t block_frames;
+  while ((block_frames = reader.read_frames(block, max_frame_count)) > 0)
+  {
+    stats::StageTimer effect_timer(stats::EFFECT);
+    find_bucket_ranges(*converter, pool, header, &block[0], block_frames, options.bucket_frames,
+                       &ranges[frame_pos / options.bucket_frames * num_of_chan]);
+    effect_timer.stop(block_frames * block_size, block_frames);
+    frame_pos += block_frames;
   }
-  else
+  return peaks::make_peak_file(ranges, num_of_chan, header.get_frequency(), options.bucket_frames, frame_count);
+}
+
+std::vector<uint8_t> effects::peaks(const std::vector<uint8_t>& header_bytes, const uint8_t* data, PeaksOptions& options)
+{
+  WavHeader header = WavHeader(header_bytes);
+  uint16_t num_of_chan = header.get_num_of_channels();
+  uint64_t frame_count = header.get_data_size() / header.get_block_align();
+  std::unique_ptr<FrameConverter> converter = converter_with_type_switch(header);
+  ThreadPool pool(options.thread_count);
+
+  std::vector<peaks::Range> ranges(peaks::bucket_count(frame_count, options.bucket_frames) * num_of_chan);
+  if (frame_count > 0)
   {
-    for (uint32_t block_off = end_off; block_off >= delay_start; block_off -= block_size)
-    {
-      for (uint32_t channel_off = 0; channel_off < block_size; channel_off += sample_size)
-      {
-        smpl = read_from_bytes<T>(bytes, block_off + channel_off);
-        delay_smpl = read_from_bytes<T>(bytes, block_off - delay + channel_off);
+    stats::StageTimer effect_timer(stats::EFFECT);
+    find_bucket_ranges(*converter, pool, header, data, frame_count, options.bucket_frames, &ranges[0]);
+    effect_timer.stop(frame_count * header.get_block_align(), frame_count);
+  }
+  return peaks::make_peak_file(ranges, num_of_chan, header.get_frequency(), options.bucket_frames, frame_count);
+}
 
-        smpl += static_cast<T>(options.decay_01 * static_cast<double>(delay_smpl));;
 
-        write_to_bytes<T>(bytes, block_off + channel_off, smpl);
-      }
-    }
+/* Effects implementation */
+
+void effect(std::vector<uint8_t>& bytes, WavHeader& header, TrimOptions& options)
+{
+  size_t data_off = header.get_data_offset();
+  uint64_t data_size = header.get_data_size();
+
+  uint64_t first_frame, end_frame;
+  effects::trim_range(header, options, first_frame, end_frame);
+  size_t start_off = data_off + first_frame * header.get_block_align();
+  size_t end_off = data_off + end_frame * header.get_block_align();
+  size_t new_size = end_off - start_off;
+
+  // Selected fragment and subchunks after data are moved once to their new places
+  size_t trailer_off = std::min<uint64_t>(data_off + data_size + data_size % 2, bytes.size());
+  size_t new_trailer_off = data_off + new_size + new_size % 2;
+
+  std::copy(bytes.begin() + start_off, bytes.begin() + end_off, bytes.begin() + data_off);
+  if (new_size % 2 == 1)
+  {
+    bytes[data_off + new_size] = 0;
   }
+  std::copy(bytes.begin() + trailer_off, bytes.end(), bytes.begin() + new_trailer_off);
+  bytes.resize(new_trailer_off + (bytes.size() - trailer_off));
+
+  write_sizes(bytes, header, new_size);
 }
 
-/* Support functions implementation */
+template <typename T>
+SampleConverter<T>::SampleConverter(uint16_t num_of_chan) : num_of_chan(num_of_chan)
+{
+}
+
+template <typename T>
+void SampleConverter<T>::to_planar(const uint8_t* frames, size_t frame_count, float* planes, size_t plane_size)
+{
+  kernels::to_planar<T>(frames, frame_count, num_of_chan, planes, plane_size);
+}
 
-template<typename T>
-T read_from_bytes(std::vector<uint8_t>& bytes, uint32_t pos)
+template <typename T>
+void SampleConverter<T>::from_planar(const float* planes, size_t plane_size, size_t frame_count, uint8_t* frames,
+                                     uint64_t* clip_counts)
 {
-  T val = 0;
-  memcpy(&val, &bytes[pos], sizeof(T));
-  return val;
+  for (uint16_t channel = 0; channel < num_of_chan; channel++)
+  {
+    clip_counts[channel] += kernels::count_clips(planes + channel * plane_size, frame_count, samples::clip_level<T>());
+  }
+  kernels::from_planar<T>(planes, plane_size, frame_count, num_of_chan, frames);
 }
 
-template<typename T>
-void write_to_bytes(std::vector<uint8_t>& bytes, uint32_t pos, T val)
+template <typename T>
+float SampleConverter<T>::get_clip_level()
 {
-  memcpy(&bytes[pos], &val, sizeof(T));
+  return samples::clip_level<T>();
 }
 
-uint32_t ms_to_byte_count(WavHeader& header, uint32_t time_ms)
+// 16-bit samples have a fused kernel, which is faster than planes for mono and stereo frames.
+template <typename T>
+bool SampleConverter<T>::gain_ramp(uint8_t* frames, size_t frame_count, double start_gain, double step,
+                                   uint64_t first_idx, uint64_t* clip_counts)
 {
-  uint32_t samples_count = header.get_frequency() * time_ms / 1000;
-  uint32_t bytes_count = samples_count * header.get_block_align();
-  if (bytes_count > header.get_data_size())
+  if (!std::is_same<T, int16_t>::value || num_of_chan > 2)
   {
-    throw std::invalid_argument("Error: Time point " + std::to_string(time_ms) + " is not in data range!");
+    return false;
   }
-  return bytes_count;
+  kernels::gain_ramp_s16(frames, frame_count, num_of_chan, start_gain, step, first_idx, clip_counts);
+  return true;
 }
+
+ConvertedEffect::ConvertedEffect(WavHeader& header, std::unique_ptr<FrameConverter> converter,
+                                 std::unique_ptr<PlanarEffect> effect, uint32_t thread_count)
+  : converter(std::move(converter)), effect(std::move(effect))
+{
+  block_size = header.get_block_align();
+  tile_frames = std::max<size_t>(1, PLANAR_TILE_SAMPLES / header.get_num_of_channels());
+  planes.resize(tile_frames * header.get_num_of_channels());
+  clip_counts.resize(header.get_num_of_channels());
+  this->effect->get_frame_range(range_first, range_end);
+
+  if (thread_count != 1)
+  {
+    pool.reset(new ThreadPool(thread_count));
+  }
+}
+
+void ConvertedEffect::process(uint8_t* block, uint64_t first_frame, size_t frame_count)
+{
+  uint64_t first = std::max(first_frame, range_first);
+  uint64_t last = std::min(first_frame + frame_count, range_end);
+  if (first >= last)
+  {
+    return;
+  }
+
+  uint8_t* frames = block + (first - first_frame) * block_size;
+  if (!pool)
+  {
+    process_tiles(frames, first, last - first, &planes[0], &clip_counts[0]);
+    return;
+  }
+
+  pool->parallel_for(last - first, PARALLEL_CHUNK_FRAMES, [&](size_t chunk_first, size_t chunk_end)
+  {
+    std::vector<float> chunk_planes(planes.size());
+    std::vector<uint64_t> chunk_clip_counts(clip_counts.size());
+    process_tiles(frames + chunk_first * block_size, first + chunk_first, chunk_end - chunk_first, &chunk_planes[0],
+                  &chunk_clip_counts[0]);
+
+    std::lock_guard<std::mutex> lock(clip_mutex);
+    for (size_t channel = 0; channel < clip_counts.size(); channel++)
+    {
+      clip_counts[channel] += chunk_clip_counts[channel];
+    }
+  });
+}
+
+void ConvertedEffect::process_tiles(uint8_t* frames, uint64_t first_frame, size_t frame_count, float* tile_planes,
+                                    uint64_t* tile_clip_counts)
+{
+  if (effect->process_frames(*converter, frames, first_frame, frame_count, tile_clip_counts))
+  {
+    return;
+  }
+
+  for (size_t tile = 0; tile < frame_count; tile += tile_frames)
+  {
+    size_t count = std::min(tile_frames, frame_count - tile);
+    uint8_t* tile_start = frames + tile * block_size;
+    converter->to_planar(tile_start, count, tile_planes, tile_frames);
+    effect->process(tile_planes, tile_frames, first_frame + tile, count);
+    converter->from_planar(tile_planes, tile_frames, count, tile_start, tile_clip_counts);
+  }
+}
+
+void ConvertedEffect::get_frame_range(uint64_t& first_frame, uint64_t& end_frame)
+{
+  first_frame = range_first;
+  end_frame = range_end;
+}
+
+uint64_t ConvertedEffect::get_tail_frames()
+{
+  return effect->get_tail_frames();
+}
+
+std::vector<uint64_t> ConvertedEffect::get_clip_counts()
+{
+  return clip_counts;
+}
+
+FadeEffect::FadeEffect(WavHeader& header, FadeOptions& options)
+{
+  uint32_t block_size = header.get_block_align();
+  num_of_chan = header.get_num_of_channels();
+
+  start_frame = time_to_frame_count(header, options.start);
+  end_frame = options.end_flag ? time_to_frame_count(header, options.end) : header.get_data_size() / block_size;
+
+  double reverse;
+  if (start_frame < end_frame)
+  {
+    start_ratio = 1.;
+    reverse = 1;
+  }
+  else
+  {
+    start_ratio = options.end_lvl_01;
+    reverse = -1;
+    std::swap(start_frame, end_frame);
+  }
+
+  uint64_t length = (end_frame - start_frame) * block_size;
+  double diff = (1. - options.end_lvl_01) * static_cast<double>(block_size) / length;
+  step = diff * reverse;
+}
+
+void FadeEffect::get_frame_range(uint64_t& first_frame, uint64_t& end_frame)
+{
+  first_frame = start_frame;
+  end_frame = this->end_frame;
+}
+
+void FadeEffect::process(float* planes, size_t plane_size, uint64_t first_frame, size_t frame_count)
+{
+  uint64_t block_end = first_frame + frame_count;
+  if (block_end <= start_frame || first_frame >= end_frame)
+  {
+    return;
+  }
+
+  uint64_t first = std::max(first_frame, start_frame);
+  uint64_t last = std::min(block_end, end_frame);
+
+  for (uint16_t channel = 0; channel < num_of_chan; channel++)
+  {
+    float* samples = planes + channel * plane_size + (first - first_frame);
+    kernels::gain_ramp(samples, last - first, start_ratio, step, first - start_frame);
+  }
+}
+
+bool FadeEffect::process_frames(FrameConverter& converter, uint8_t* frames, uint64_t first_frame, size_t frame_count,
+                                uint64_t* clip_counts)
+{
+  return converter.gain_ramp(frames, frame_count, start_ratio, step, first_frame - start_frame, clip_counts);
+}
+
+GainEffect::GainEffect(WavHeader& header, double gain) : gain(gain)
+{
+  num_of_chan = header.get_num_of_channels();
+  frame_count = header.get_data_size() / header.get_block_align();
+}
+
+void GainEffect::process(float* planes, size_t plane_size, uint64_t /*first_frame*/, size_t frame_count)
+{
+  for (uint16_t channel = 0; channel < num_of_chan; channel++)
+  {
+    kernels::gain_ramp(planes + channel * plane_size, frame_count, gain, 0., 0);
+  }
+}
+
+bool GainEffect::process_frames(FrameConverter& converter, uint8_t* frames, uint64_t /*first_frame*/,
+                                size_t frame_count, uint64_t* clip_counts)
+{
+  return converter.gain_ramp(frames, frame_count, gain, 0., 0, clip_counts);
+}
+
+void GainEffect::get_frame_range(uint64_t& first_frame, uint64_t& end_frame)
+{
+  first_frame = 0;
+  end_frame = frame_count;
+}
+
+ReverbEffect::ReverbEffect(WavHeader& header, ReverbOptions& options)
+{
+  num_of_chan = header.get_num_of_channels();
+  delay_frames = time_to_frame_count(header, options.delay);
+  data_frames = header.get_data_size() / header.get_block_align();
+  tail_frames = options.tail.to_frame(header.get_frequency());
+  decay = static_cast<float>(options.decay_01);
+  delay_line.resize((size_t)delay_frames * num_of_chan);
+}
+
+// The frames before delay are not changed, but they are needed as the source of the first echoes.
+void ReverbEffect::get_frame_range(uint64_t& first_frame, uint64_t& end_frame)
+{
+  first_frame = 0;
+  end_frame = data_frames + tail_frames;
+}
+
+uint64_t ReverbEffect::get_tail_frames()
+{
+  return tail_frames;
+}
+
+// The delay line starts with silence, so the frames before delay get zero echo.
+void ReverbEffect::process(float* planes, size_t plane_size, uint64_t /*first_frame*/, size_t frame_count)
+{
+  // Without delay every frame gets its own echo
+  if (delay_frames == 0)
+  {
+    for (uint16_t channel = 0; channel < num_of_chan; channel++)
+    {
+      float* samples = planes + channel * plane_size;
+      kernels::add_echo(samples, samples, frame_count, decay);
+    }
+    return;
+  }
+
+  size_t frame = 0;
+  while (frame < frame_count)
+  {
+    // Run of frames till the delay line wraps around
+    size_t run = std::min<size_t>(frame_count - frame, delay_frames - delay_pos);
+
+    for (uint16_t channel = 0; channel < num_of_chan; channel++)
+    {
+      float* line = &delay_line[(size_t)channel * delay_frames + delay_pos];
+      kernels::add_echo(planes + channel * plane_size + frame, line, run, decay);
+    }
+
+    frame += run;
+    delay_pos += run;
+    if (delay_pos == delay_frames)
+    {
+      delay_pos = 0;
+    }
+  }
+}
+
+
+FreeverbEffect::FreeverbEffect(WavHeader& header, FreeverbOptions& options)
+  : network(header.get_frequency(), header.get_num_of_channels(), options.room_size_01, options.damping_01,
+            options.wet_01, options.dry_01)
+{
+  data_frames = header.get_data_size() / header.get_block_align();
+  tail_frames = options.tail.to_frame(header.get_frequency());
+}
+
+void FreeverbEffect::get_frame_range(uint64_t& first_frame, uint64_t& end_frame)
+{
+  first_frame = 0;
+  end_frame = data_frames + tail_frames;
+}
+
+uint64_t FreeverbEffect::get_tail_frames()
+{
+  return tail_frames;
+}
+
+void FreeverbEffect::process(float* planes, size_t plane_size, uint64_t /*first_frame*/, size_t frame_count)
+{
+  network.process(planes, plane_size, frame_count);
+}
+
+
+EffectChain::EffectChain(const std::vector<uint8_t>& header_bytes, ChainOptions& options)
+{
+  // Header of the stage input differs from the file header only by data size,
+  // which can be larger than 4 GB after the tails
+  std::vector<uint8_t> stage_header_bytes = header_bytes;
+  reserve_rf64(stage_header_bytes);
+  WavHeader header = WavHeader(stage_header_bytes);
+  converter = converter_with_type_switch(header);
+  block_size = header.get_block_align();
+  tile_frames = std::max<size_t>(1, PLANAR_TILE_SAMPLES / header.get_num_of_channels());
+  planes.resize(tile_frames * header.get_num_of_channels());
+  clip_counts.resize(header.get_num_of_channels());
+  uint64_t in_frames = header.get_data_size() / block_size;
+
+  for (const ChainOptions::Stage& options_stage : options.stages)
+  {
+    set_wav_sizes(stage_header_bytes, in_frames * block_size, stage_header_bytes.size() + in_frames * block_size);
+    header = WavHeader(stage_header_bytes);
+
+    Stage stage;
+    stage.in_frames = in_frames;
+    stage.first_frame = 0;
+    stage.end_frame = in_frames;
+    switch (options_stage.type)
+    {
+    case ChainOptions::TRIM:
+    {
+      effects::trim_range(header, options.trim[options_stage.idx], stage.first_frame, stage.end_frame);
+      break;
+    }
+
+    case ChainOptions::FADE:
+      stage.effect.reset(new FadeEffect(header, options.fade[options_stage.idx]));
+      break;
+
+    case ChainOptions::REVERB:
+      stage.effect.reset(new ReverbEffect(header, options.reverb[options_stage.idx]));
+      break;
+
+    case ChainOptions::FREEVERB:
+      stage.effect.reset(new FreeverbEffect(header, options.freeverb[options_stage.idx]));
+      break;
+    }
+
+    stage.tail_frames = stage.effect ? stage.effect->get_tail_frames() : 0;
+    in_frames = stage.end_frame - stage.first_frame + stage.tail_frames;
+    stages.push_back(std::move(stage));
+  }
+}
+
+
+// Frames left of every tile are packed right after the frames left of the tiles before it.
+size_t EffectChain::run(size_t stage_idx, uint8_t* frames, uint64_t first_frame, size_t frame_count)
+{
+  size_t out_count = 0;
+  for (size_t tile = 0; tile < frame_count; tile += tile_frames)
+  {
+    size_t count = std::min(tile_frames, frame_count - tile);
+    converter->to_planar(frames + tile * block_size, count, &planes[0], tile_frames);
+
+    float* tile_planes = &planes[0];
+    count = run_planes(stage_idx, tile_planes, tile_frames, first_frame + tile, count);
+    converter->from_planar(tile_planes, tile_frames, count, frames + out_count * block_size, &clip_counts[0]);
+    out_count += count;
+  }
+  return out_count;
+}
+
+size_t EffectChain::run_planes(size_t stage_idx, float*& planes, size_t plane_size, uint64_t first_frame, size_t frame_count)
+{
+  for (; stage_idx < stages.size() && frame_count > 0; stage_idx++)
+  {
+    Stage& stage = stages[stage_idx];
+    if (stage.effect)
+    {
+      stage.effect->process(planes, plane_size, first_frame, frame_count);
+      continue;
+    }
+
+    // Frames of the tile outside of trim range are dropped
+    uint64_t block_end = first_frame + frame_count;
+    uint64_t first = std::max(first_frame, stage.first_frame);
+    uint64_t last = std::min(block_end, stage.end_frame);
+    if (first >= last)
+    {
+      return 0;
+    }
+    planes += (size_t)(first - first_frame);
+    frame_count = last - first;
+    first_frame = first - stage.first_frame;
+  }
+  return frame_count;
+}
+
+// Effects do not move frames and tails only go after the data,
+// so frames after the end of any trim are not needed and only leading trims move the first frame.
+void EffectChain::get_input_range(uint64_t& first_frame, uint64_t& end_frame)
+{
+  first_frame = 0;
+  end_frame = stages.empty() ? 0 : stages[0].in_frames;
+
+  uint64_t offset = 0;  // input frame of the first frame of stage input
+  bool leading = true;
+  for (Stage& stage : stages)
+  {
+    if (stage.effect)
+    {
+      leading = false;
+      continue;
+    }
+    if (leading)
+    {
+      first_frame = offset + stage.first_frame;
+    }
+    end_frame = std::min<uint64_t>(end_frame, (uint64_t)offset + stage.end_frame);
+    offset += stage.first_frame;
+  }
+}
+
+size_t EffectChain::get_stage_count()
+{
+  return stages.size();
+}
+
+uint64_t EffectChain::get_stage_in_frames(size_t stage_idx)
+{
+  return stages[stage_idx].in_frames;
+}
+
+uint64_t EffectChain::get_stage_tail_frames(size_t stage_idx)
+{
+  return stages[stage_idx].tail_frames;
+}
+
+void EffectChain::process(uint8_t* block, uint64_t first_frame, size_t frame_count)
+{
+  run(0, block, first_frame, frame_count);
+}
+
+// Union of the ranges of all stages.
+void EffectChain::get_frame_range(uint64_t& first_frame, uint64_t& end_frame)
+{
+  first_frame = std::numeric_limits<uint64_t>::max();
+  end_frame = 0;
+  for (Stage& stage : stages)
+  {
+    uint64_t stage_first = stage.first_frame, stage_end = stage.end_frame;
+    if (stage.effect)
+    {
+      stage.effect->get_frame_range(stage_first, stage_end);
+    }
+    first_frame = std::min(first_frame, stage_first);
+    end_frame = std::max(end_frame, stage_end);
+  }
+  first_frame = std::min(first_frame, end_frame);
+}
+
+std::vector<uint64_t> EffectChain::get_clip_counts()
+{
+  return clip_counts;
+}
+
+// K-weighting coefficients are computed for the frequency of the data from the analog prototypes,
+// like libebur128 does, so they match the tables of BS.1770 at 48 kHz.
+FrameAnalyzer::FrameAnalyzer(WavHeader& header, AnalyzeOptions& options)
+  : converter(converter_with_type_switch(header)), pool(options.thread_count)
+{
+  num_of_chan = header.get_num_of_channels();
+  block_size = header.get_block_align();
+  tile_frames = std::max<size_t>(1, PLANAR_TILE_SAMPLES / num_of_chan);
+  segment_frames = std::max<uint64_t>(1, (header.get_frequency() + 5) / 10);
+  chunk_frames = segment_frames * ANALYSIS_CHUNK_SEGMENTS;
+  warmup_frames = segment_frames * ANALYSIS_WARMUP_SEGMENTS;
+  stats.resize(num_of_chan);
+
+  const double pi = 3.14159265358979323846;
+  double shelf_f0 = 1681.974450955533, shelf_gain_db = 3.999843853973347, shelf_q = 0.7071752369554196;
+  double k = std::tan(pi * shelf_f0 / header.get_frequency());
+  double vh = std::pow(10., shelf_gain_db / 20.);
+  double vb = std::pow(vh, 0.4996667741545416);
+  double a0 = 1. + k / shelf_q + k * k;
+  shelf_b[0] = (vh + vb * k / shelf_q + k * k) / a0;
+  shelf_b[1] = 2. * (k * k - vh) / a0;
+  shelf_b[2] = (vh - vb * k / shelf_q + k * k) / a0;
+  shelf_a[0] = 1.;
+  shelf_a[1] = 2. * (k * k - 1.) / a0;
+  shelf_a[2] = (1. - k / shelf_q + k * k) / a0;
+
+  double pass_f0 = 38.13547087602444, pass_q = 0.5003270373238773;
+  k = std::tan(pi * pass_f0 / header.get_frequency());
+  a0 = 1. + k / pass_q + k * k;
+  pass_a[0] = 1.;
+  pass_a[1] = 2. * (k * k - 1.) / a0;
+  pass_a[2] = (1. - k / pass_q + k * k) / a0;
+
+  // Channels weigh like in BS.1770 by their speaker positions from the channel mask: side and back left and right
+  // surround channels weigh 1.41, LFE is not measured, and the others weigh 1.
+  // Without a mask the layout is unknown, so every channel weighs 1
+  channel_weights.assign(num_of_chan, 1.);
+  uint32_t mask = header.get_channel_mask();
+  for (uint16_t channel = 0; channel < num_of_chan && mask != 0; channel++)
+  {
+    uint32_t position = mask & (~mask + 1);
+    mask &= mask - 1;
+    if (position == speaker::LOW_FREQUENCY)
+    {
+      channel_weights[channel] = 0.;
+    }
+    else if (position & (speaker::BACK_LEFT | speaker::BACK_RIGHT | speaker::SIDE_LEFT | speaker::SIDE_RIGHT))
+    {
+      channel_weights[channel] = 1.41;
+    }
+  }
+}
+
+void FrameAnalyzer::process(const uint8_t* frames, uint64_t first_frame, size_t frame_count)
+{
+  stats::StageTimer effect_timer(stats::EFFECT);
+  size_t chunk_count = (frame_count + chunk_frames - 1) / chunk_frames;
+  std::vector<ChunkResult> results(chunk_count);
+  pool.parallel_for(chunk_count, 1, [&](size_t first_chunk, size_t end_chunk)
+  {
+    for (size_t chunk = first_chunk; chunk < end_chunk; chunk++)
+    {
+      size_t chunk_first = chunk * chunk_frames;
+      size_t count = std::min<size_t>(chunk_frames, frame_count - chunk_first);
+      // The first chunk starts the filter on the end of the previous block
+      if (chunk == 0)
+      {
+        analyze_chunk(frames, first_frame, count, warmup.data(), warmup.size() / block_size, results[chunk]);
+      }
+      else
+      {
+        analyze_chunk(frames + chunk_first * block_size, first_frame + chunk_first, count,
+                      frames + (chunk_first - warmup_frames) * block_size, warmup_frames, results[chunk]);
+      }
+    }
+  });
+
+  for (ChunkResult& result : results)
+  {
+    for (uint16_t channel = 0; channel < num_of_chan; channel++)
+    {
+      kernels::PlaneStats& chunk_stats = result.stats[channel];
+      stats[channel].peak = std::max(stats[channel].peak, chunk_stats.peak);
+      stats[channel].sum += chunk_stats.sum;
+      stats[channel].square_sum += chunk_stats.square_sum;
+      stats[channel].full_scale_count += chunk_stats.full_scale_count;
+    }
+    segment_energies.resize(result.first_segment + result.segment_energies.size());
+    for (size_t idx = 0; idx < result.segment_energies.size(); idx++)
+    {
+      segment_energies[result.first_segment + idx] += result.segment_energies[idx];
+    }
+  }
+
+  size_t warmup_count = std::min<size_t>(warmup_frames, frame_count);
+  warmup.assign(frames + (frame_count - warmup_count) * block_size, frames + frame_count * block_size);
+  this->frame_count += frame_count;
+  effect_timer.stop(frame_count * block_size, frame_count);
+}
+
+void FrameAnalyzer::analyze_chunk(const uint8_t* frames, uint64_t first_frame, size_t frame_count,
+                                  const uint8_t* warmup_start, size_t warmup_count, ChunkResult& result)
+{
+  std::vector<float> planes(tile_frames * num_of_chan);
+  std::vector<FilterState> states(num_of_chan);
+  float clip_level = converter->get_clip_level();
+
+  for (size_t tile = 0; tile < warmup_count; tile += tile_frames)
+  {
+    size_t count = std::min(tile_frames, warmup_count - tile);
+    converter->to_planar(warmup_start + tile * block_size, count, &planes[0], tile_frames);
+    for (uint16_t channel = 0; channel < num_of_chan; channel++)
+    {
+      if (channel_weights[channel] != 0.)
+      {
+        filter(&planes[channel * tile_frames], count, states[channel]);
+      }
+    }
+  }
+
+  result.stats.assign(num_of_chan, kernels::PlaneStats());
+  result.first_segment = first_frame / segment_frames;
+  uint64_t end_segment = (first_frame + frame_count + segment_frames - 1) / segment_frames;
+  result.segment_energies.assign(end_segment - result.first_segment, 0.);
+
+  for (size_t tile = 0; tile < frame_count; tile += tile_frames)
+  {
+    size_t count = std::min(tile_frames, frame_count - tile);
+    converter->to_planar(frames + tile * block_size, count, &planes[0], tile_frames);
+    for (uint16_t channel = 0; channel < num_of_chan; channel++)
+    {
+      const float* plane = &planes[channel * tile_frames];
+      kernels::add_plane_stats(plane, count, clip_level, result.stats[channel]);
+      if (channel_weights[channel] == 0.)
+      {
+        continue;
+      }
+
+      // Samples are filtered by runs that end at the borders of segments
+      for (size_t idx = 0; idx < count;)
+      {
+        uint64_t frame = first_frame + tile + idx;
+        uint64_t segment = frame / segment_frames;
+        size_t run = std::min<uint64_t>(count - idx, (segment + 1) * segment_frames - frame);
+        result.segment_energies[segment - result.first_segment] +=
+          channel_weights[channel] * filter(plane + idx, run, states[channel]);
+        idx += run;
+      }
+    }
+  }
+}
+
+double FrameAnalyzer::filter(const float* samples, size_t sample_count, FilterState& state)
+{
+  double square_sum = 0.;
+  for (size_t idx = 0; idx < sample_count; idx++)
+  {
+    double in = samples[idx];
+    double shelf_out = shelf_b[0] * in + state.shelf1;
+    state.shelf1 = shelf_b[1] * in - shelf_a[1] * shelf_out + state.shelf2;
+    state.shelf2 = shelf_b[2] * in - shelf_a[2] * shelf_out;
+
+    double out = shelf_out + state.pass1;
+    state.pass1 = -2. * shelf_out - pass_a[1] * out + state.pass2;
+    state.pass2 = shelf_out - pass_a[2] * out;
+    square_sum += out * out;
+  }
+  return square_sum;
+}
+
+size_t FrameAnalyzer::get_block_frames()
+{
+  size_t chunk_count = std::max<size_t>(pool.get_thread_count(), STREAM_BLOCK_BYTES / (chunk_frames * block_size));
+  return chunk_count * chunk_frames;
+}
+
+// Gating of BS.1770-4: blocks quieter than -70 LUFS are dropped, then the blocks more than 10 LU quieter
+// than the mean of the rest. Loudness of a block is -0.691 + 10 * log10 of its mean square.
+Analysis FrameAnalyzer::get_result()
+{
+  Analysis analysis;
+  analysis.frame_count = frame_count;
+  analysis.channels.resize(num_of_chan);
+  for (uint16_t channel = 0; channel < num_of_chan; channel++)
+  {
+    ChannelAnalysis& result = analysis.channels[channel];
+    result.peak = stats[channel].peak;
+    result.clip_count = stats[channel].full_scale_count;
+    if (frame_count > 0)
+    {
+      result.rms = std::sqrt(stats[channel].square_sum / frame_count);
+      result.dc_offset = stats[channel].sum / frame_count;
+    }
+  }
+
+  // Only whole segments make gating blocks
+  uint64_t segment_count = frame_count / segment_frames;
+  std::vector<double> block_energies;
+  for (uint64_t segment = 0; segment + 4 <= segment_count; segment++)
+  {
+    double energy = segment_energies[segment] + segment_energies[segment + 1] + segment_energies[segment + 2] +
+                    segment_energies[segment + 3];
+    block_energies.push_back(energy / (4 * segment_frames));
+  }
+
+  double absolute_gate = std::pow(10., (-70. + 0.691) / 10.);
+  double gated_sum = 0.;
+  size_t gated_count = 0;
+  for (double energy : block_energies)
+  {
+    if (energy > absolute_gate)
+    {
+      gated_sum += energy;
+      gated_count++;
+    }
+  }
+  if (gated_count == 0)
+  {
+    return analysis;
+  }
+
+  double relative_gate = std::max(absolute_gate, gated_sum / gated_count / 10.);
+  gated_sum = 0.;
+  gated_count = 0;
+  for (double energy : block_energies)
+  {
+    if (energy > relative_gate)
+    {
+      gated_sum += energy;
+      gated_count++;
+    }
+  }
+  if (gated_count > 0)
+  {
+    analysis.integrated_lufs = -0.691 + 10. * std::log10(gated_sum / gated_count);
+  }
+  return analysis;
+}
+
+
+/* Support functions implementation */
+
+void extend_data(std::vector<uint8_t>& bytes, WavHeader& header, uint64_t tail_frames)
+{
+  size_t data_end = header.get_data_offset() + header.get_data_size();
+  size_t tail_size = tail_frames * header.get_block_align();
+  if (tail_size == 0)
+  {
+    return;
+  }
+
+  // Silence is the middle value for 8-bit unsigned samples and zero otherwise
+  uint8_t silence = header.get_block_align() == header.get_num_of_channels() ? 0x80 : 0;
+  size_t trailer_off = std::min<uint64_t>(data_end + header.get_data_size() % 2, bytes.size());
+  std::vector<uint8_t> trailer(bytes.begin() + trailer_off, bytes.end());
+  size_t new_size = header.get_data_size() + tail_size;
+
+  bytes.resize(data_end);
+  bytes.insert(bytes.end(), tail_size + new_size % 2, silence);
+  if (new_size % 2 == 1)
+  {
+    bytes.back() = 0;
+  }
+  bytes.insert(bytes.end(), trailer.begin(), trailer.end());
+
+  write_sizes(bytes, header, new_size);
+}
+
+void write_sizes(std::vector<uint8_t>& bytes, WavHeader& header, uint64_t data_size)
+{
+  std::vector<uint8_t> header_bytes(bytes.begin(), bytes.begin() + header.get_data_offset());
+  set_wav_sizes(header_bytes, data_size, bytes.size());
+  std::copy(header_bytes.begin(), header_bytes.end(), bytes.begin());
+}
+
+Analysis analyze_data(WavHeader& header, const uint8_t* data, AnalyzeOptions& options)
+{
+  FrameAnalyzer analyzer(header, options);
+  size_t frame_count = header.get_data_size() / header.get_block_align();
+  if (frame_count > 0)
+  {
+    analyzer.process(data, 0, frame_count);
+  }
+  return analyzer.get_result();
+}
+
+// Buckets shorter than a tile are converted by tiles of whole buckets, longer buckets are converted by parts.
+void find_bucket_ranges(FrameConverter& converter, ThreadPool& pool, WavHeader& header, const uint8_t* frames,
+                        size_t frame_count, uint32_t bucket_frames, peaks::Range* ranges)
+{
+  uint16_t num_of_chan = header.get_num_of_channels();
+  size_t block_size = header.get_block_align();
+  size_t tile_frames = std::max<size_t>(1, PLANAR_TILE_SAMPLES / num_of_chan);
+  size_t tile_buckets = std::max<size_t>(1, tile_frames / bucket_frames);
+  size_t part_frames = std::min<size_t>(tile_frames, bucket_frames);
+  size_t bucket_count = peaks::bucket_count(frame_count, bucket_frames);
+
+  pool.parallel_for(bucket_count, std::max<size_t>(1, PARALLEL_CHUNK_FRAMES / bucket_frames),
+                    [&](size_t first_bucket, size_t end_bucket)
+  {
+    std::vector<float> planes(tile_frames * num_of_chan);
+    std::vector<float> min_vals(num_of_chan), max_vals(num_of_chan);
+    for (size_t tile = first_bucket; tile < end_bucket; tile += tile_buckets)
+    {
+      size_t tile_first = tile * bucket_frames;
+      size_t tile_end = std::min(end_bucket, tile + tile_buckets);
+      if (tile_buckets > 1)
+      {
+        size_t count = std::min<size_t>(frame_count, tile_end * bucket_frames) - tile_first;
+        converter.to_planar(frames + tile_first * block_size, count, &planes[0], tile_frames);
+      }
+
+      for (size_t bucket = tile; bucket < tile_end; bucket++)
+      {
+        std::fill(min_vals.begin(), min_vals.end(), std::numeric_limits<float>::max());
+        std::fill(max_vals.begin(), max_vals.end(), std::numeric_limits<float>::lowest());
+        size_t bucket_first = bucket * bucket_frames;
+        size_t bucket_end = std::min<size_t>(frame_count, bucket_first + bucket_frames);
+        for (size_t part = bucket_first; part < bucket_end; part += part_frames)
+        {
+          size_t count = std::min(part_frames, bucket_end - part);
+          size_t plane_offset = part - tile_first;
+          if (tile_buckets == 1)
+          {
+            converter.to_planar(frames + part * block_size, count, &planes[0], tile_frames);
+            plane_offset = 0;
+          }
+          for (uint16_t channel = 0; channel < num_of_chan; channel++)
+          {
+            kernels::min_max(&planes[channel * tile_frames + plane_offset], count, min_vals[channel], max_vals[channel]);
+          }
+        }
+        for (uint16_t channel = 0; channel < num_of_chan; channel++)
+        {
+          ranges[bucket * num_of_chan + channel] = peaks::Range::from_float(min_vals[channel], max_vals[channel]);
+        }
+      }
+    }
+  });
+}
+
+std::vector<uint64_t> normalize_data(WavHeader& header, uint8_t* data, NormalizeOptions& options)
+{
+  AnalyzeOptions analyze_options;
+  analyze_options.thread_count = options.thread_count;
+  double gain = effects::normalize_gain(analyze_data(header, data, analyze_options), options);
+
+  std::unique_ptr<BlockEffect> effect = effect_with_type_switch<GainEffect>(header, gain, options.thread_count);
+  effects::in_place(header, data, *effect);
+  return effect->get_clip_counts();
+}
+
+uint64_t time_to_frame_count(WavHeader& header, const TimePoint& time)
+{
+  uint64_t frame_count = time.to_frame(header.get_frequency());
+  if (frame_count > header.get_data_size() / header.get_block_align())
+  {
+    throw std::invalid_argument("Error: Time point " + time.to_string() + " is not in data range!");
+  }
+  return frame_count;
+}
+
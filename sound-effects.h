@@ -2,26 +2,163 @@
 #define SOUNDEFFECTS_H
 
 #include "mode-options.h"
+#include "wav-header.h"
+#include "wav-stream.h"
+#include "mapped-file.h"
 
 #include <vector>
+#include <limits>
 #include <cstdint>
+#include <cstddef>
 
 // TODO: Add comments about possible exceptions
 
+// Effect that processes WAV data block by block.
+// Blocks are passed in stream order and always contain whole frames,
+// so the effect can keep its state between blocks.
+class BlockEffect
+{
+public:
+  virtual ~BlockEffect() {}
+
+  // Processes frame_count frames of block. The first of them is first_frame of the data chunk.
+  virtual void process(uint8_t* block, uint64_t first_frame, size_t frame_count) = 0;
+
+  // Gets range [first_frame, end_frame) of data chunk frames the effect has to see.
+  // Frames outside of this range are left unchanged, so they can be skipped.
+  virtual void get_frame_range(uint64_t& first_frame, uint64_t& end_frame) = 0;
+
+  // Number of frames the effect adds after the end of data, e.g. reverb tail.
+  // These frames are passed to process() filled with silence after the data frames.
+  virtual uint64_t get_tail_frames() { return 0; }
+
+  // Number of samples of every channel clipped in the frames processed so far, see samples::clip_level().
+  // Empty if the effect can't clip samples.
+  virtual std::vector<uint64_t> get_clip_counts() { return std::vector<uint64_t>(); }
+};
+
+// Statistics of the samples of one channel, samples are measured from -1 to 1 of full scale.
+struct ChannelAnalysis
+{
+  double peak = 0.;         // largest absolute value of samples
+  double rms = 0.;
+  double dc_offset = 0.;    // mean value of samples
+  uint64_t clip_count = 0;  // samples at full scale or beyond it, see samples::clip_level()
+};
+
+// Result of the analysis of WAV data, see effects::analyze().
+struct Analysis
+{
+  uint64_t frame_count = 0;
+  std::vector<ChannelAnalysis> channels;
+
+  // Integrated loudness by EBU R128 (ITU-R BS.1770-4) in LUFS. Channels are weighed by the channel mask,
+  // see WavHeader::get_channel_mask(): surround channels by 1.41, LFE by 0, all channels by 1 without a mask.
+  // Minus infinity if data is shorter than 400 ms or all of it is below the gate of -70 LUFS.
+  double integrated_lufs = -std::numeric_limits<double>::infinity();
+};
+
 namespace effects
 {
   // Trim effect.
   // Removes WAV data to the left and to the right of selected fragment.
   void trim(std::vector<uint8_t>& bytes, TrimOptions& options);
+  void trim(WavReader& reader, WavWriter& writer, TrimOptions& options);
+
+  // Gets range [first_frame, end_frame) of data frames selected by trim, without moving them.
+  // Throws std::invalid_argument exception if a time point is out of data or the start is after the end.
+  void trim_range(WavHeader& header, TrimOptions& options, uint64_t& first_frame, uint64_t& end_frame);
+
+  // Effects that change samples return the number of clipped samples of every channel,
+  // see BlockEffect::get_clip_counts().
 
   // Fade effect.
   // Gradually reduces volume of WAV data from start point to end point.
   // The volume at start point is 100%. The volume at end point can be selected (0% by default).
-  void fade(std::vector<uint8_t>& bytes, FadeOptions& options);
+  std::vector<uint64_t> fade(std::vector<uint8_t>& bytes, FadeOptions& options);
+  std::vector<uint64_t> fade(WavReader& reader, WavWriter& writer, FadeOptions& options);
+  std::vector<uint64_t> fade(MappedFile& file, FadeOptions& options);
+
+  // Normalize effect.
+  // Measures WAV data like analyze() and multiplies all samples by one gain, see normalize_gain(),
+  // with the gain kernel of fade effect. The measure pass reads the file once more before the effect.
+  std::vector<uint64_t> normalize(WavReader& reader, WavWriter& writer, NormalizeOptions& options);
+  std::vector<uint64_t> normalize(MappedFile& file, NormalizeOptions& options);
+
+  // Gain of normalize effect for data with analysis.
+  // Loudness mode brings integrated loudness to the target, but not the peak above the peak level.
+  // Peak mode brings the peak to the peak level. Silence and data without gated loudness get gain 1.
+  double normalize_gain(const Analysis& analysis, NormalizeOptions& options);
 
   // Reverb effect.
   // Adds reverberation to WAV data with selected delay and decay coefficient.
-  void reverb(std::vector<uint8_t>& bytes, ReverbOptions& options);
+  // If tail length is selected, data is extended with the reverb of its last frames.
+  // The file with MappedFile can't be extended, so the tail is ignored there.
+  std::vector<uint64_t> reverb(std::vector<uint8_t>& bytes, ReverbOptions& options);
+  std::vector<uint64_t> reverb(WavReader& reader, WavWriter& writer, ReverbOptions& options);
+  std::vector<uint64_t> reverb(MappedFile& file, ReverbOptions& options);
+
+  // Freeverb effect.
+  // Adds room reverberation made by a network of comb and all-pass filters, see ReverbNetwork.
+  // Tail is handled like in reverb effect.
+  std::vector<uint64_t> freeverb(std::vector<uint8_t>& bytes, FreeverbOptions& options);
+  std::vector<uint64_t> freeverb(WavReader& reader, WavWriter& writer, FreeverbOptions& options);
+  std::vector<uint64_t> freeverb(MappedFile& file, FreeverbOptions& options);
+
+  // Chain effect.
+  // Applies effects of the chain one after another in a single pass over WAV data:
+  // every block of frames goes through all effects before it is written.
+  // Time points of every effect are measured in the output of the effects before it.
+  // Samples are rounded to the format of the file only after the last effect, so the result can differ
+  // from the same effects run one by one by up to one LSB per effect, and more where samples between
+  // the effects are above full scale: they are clipped only at the end.
+  // The file with MappedFile can't change its length, so there the chain can't contain trim or tails.
+  // Throws std::invalid_argument exception if the chain with MappedFile changes the length.
+  std::vector<uint64_t> chain(WavReader& reader, WavWriter& writer, ChainOptions& options);
+  std::vector<uint64_t> chain(MappedFile& file, ChainOptions& options);
+
+  // Analysis.
+  // Measures statistics of every channel and integrated loudness of WAV data in one pass, data is not changed.
+  // Data is split into chunks of fixed length, which are analyzed on several threads and summed up in their order,
+  // so the result is the same for any number of threads.
+  Analysis analyze(WavReader& reader, AnalyzeOptions& options);
+  Analysis analyze(const std::vector<uint8_t>& header_bytes, const uint8_t* data, AnalyzeOptions& options);
+
+  // Peaks.
+  // Makes peak file of WAV data for drawing its waveform, see peak-file.h: the lowest and the highest sample
+  // of every channel in buckets of options.bucket_frames frames are found on several threads,
+  // coarser levels are merged from them. Data is not changed.
+  std::vector<uint8_t> peaks(WavReader& reader, PeaksOptions& options);
+  std::vector<uint8_t> peaks(const std::vector<uint8_t>& header_bytes, const uint8_t* data, PeaksOptions& options);
+
+  // Effects on frames in memory, which are edited in place.
+  // header_bytes describe format and size of data (see make_wav_header()), data points to its first frame
+  // and does not have to follow the header. Memory of frames can't grow, so tails of single effects are ignored.
+  // Chain with trims packs the frames left right after the frames it cut at the start,
+  // their range [first_frame, first_frame + frame_count) of data is returned with the clip counts.
+  // Throws std::invalid_argument exception if a stage of the chain has a tail.
+  std::vector<uint64_t> fade(const std::vector<uint8_t>& header_bytes, uint8_t* data, FadeOptions& options);
+  std::vector<uint64_t> normalize(const std::vector<uint8_t>& header_bytes, uint8_t* data, NormalizeOptions& options);
+  std::vector<uint64_t> reverb(const std::vector<uint8_t>& header_bytes, uint8_t* data, ReverbOptions& options);
+  std::vector<uint64_t> freeverb(const std::vector<uint8_t>& header_bytes, uint8_t* data, FreeverbOptions& options);
+  std::vector<uint64_t> chain(const std::vector<uint8_t>& header_bytes, uint8_t* data, ChainOptions& options,
+                              uint64_t& first_frame, uint64_t& frame_count);
+
+  // Streams selected frames of reader through effect block by block and writes them with writer.
+  // Memory use is bounded by STREAM_BLOCK_BYTES plus the state of the effect.
+  // If effect is nullptr, frames are copied as they are.
+  void stream(WavReader& reader, WavWriter& writer, BlockEffect* effect);
+
+  // Runs effect over WAV file bytes in place, block by block.
+  // Data chunk must already have place for the tail frames of the effect.
+  // Only the frames in the effect range are accessed, so with a mapped file
+  // only the pages of that range are read and written back.
+  // Throws std::invalid_argument exception if data chunk does not fit into byte_count.
+  void in_place(uint8_t* bytes, size_t byte_count, BlockEffect& effect);
+
+  // Runs effect over data frames described by header in place, block by block.
+  // Frames of the effect range after the end of data, e.g. tail frames, are skipped.
+  void in_place(WavHeader& header, uint8_t* data, BlockEffect& effect);
 }
 
 #endif
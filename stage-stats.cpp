@@ -0,0 +1,117 @@
+#include "stage-stats.h"
+
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+/* Support functions */
+
+// Totals of one stage.
+struct StageTotals
+{
+  std::atomic<uint64_t> nanoseconds{ 0 };
+  std::atomic<uint64_t> byte_count{ 0 };
+  std::atomic<uint64_t> frame_count{ 0 };
+};
+
+StageTotals stage_totals[stats::STAGE_COUNT];
+
+const char* STAGE_NAMES[stats::STAGE_COUNT] = { "header", "read", "effect", "write" };
+
+bool print_json = false;
+
+
+/* Stats implementation */
+
+bool stats::enabled = false;
+
+void stats::enable(bool json_output)
+{
+  enabled = true;
+  print_json = json_output;
+}
+
+void stats::add(Stage stage, std::chrono::steady_clock::duration time, uint64_t byte_count, uint64_t frame_count)
+{
+  StageTotals& totals = stage_totals[stage];
+  totals.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+  totals.byte_count += byte_count;
+  totals.frame_count += frame_count;
+}
+
+uint64_t stats::peak_rss_bytes()
+{
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+  {
+    return counters.PeakWorkingSetSize;
+  }
+  return 0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+  {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss;  // bytes on macOS
+#else
+  return (uint64_t)usage.ru_maxrss * 1024;  // kilobytes on Linux
+#endif
+#endif
+}
+
+// Rates of a stage that took no measurable time are printed as 0.
+void stats::print(std::ostream& out, double wall_seconds)
+{
+  std::ostringstream text;
+  if (print_json)
+  {
+    text << "{\"stages\":{";
+  }
+  else
+  {
+    text << std::left << std::setw(8) << "Stage" << std::right << std::setw(12) << "Time, s" << std::setw(12)
+         << "Data, MB" << std::setw(14) << "Frames/s" << std::setw(10) << "MB/s" << '\n';
+  }
+
+  for (int stage = 0; stage < STAGE_COUNT; stage++)
+  {
+    const StageTotals& totals = stage_totals[stage];
+    double seconds = totals.nanoseconds / 1e9;
+    double frames_per_s = seconds > 0 ? totals.frame_count / seconds : 0.;
+    double mb_per_s = seconds > 0 ? totals.byte_count / 1e6 / seconds : 0.;
+
+    if (print_json)
+    {
+      text << (stage > 0 ? "," : "") << '"' << STAGE_NAMES[stage] << "\":{\"seconds\":" << seconds
+           << ",\"bytes\":" << totals.byte_count << ",\"frames\":" << totals.frame_count
+           << ",\"frames_per_s\":" << frames_per_s << ",\"mb_per_s\":" << mb_per_s << '}';
+    }
+    else
+    {
+      text << std::left << std::setw(8) << STAGE_NAMES[stage] << std::right << std::fixed << std::setprecision(6)
+           << std::setw(12) << seconds << std::setw(12) << totals.byte_count / 1e6 << std::setprecision(0)
+           << std::setw(14) << frames_per_s << std::setw(10) << mb_per_s << '\n';
+    }
+  }
+
+  if (print_json)
+  {
+    text << "},\"wall_seconds\":" << wall_seconds << ",\"peak_rss_bytes\":" << peak_rss_bytes() << '}';
+  }
+  else
+  {
+    text << std::setprecision(6) << "Wall time: " << wall_seconds << " s, peak RSS: " << std::setprecision(1)
+         << peak_rss_bytes() / 1e6 << " MB";
+  }
+  out << text.str() << std::endl;
+}
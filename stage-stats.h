@@ -0,0 +1,60 @@
+#ifndef STAGESTATS_H
+#define STAGESTATS_H
+
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+// Instrumentation of the stages of file editing: wall time, bytes and frames of every stage.
+// Stage times are summed over all blocks and all threads. Timers do nothing unless stats are enabled,
+// so the code paths only pay one check of a flag per block when they are disabled.
+namespace stats
+{
+  enum Stage { HEADER, READ, EFFECT, WRITE, STAGE_COUNT };
+
+  // Set once before any work starts, see enable().
+  extern bool enabled;
+
+  // Enables stats, they are printed as a table or as one JSON object line if json_output is true.
+  void enable(bool json_output);
+
+  // Adds time, bytes and frames of one run of stage. Safe to call from several threads.
+  void add(Stage stage, std::chrono::steady_clock::duration time, uint64_t byte_count, uint64_t frame_count);
+
+  // Peak resident set size of the process in bytes, 0 if it is not known.
+  uint64_t peak_rss_bytes();
+
+  // Prints the time, bytes, frames per second and MB/s of every stage, wall time of the whole job and peak RSS.
+  void print(std::ostream& out, double wall_seconds);
+
+  // Timer of one run of a stage, started on construction.
+  class StageTimer
+  {
+  private:
+    Stage stage;
+    bool running;
+    std::chrono::steady_clock::time_point start_time;
+
+  public:
+    StageTimer(Stage stage) : stage(stage), running(enabled)
+    {
+      if (running)
+      {
+        start_time = std::chrono::steady_clock::now();
+      }
+    }
+
+    // Adds the time since construction with byte_count bytes and frame_count frames to the stage.
+    // Only the first stop counts, a timer that is never stopped adds nothing.
+    void stop(uint64_t byte_count, uint64_t frame_count = 0)
+    {
+      if (running)
+      {
+        add(stage, std::chrono::steady_clock::now() - start_time, byte_count, frame_count);
+        running = false;
+      }
+    }
+  };
+}
+
+#endif
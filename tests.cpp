@@ -0,0 +1,242 @@
+#include "readfile.h"
+#include "writefile.h"
+#include "mode-options.h"
+#include "wav-header.h"
+#include "wav-stream.h"
+#include "wavedit.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <csignal>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Tests of wav-edit, run by ctest. Every test is run by its name:
+//   wav-edit-tests NAME WORK_DIR [WAV_EDIT]
+// Files of the test are made in WORK_DIR, tests of the program run the wav-edit executable WAV_EDIT.
+// A test prints "ok NAME" and returns 0, or prints the failed check and returns 1.
+
+/* Support functions */
+
+// Throws std::runtime_error with message if condition is false.
+void check(bool condition, const std::string& message);
+
+// Makes WAVE file bytes of frame_count 16-bit stereo frames of silence.
+std::vector<uint8_t> make_silence(uint32_t frame_count);
+
+// Zero-frame file, e.g. made by trim of the whole data, can be opened, edited and analyzed.
+void test_zero_frame_file(const std::string& work_dir);
+
+#ifndef _WIN32
+// Connects to the server at socket_path, waiting up to 10 s till it listens. Replies are awaited up to 10 s.
+// Throws std::runtime_error if the server does not accept the connection.
+int connect_client(const std::string& socket_path);
+
+// Sends request line to the server and returns the reply line.
+// Throws std::runtime_error if the reply does not come.
+std::string send_request(int fd, const std::string& line);
+
+// Server of serve mode replies to a client while another client stays connected, also with one thread.
+void test_serve_two_clients(const std::string& work_dir, const std::string& wav_edit_path);
+#endif
+
+
+int main(const int argc, const char* argv[])
+{
+  if (argc != 3 && argc != 4)
+  {
+    std::cerr << "Usage: wav-edit-tests NAME WORK_DIR [WAV_EDIT]\n";
+    return 1;
+  }
+
+  std::string name = argv[1];
+  try
+  {
+    if (name == "zero-frame-file")
+    {
+      test_zero_frame_file(argv[2]);
+    }
+#ifndef _WIN32
+    else if (name == "serve-two-clients" && argc == 4)
+    {
+      test_serve_two_clients(argv[2], argv[3]);
+    }
+#endif
+    else
+    {
+      throw std::invalid_argument("Error: Unknown test '" + name + "'.");
+    }
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "FAILED " << name << ": " << e.what() << "\n";
+    return 1;
+  }
+
+  std::cout << "ok " << name << "\n";
+  return 0;
+}
+
+
+/* Support functions implementation */
+
+void check(bool condition, const std::string& message)
+{
+  if (!condition)
+  {
+    throw std::runtime_error(message);
+  }
+}
+
+std::vector<uint8_t> make_silence(uint32_t frame_count)
+{
+  std::vector<uint8_t> bytes = make_wav_header(format::WAVE_FORMAT_PCM, 2, 48000, 16, frame_count * 4ull);
+  bytes.resize(bytes.size() + frame_count * 4ull);
+  return bytes;
+}
+
+void test_zero_frame_file(const std::string& work_dir)
+{
+  std::vector<uint8_t> empty = make_silence(0);
+  check(empty.size() == 44, "zero-frame header is not 44 bytes");
+  check(WavHeader(empty).get_data_size() == 0, "zero-frame header bytes do not parse");
+
+  std::string full_path = work_dir + "/zero-frame-full.wav", trimmed_path = work_dir + "/zero-frame-trimmed.wav";
+  std::string faded_path = work_dir + "/zero-frame-faded.wav";
+  std::vector<uint8_t> full = make_silence(1000);
+  writefile(full, full_path);
+
+  // Trim with the same start and end leaves no frames
+  const char* trim_argv[] = { "wav-edit", "trim", full_path.c_str(), "-s", "500smp", "-e", "500smp" };
+  TrimOptions trim_options(7, trim_argv);
+  std::vector<uint64_t> clip_counts;
+  {
+    WavReader reader(full_path.c_str());
+    wavedit::edit_file(trim_options, reader, trimmed_path.c_str(), clip_counts);
+  }
+  check(readfile(trimmed_path.c_str()) == empty, "trimmed file is not the zero-frame file");
+  check(WavHeader(trimmed_path.c_str()).get_data_size() == 0, "zero-frame file does not open");
+
+  const char* fade_argv[] = { "wav-edit", "fade", trimmed_path.c_str() };
+  FadeOptions fade_options(3, fade_argv);
+  {
+    WavReader reader(trimmed_path.c_str());
+    wavedit::edit_file(fade_options, reader, faded_path.c_str(), clip_counts);
+  }
+  check(readfile(faded_path.c_str()) == empty, "faded zero-frame file changed");
+
+  const char* analyze_argv[] = { "wav-edit", "analyze", faded_path.c_str() };
+  AnalyzeOptions analyze_options(3, analyze_argv);
+  WavReader reader(faded_path.c_str());
+  check(wavedit::analyze(reader, analyze_options).frame_count == 0, "analysis of zero-frame file has frames");
+
+  std::remove(full_path.c_str());
+  std::remove(trimmed_path.c_str());
+  std::remove(faded_path.c_str());
+}
+
+#ifndef _WIN32
+
+int connect_client(const std::string& socket_path)
+{
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  check(socket_path.size() < sizeof(address.sun_path), "socket path is too long");
+  memcpy(address.sun_path, socket_path.c_str(), socket_path.size());
+
+  for (int attempt = 0; attempt < 1000; attempt++)
+  {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    check(fd != -1, "socket could not be made");
+    if (connect(fd, (const sockaddr*)&address, sizeof(address)) == 0)
+    {
+      timeval timeout = { 10, 0 };
+      setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      return fd;
+    }
+    close(fd);
+    usleep(10000);
+  }
+  throw std::runtime_error("server does not accept connections at " + socket_path);
+}
+
+std::string send_request(int fd, const std::string& line)
+{
+  std::string bytes = line + '\n';
+  check(send(fd, bytes.data(), bytes.size(), MSG_NOSIGNAL) == (ssize_t)bytes.size(), "request '" + line + "' was not sent");
+
+  std::string reply;
+  char byte;
+  while (true)
+  {
+    ssize_t count = recv(fd, &byte, 1, 0);
+    if (count == -1 && errno == EINTR)
+    {
+      continue;
+    }
+    check(count == 1, "no reply to request '" + line + "'");
+    if (byte == '\n')
+    {
+      return reply;
+    }
+    reply += byte;
+  }
+}
+
+void test_serve_two_clients(const std::string& work_dir, const std::string& wav_edit_path)
+{
+  std::string wav_path = work_dir + "/serve-two-clients.wav", socket_path = work_dir + "/serve-two-clients.sock";
+  std::vector<uint8_t> silence = make_silence(1000);
+  writefile(silence, wav_path);
+
+  // With one thread, the first connection used to hold the only thread and the second client was not served
+  pid_t server = fork();
+  check(server != -1, "server process could not be started");
+  if (server == 0)
+  {
+    execl(wav_edit_path.c_str(), wav_edit_path.c_str(), "serve", socket_path.c_str(), "-j", "1", (char*)nullptr);
+    _exit(127);
+  }
+
+  int first = -1, second = -1;
+  try
+  {
+    const std::string ok = "{\"status\":\"ok\",\"mode\":\"info\"";
+    first = connect_client(socket_path);
+    check(send_request(first, "info " + wav_path).compare(0, ok.size(), ok) == 0, "first client is not served");
+    second = connect_client(socket_path);
+    check(send_request(second, "info " + wav_path).compare(0, ok.size(), ok) == 0,
+          "second client is not served while the first one is connected");
+    check(send_request(first, "info " + wav_path).compare(0, ok.size(), ok) == 0, "first client is not served any more");
+    check(send_request(second, "shutdown") == "{\"status\":\"ok\",\"mode\":\"shutdown\"}", "server is not shut down");
+  }
+  catch (...)
+  {
+    kill(server, SIGKILL);
+    waitpid(server, nullptr, 0);
+    throw;
+  }
+
+  // Server stops with the first client still connected
+  int status = 0;
+  waitpid(server, &status, 0);
+  close(first);
+  close(second);
+  std::remove(wav_path.c_str());
+  check(WIFEXITED(status) && WEXITSTATUS(status) == 0, "server did not exit normally");
+}
+
+#endif
@@ -0,0 +1,148 @@
+#include "thread-pool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+  if (thread_count == 0)
+  {
+    thread_count = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t idx = 1; idx < thread_count; idx++)
+  {
+    workers.push_back(std::thread(&ThreadPool::work, this));
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  task_added.notify_all();
+  for (std::thread& worker : workers)
+  {
+    worker.join();
+  }
+}
+
+size_t ThreadPool::get_thread_count()
+{
+  return workers.size() + 1;
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+  if (workers.empty())
+  {
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      if (!error)
+      {
+        error = std::current_exception();
+      }
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+  }
+  task_added.notify_one();
+}
+
+void ThreadPool::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  task_done.wait(lock, [this] { return tasks.empty() && running == 0; });
+
+  if (error)
+  {
+    std::exception_ptr task_error = error;
+    error = nullptr;
+    std::rethrow_exception(task_error);
+  }
+}
+
+void ThreadPool::parallel_for(size_t count, size_t min_chunk, const std::function<void(size_t, size_t)>& task)
+{
+  size_t chunk_count = std::min(get_thread_count(), count / std::max<size_t>(min_chunk, 1));
+  if (chunk_count <= 1)
+  {
+    if (count > 0)
+    {
+      task(0, count);
+    }
+    return;
+  }
+
+  // Chunks differ in size by one item at most
+  for (size_t chunk = 1; chunk < chunk_count; chunk++)
+  {
+    size_t first = count * chunk / chunk_count, end = count * (chunk + 1) / chunk_count;
+    submit([&task, first, end] { task(first, end); });
+  }
+
+  try
+  {
+    task(0, count / chunk_count);
+  }
+  catch (...)
+  {
+    // Other chunks still use task, so they have to finish first
+    try
+    {
+      wait();
+    }
+    catch (...)
+    {
+    }
+    throw;
+  }
+  wait();
+}
+
+void ThreadPool::work()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    task_added.wait(lock, [this] { return stopping || !tasks.empty(); });
+    if (tasks.empty())
+    {
+      return;
+    }
+
+    std::function<void()> task = std::move(tasks.front());
+    tasks.pop_front();
+    running++;
+    lock.unlock();
+
+    try
+    {
+      task();
+    }
+    catch (...)
+    {
+      lock.lock();
+      if (!error)
+      {
+        error = std::current_exception();
+      }
+      lock.unlock();
+    }
+
+    lock.lock();
+    running--;
+    if (tasks.empty() && running == 0)
+    {
+      task_done.notify_all();
+    }
+  }
+}
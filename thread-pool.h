@@ -0,0 +1,51 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+// Fixed pool of worker threads running tasks in the order they are submitted.
+// The pool with one thread has no workers: its tasks run in the calling thread.
+// The pool is meant to have one owner that submits tasks and waits for them.
+// A pool with workers also takes tasks submitted from other threads, which wait for them by themselves.
+class ThreadPool
+{
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()>> tasks;
+  std::mutex mutex;
+  std::condition_variable task_added, task_done;
+  size_t running = 0;
+  bool stopping = false;
+  std::exception_ptr error;
+
+  void work();
+
+public:
+  // Pool with thread_count threads, or with one thread for every CPU core if thread_count is 0.
+  ThreadPool(size_t thread_count);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t get_thread_count();
+
+  void submit(std::function<void()> task);
+
+  // Waits until all submitted tasks are done.
+  // Rethrows the first exception thrown by the tasks since the last wait.
+  void wait();
+
+  // Splits range [0, count) into chunks of at least min_chunk items, one chunk for every thread,
+  // runs task(first, end) for every chunk and waits for all of them.
+  // The calling thread runs the first chunk.
+  void parallel_for(size_t count, size_t min_chunk, const std::function<void(size_t, size_t)>& task);
+};
+
+#endif
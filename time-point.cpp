@@ -0,0 +1,177 @@
+#include "time-point.h"
+
+#include <stdexcept>
+#include <vector>
+
+const uint64_t NS_PER_MS = 1000000;
+const uint64_t NS_PER_SECOND = 1000000000;
+
+/* Support functions */
+
+// Parses decimal number with an optional fraction, e.g. "12.25", and returns it multiplied by unit_ns.
+// Digits of the fraction smaller than a nanosecond are dropped.
+// Throws std::invalid_argument exception if text is not a number or the number is longer than TimePoint::MAX_SECONDS
+uint64_t decimal_to_ns(const std::string& text, uint64_t unit_ns, const std::string& time_text);
+
+// Throws std::invalid_argument exception with the message about invalid time point text.
+void throw_invalid_time(const std::string& time_text);
+
+
+/* TimePoint implementation */
+
+TimePoint TimePoint::from_frames(uint64_t frame_idx)
+{
+  return TimePoint(frame_idx, true);
+}
+
+TimePoint TimePoint::from_ms(uint64_t time_ms)
+{
+  return TimePoint(time_ms * NS_PER_MS, false);
+}
+
+TimePoint TimePoint::from_ns(uint64_t time_ns)
+{
+  return TimePoint(time_ns, false);
+}
+
+TimePoint TimePoint::parse(const std::string& text)
+{
+  if (text.size() > 3 && text.compare(text.size() - 3, 3, "smp") == 0)
+  {
+    std::string digits = text.substr(0, text.size() - 3);
+    if (digits.find_first_not_of("0123456789") != std::string::npos || digits.size() > 18)
+    {
+      throw_invalid_time(text);
+    }
+    return from_frames(std::stoull(digits));
+  }
+
+  if (text.find(':') == std::string::npos)
+  {
+    if (text.size() > 2 && text.compare(text.size() - 2, 2, "ms") == 0)
+    {
+      return from_ns(decimal_to_ns(text.substr(0, text.size() - 2), NS_PER_MS, text));
+    }
+    if (text.size() > 1 && text.back() == 's')
+    {
+      return from_ns(decimal_to_ns(text.substr(0, text.size() - 1), NS_PER_SECOND, text));
+    }
+    return from_ns(decimal_to_ns(text, NS_PER_MS, text));
+  }
+
+  // Timecode: hours and minutes are whole numbers, only the seconds can have a fraction
+  std::vector<std::string> fields;
+  size_t field_start = 0, colon;
+  while ((colon = text.find(':', field_start)) != std::string::npos)
+  {
+    fields.push_back(text.substr(field_start, colon - field_start));
+    field_start = colon + 1;
+  }
+  fields.push_back(text.substr(field_start));
+  if (fields.size() > 3)
+  {
+    throw_invalid_time(text);
+  }
+
+  uint64_t time_ns = decimal_to_ns(fields.back(), NS_PER_SECOND, text);
+  if (time_ns >= 60 * NS_PER_SECOND)
+  {
+    throw_invalid_time(text);
+  }
+  uint64_t unit_ns = 60 * NS_PER_SECOND;
+  for (size_t idx = fields.size() - 1; idx-- > 0; unit_ns *= 60)
+  {
+    if (fields[idx].find('.') != std::string::npos)
+    {
+      throw_invalid_time(text);
+    }
+    uint64_t field_ns = decimal_to_ns(fields[idx], unit_ns, text);
+    // Minutes after hours are less than an hour
+    if (idx > 0 && field_ns >= 60 * unit_ns)
+    {
+      throw_invalid_time(text);
+    }
+    time_ns += field_ns;
+  }
+  if (time_ns > MAX_SECONDS * NS_PER_SECOND)
+  {
+    throw std::invalid_argument("Error: Time point " + text + " is too long.");
+  }
+  return from_ns(time_ns);
+}
+
+// Whole seconds and the rest are converted separately, so the products fit into 64 bits.
+uint64_t TimePoint::to_frame(uint32_t frequency) const
+{
+  if (is_frame)
+  {
+    return value;
+  }
+  uint64_t seconds = value / NS_PER_SECOND, rest_ns = value % NS_PER_SECOND;
+  return seconds * frequency + (rest_ns * frequency + NS_PER_SECOND / 2) / NS_PER_SECOND;
+}
+
+bool TimePoint::is_zero() const
+{
+  return value == 0;
+}
+
+std::string TimePoint::to_string() const
+{
+  if (is_frame)
+  {
+    return std::to_string(value) + "smp";
+  }
+
+  std::string text = std::to_string(value / NS_PER_MS);
+  uint64_t rest_ns = value % NS_PER_MS;
+  if (rest_ns > 0)
+  {
+    std::string fraction = std::to_string(NS_PER_MS + rest_ns).substr(1);
+    text += "." + fraction.substr(0, fraction.find_last_not_of('0') + 1);
+  }
+  return text + "ms";
+}
+
+
+/* Support functions implementation */
+
+uint64_t decimal_to_ns(const std::string& text, uint64_t unit_ns, const std::string& time_text)
+{
+  size_t point = text.find('.');
+  std::string integer = text.substr(0, point);
+  std::string fraction = point == std::string::npos ? "" : text.substr(point + 1);
+  if (integer.empty() || integer.find_first_not_of("0123456789") != std::string::npos ||
+      fraction.find_first_not_of("0123456789") != std::string::npos ||
+      (point != std::string::npos && fraction.empty()))
+  {
+    throw_invalid_time(time_text);
+  }
+
+  uint64_t max_integer = TimePoint::MAX_SECONDS * NS_PER_SECOND / unit_ns;
+  uint64_t integer_value = 0;
+  for (char digit : integer)
+  {
+    integer_value = integer_value * 10 + (digit - '0');
+    if (integer_value > max_integer)
+    {
+      throw std::invalid_argument("Error: Time point " + time_text + " is too long.");
+    }
+  }
+
+  uint64_t fraction_ns = 0;
+  uint64_t digit_ns = unit_ns;
+  for (char digit : fraction)
+  {
+    digit_ns /= 10;
+    fraction_ns += (digit - '0') * digit_ns;
+  }
+  return integer_value * unit_ns + fraction_ns;
+}
+
+void throw_invalid_time(const std::string& time_text)
+{
+  throw std::invalid_argument("Error: Invalid time point '" + time_text +
+                              "', it should be milliseconds (1500, 1500ms), seconds (1.5s), "
+                              "frame index (66150smp) or timecode (1:02:03.25).");
+}
@@ -0,0 +1,46 @@
+#ifndef TIMEPOINT_H
+#define TIMEPOINT_H
+
+#include <string>
+#include <cstdint>
+
+// Time point in WAVE data: a frame index or a time from the start of data.
+// Time is kept in nanoseconds, so milliseconds and timecode fractions are exact,
+// and it is converted to the nearest frame in 64-bit arithmetic only when the frequency is known.
+class TimePoint
+{
+private:
+  uint64_t value = 0;  // frame index or nanoseconds
+  bool is_frame = false;
+
+  TimePoint(uint64_t value, bool is_frame) : value(value), is_frame(is_frame) {}
+
+public:
+  TimePoint() {}
+
+  static TimePoint from_frames(uint64_t frame_idx);
+  static TimePoint from_ms(uint64_t time_ms);
+  static TimePoint from_ns(uint64_t time_ns);
+
+  // Parses time point in one of the forms:
+  // "1500" or "1500ms" - milliseconds, "1.5s" - seconds, both can have a fraction;
+  // "66150smp" - index of frame (one sample of every channel);
+  // "1:02:03.25" or "2:03.25" - timecode of hours, minutes, seconds and fraction of second.
+  // Fractions are exact up to nanoseconds.
+  //
+  // Throws std::invalid_argument exception if text is not a time point or the time is longer than MAX_SECONDS
+  static TimePoint parse(const std::string& text);
+
+  // Index of the frame nearest to the time point at frequency, a time in the middle of frames goes to the later one.
+  uint64_t to_frame(uint32_t frequency) const;
+
+  bool is_zero() const;
+
+  // Time point in the form it can be parsed from, e.g. for error messages.
+  std::string to_string() const;
+
+  // Longest time of a time point, so the frame index can't overflow 64 bits.
+  static const uint64_t MAX_SECONDS = 1000000000;
+};
+
+#endif
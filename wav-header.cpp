@@ -1,19 +1,27 @@
 #include "wav-header.h"
-#include "readfile.h"
 
+#include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
+#include <algorithm>
 
 namespace id
 {
   const uint32_t RIFF = 0x52494646;
+  const uint32_t RF64 = 0x52463634;
+  const uint32_t BW64 = 0x42573634;
+  const uint32_t ds64 = 0x64733634;
   const uint32_t WAVE = 0x57415645;
   const uint32_t fmt  = 0x666D7420;
   const uint32_t data = 0x64617461;
   const uint32_t fact = 0x66616374;
+  const uint32_t JUNK = 0x4A554E4B;
 }
 
+// Size of "ds64" subchunk contents without the table of other chunk sizes.
+const uint32_t DS64_SIZE = 28;
+
 namespace type
 {
   const std::string UINT8_T   = "uint8_t";
@@ -25,66 +33,154 @@ namespace type
 
 using std::string;
 
-uint32_t _4x8_to_32_be(const std::vector<uint8_t> &byte_file, size_t idx)
+uint32_t _4x8_to_32_be(const uint8_t* byte_file, size_t idx)
 {
   return byte_file[idx] << 24 | (byte_file[idx + 1] << 16) | (byte_file[idx + 2] << 8) | (byte_file[idx + 3]);
 }
 
-uint32_t _4x8_to_32_le(const std::vector<uint8_t> &byte_file, size_t idx)
+uint32_t _4x8_to_32_le(const uint8_t* byte_file, size_t idx)
 {
   return byte_file[idx] | (byte_file[idx + 1] << 8) | (byte_file[idx + 2] << 16) | (byte_file[idx + 3] << 24);
 }
 
-uint32_t _2x8_to_16_le(const std::vector<uint8_t> &byte_file, size_t idx)
+uint64_t _8x8_to_64_le(const uint8_t* byte_file, size_t idx)
+{
+  return _4x8_to_32_le(byte_file, idx) | (uint64_t)_4x8_to_32_le(byte_file, idx + 4) << 32;
+}
+
+void _32_to_4x8_be(uint8_t* byte_file, size_t idx, uint32_t val)
+{
+  for (int byte = 0; byte < 4; byte++)
+  {
+    byte_file[idx + byte] = (uint8_t)(val >> (24 - 8 * byte));
+  }
+}
+
+void _64_to_8x8_le(uint8_t* byte_file, size_t idx, uint64_t val, int byte_count)
+{
+  for (int byte = 0; byte < byte_count; byte++)
+  {
+    byte_file[idx + byte] = (uint8_t)(val >> (8 * byte));
+  }
+}
+
+// Returns true if the first subchunk of the header can hold "ds64" contents.
+bool has_ds64_place(const std::vector<uint8_t>& header_bytes)
+{
+  if (header_bytes.size() < 20)
+  {
+    return false;
+  }
+  uint32_t first_ID = _4x8_to_32_be(header_bytes.data(), 12);
+  return (first_ID == id::ds64 || first_ID == id::JUNK) && _4x8_to_32_le(header_bytes.data(), 16) >= DS64_SIZE;
+}
+
+uint32_t _2x8_to_16_le(const uint8_t* byte_file, size_t idx)
 {
   return byte_file[idx] | (byte_file[idx + 1] << 8);
 }
 
-WavHeader::WavHeader(const std::vector<uint8_t> &byte_file)
+WavHeader::WavHeader(const std::vector<uint8_t> &byte_file) : WavHeader(byte_file.data(), byte_file.size()) {}
+
+WavHeader::WavHeader(const uint8_t* byte_file, size_t byte_count)
 {
-  if (byte_file.size() < 44)
+  read_riff(byte_file, byte_count);
+  find_data([byte_file, byte_count](uint64_t offset, size_t read_count)
+  {
+    if (offset + read_count > byte_count)
+    {
+      throw std::out_of_range("Error: Bad file - WAVE header is incomplete!");
+    }
+    return byte_file + offset;
+  });
+}
+
+WavHeader::WavHeader(const char* file_path)
+{
+  std::ifstream infile;
+  // Probes are read straight into the probe buffer
+  infile.rdbuf()->pubsetbuf(nullptr, 0);
+  infile.open(file_path, std::ios_base::in | std::ios_base::binary);
+  if (!infile.is_open())
+  {
+    throw std::invalid_argument("Error: File path '" + string(file_path) + "' could not be opened.");
+  }
+
+  std::vector<uint8_t> probe(HEADER_PROBE_BYTES);
+  uint64_t probe_pos = 0;
+  infile.read((char*)&probe[0], probe.size());
+  size_t probe_size = infile.gcount();
+
+  read_riff(&probe[0], probe_size);
+  find_data([&](uint64_t offset, size_t read_count)
+  {
+    // Subchunks after the probe are skipped with a seek to the next subchunk header
+    if (offset < probe_pos || offset + read_count > probe_pos + probe_size)
+    {
+      infile.clear();
+      infile.seekg(offset);
+      infile.read((char*)&probe[0], probe.size());
+      probe_pos = offset;
+      probe_size = infile.gcount();
+      if (probe_size < read_count)
+      {
+        throw std::invalid_argument("Error: Bad file - WAVE file has no data subchunk!");
+      }
+    }
+    return &probe[offset - probe_pos];
+  });
+}
+
+void WavHeader::read_riff(const uint8_t* byte_file, size_t byte_count)
+{
+  if (byte_count < 44)
   {
     throw std::invalid_argument("Error: Bad file - File is too small!");
   }
 
-  uint32_t offset = 0;
   chunk_ID   = _4x8_to_32_be(byte_file, 0);
   chunk_size = _4x8_to_32_le(byte_file, 4);
   format     = _4x8_to_32_be(byte_file, 8);
+}
 
-  subchunk1_ID    = _4x8_to_32_be(byte_file, 12);
-  subchunk1_size  = _4x8_to_32_le(byte_file, 16);
-  audio_format    = _2x8_to_16_le(byte_file, 20);
-  num_of_channels = _2x8_to_16_le(byte_file, 22);
-  samples_per_sec = _4x8_to_32_le(byte_file, 24);
-  bytes_per_sec   = _4x8_to_32_le(byte_file, 28);
-  block_align     = _2x8_to_16_le(byte_file, 32);
-  bits_per_sample = _2x8_to_16_le(byte_file, 34);
-  offset = 36;
-
-  if (audio_format != format::WAVE_FORMAT_PCM)
+template <typename F>
+void WavHeader::find_data(F read_bytes)
+{
+  uint64_t offset = 12;
+  uint32_t next_subchunk_ID = 0;
+  uint64_t next_subchunk_size = 0, rf64_data_size = 0;
+  // Subchunk header must fit in the RIFF chunk, which ends at chunk_size + 8; an empty "data" subchunk can end it
+  while (next_subchunk_ID != id::data && offset + 8 <= chunk_size + 8)
   {
-    extension_size = _2x8_to_16_le(byte_file, (size_t)offset);
-    if (audio_format == format::WAVE_FORMAT_EXTENSIBLE)
+    const uint8_t* chunk_header = read_bytes(offset, 8);
+    next_subchunk_ID = _4x8_to_32_be(chunk_header, 0);
+    next_subchunk_size = _4x8_to_32_le(chunk_header, 4);
+
+    if (next_subchunk_ID == id::ds64 && is_rf64() && next_subchunk_size >= 24)
     {
-      subformat = _2x8_to_16_le(byte_file, (size_t)offset + 8);
+      const uint8_t* ds64_bytes = read_bytes(offset + 8, 24);
+      chunk_size = _8x8_to_64_le(ds64_bytes, 0);
+      rf64_data_size = _8x8_to_64_le(ds64_bytes, 8);
+    }
+    else if (next_subchunk_ID == id::fmt && subchunk1_ID != id::fmt)
+    {
+      subchunk1_ID = next_subchunk_ID;
+      subchunk1_size = next_subchunk_size;
+      size_t fmt_size = std::min<uint64_t>(next_subchunk_size, 40);
+      read_format(read_bytes(offset + 8, fmt_size), fmt_size);
     }
-    offset += extension_size + 2;
-  }
 
-  uint32_t next_subchunk_ID = 0, next_subchunk_size = 0;
-  while (next_subchunk_ID != id::data && offset < chunk_size)
-  {
-    next_subchunk_ID = _4x8_to_32_be(byte_file, offset);
-    next_subchunk_size = _4x8_to_32_le(byte_file, offset + 4);
-    
     offset += 8;
     data_offset = offset;
     offset += next_subchunk_size + next_subchunk_size % 2;
   }
-   
+
   subchunk2_ID = next_subchunk_ID;
   subchunk2_size = next_subchunk_size;
+  if (is_rf64() && subchunk2_size == 0xFFFFFFFF)
+  {
+    subchunk2_size = rf64_data_size;
+  }
 
   if (!check_validity())
   {
@@ -92,11 +188,39 @@ WavHeader::WavHeader(const std::vector<uint8_t> &byte_file)
   }
 }
 
-WavHeader::WavHeader(const char* file_path) : WavHeader(readfile(file_path)) {}
+void WavHeader::read_format(const uint8_t* fmt_bytes, size_t byte_count)
+{
+  if (byte_count < 16)
+  {
+    return;
+  }
+
+  audio_format    = _2x8_to_16_le(fmt_bytes, 0);
+  num_of_channels = _2x8_to_16_le(fmt_bytes, 2);
+  samples_per_sec = _4x8_to_32_le(fmt_bytes, 4);
+  bytes_per_sec   = _4x8_to_32_le(fmt_bytes, 8);
+  block_align     = _2x8_to_16_le(fmt_bytes, 12);
+  bits_per_sample = _2x8_to_16_le(fmt_bytes, 14);
+
+  if (audio_format != format::WAVE_FORMAT_PCM && byte_count >= 18)
+  {
+    extension_size = _2x8_to_16_le(fmt_bytes, 16);
+    if (audio_format == format::WAVE_FORMAT_EXTENSIBLE && byte_count >= 26)
+    {
+      channel_mask = _4x8_to_32_le(fmt_bytes, 20);
+      subformat = _2x8_to_16_le(fmt_bytes, 24);
+    }
+  }
+}
 
 bool WavHeader::check_validity()
 {
-  if (chunk_ID != id::RIFF || format != id::WAVE || subchunk1_ID != id::fmt || subchunk2_ID != id::data)
+  if ((chunk_ID != id::RIFF && !is_rf64()) || format != id::WAVE || subchunk1_ID != id::fmt || subchunk2_ID != id::data)
+  {
+    return false;
+  }
+
+  if (num_of_channels == 0 || block_align == 0 || bytes_per_sec == 0)
   {
     return false;
   }
@@ -119,6 +243,11 @@ bool WavHeader::check_validity()
   return true;
 }
 
+bool WavHeader::is_rf64()
+{
+  return chunk_ID == id::RF64 || chunk_ID == id::BW64;
+}
+
 uint16_t WavHeader::get_audio_format()
 {
   if (audio_format != format::WAVE_FORMAT_EXTENSIBLE)
@@ -133,6 +262,11 @@ uint16_t WavHeader::get_num_of_channels()
  return num_of_channels; 
 }
 
+uint32_t WavHeader::get_channel_mask()
+{
+  return channel_mask;
+}
+
 uint32_t WavHeader::get_frequency()
 {
   return samples_per_sec;
@@ -170,22 +304,28 @@ uint32_t WavHeader::get_bits_per_sec()
   return bytes_per_sec * 8;
 }
 
-uint32_t WavHeader::get_length_ms()
+// Whole frames are counted first, so the length does not depend on a rounded bytes_per_sec field
+uint64_t WavHeader::get_length_ms()
 {
-  return subchunk2_size * 1000 / bytes_per_sec; 
+  if (samples_per_sec == 0)
+  {
+    return 0;
+  }
+  uint64_t frame_count = subchunk2_size / block_align;
+  return frame_count / samples_per_sec * 1000 + frame_count % samples_per_sec * 1000 / samples_per_sec;
 }
 
-uint32_t WavHeader::get_data_offset()
+uint64_t WavHeader::get_data_offset()
 {
   return data_offset; 
 }
 
-uint32_t WavHeader::get_data_size()
+uint64_t WavHeader::get_data_size()
 {
   return subchunk2_size; 
 }
 
-uint32_t WavHeader::get_file_size()
+uint64_t WavHeader::get_file_size()
 {
   return chunk_size + 8;
 }
@@ -208,8 +348,83 @@ std::string WavHeader::to_string()
       << "Number of bits per sample: "  << bits_per_sample << "\n" 
       << "Size of extension for non-PCM formats: "
                                         << extension_size  << "\n" 
+      << "Channel mask of extensible format: "
+                                        << channel_mask    << "\n"
       << "Audio subformat of extensible format: "
                                         << subformat       << "\n"
       << "Sampled data length: "        << subchunk2_size;
   return str.str(); 
 }
+
+void set_wav_sizes(std::vector<uint8_t>& header_bytes, uint64_t data_size, uint64_t file_size)
+{
+  WavHeader header = WavHeader(header_bytes);
+  uint8_t* bytes = header_bytes.data();
+  size_t data_size_pos = header_bytes.size() - 4;
+
+  if (!header.is_rf64() && file_size - 8 <= 0xFFFFFFFF && data_size <= 0xFFFFFFFF)
+  {
+    _64_to_8x8_le(bytes, 4, file_size - 8, 4);
+    _64_to_8x8_le(bytes, data_size_pos, data_size, 4);
+    return;
+  }
+
+  if (!has_ds64_place(header_bytes))
+  {
+    throw std::length_error("Error: WAVE file is larger than 4 GB, but its header has no place for RF64 sizes!");
+  }
+  if (!header.is_rf64())
+  {
+    _32_to_4x8_be(bytes, 0, id::RF64);
+    _32_to_4x8_be(bytes, 12, id::ds64);
+  }
+  _64_to_8x8_le(bytes, 4, 0xFFFFFFFF, 4);
+  _64_to_8x8_le(bytes, data_size_pos, 0xFFFFFFFF, 4);
+  _64_to_8x8_le(bytes, 20, file_size - 8, 8);
+  _64_to_8x8_le(bytes, 28, data_size, 8);
+  _64_to_8x8_le(bytes, 36, data_size / header.get_block_align(), 8);
+}
+
+void reserve_rf64(std::vector<uint8_t>& header_bytes)
+{
+  if (has_ds64_place(header_bytes))
+  {
+    return;
+  }
+
+  std::vector<uint8_t> junk(8 + DS64_SIZE, 0);
+  _32_to_4x8_be(junk.data(), 0, id::JUNK);
+  junk[4] = DS64_SIZE;
+  header_bytes.insert(header_bytes.begin() + 12, junk.begin(), junk.end());
+}
+
+std::vector<uint8_t> make_wav_header(uint16_t audio_format, uint16_t num_of_channels, uint32_t frequency,
+                                     uint16_t bit_depth, uint64_t data_size)
+{
+  uint16_t block_align = num_of_channels * ((bit_depth + 7) / 8);
+  std::vector<uint8_t> header_bytes(44, 0);
+  uint8_t* bytes = header_bytes.data();
+
+  _32_to_4x8_be(bytes, 0, id::RIFF);
+  _32_to_4x8_be(bytes, 8, id::WAVE);
+  _32_to_4x8_be(bytes, 12, id::fmt);
+  _64_to_8x8_le(bytes, 16, 16, 4);
+  _64_to_8x8_le(bytes, 20, audio_format, 2);
+  _64_to_8x8_le(bytes, 22, num_of_channels, 2);
+  _64_to_8x8_le(bytes, 24, frequency, 4);
+  _64_to_8x8_le(bytes, 28, (uint64_t)frequency * block_align, 4);
+  _64_to_8x8_le(bytes, 32, block_align, 2);
+  _64_to_8x8_le(bytes, 34, bit_depth, 2);
+  _32_to_4x8_be(bytes, 36, id::data);
+  // Sizes are written after the check, till then the RIFF chunk just covers the "data" subchunk header
+  _64_to_8x8_le(bytes, 4, header_bytes.size(), 4);
+
+  // Header of invalid format does not parse
+  WavHeader{ header_bytes };
+  if (data_size > 0xFFFFFFFF - header_bytes.size())
+  {
+    reserve_rf64(header_bytes);
+  }
+  set_wav_sizes(header_bytes, data_size, header_bytes.size() + data_size);
+  return header_bytes;
+}
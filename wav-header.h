@@ -5,6 +5,9 @@
 #include <cstdint>
 #include <vector>
 
+// Number of bytes read at once while probing WAVE header of a file.
+const size_t HEADER_PROBE_BYTES = 4096;
+
 namespace format
 {
   const uint16_t WAVE_FORMAT_PCM        = 0x0001;
@@ -12,55 +15,111 @@ namespace format
   const uint16_t WAVE_FORMAT_EXTENSIBLE = 0xFFFE;
 }
 
+// Speaker positions in the channel mask of WAVE_FORMAT_EXTENSIBLE, see WavHeader::get_channel_mask().
+namespace speaker
+{
+  const uint32_t LOW_FREQUENCY = 0x8;
+  const uint32_t BACK_LEFT     = 0x10;
+  const uint32_t BACK_RIGHT    = 0x20;
+  const uint32_t SIDE_LEFT     = 0x200;
+  const uint32_t SIDE_RIGHT    = 0x400;
+}
+
 // Can work incorrectly with GSM 6.10 or other such compressed formats
 // If format doesn't use bits_per_sample, can't calculate bit depth
 //
+// Files larger than 4 GB are RF64 (EBU Tech 3306) or BW64 (ITU-R BS.2088) files.
+// Their RIFF and data chunk sizes are 0xFFFFFFFF, and the real 64-bit sizes are in "ds64" subchunk,
+// which is the first subchunk after "WAVE".
+//
 // Throws std::invalid_argument exception if file is too small to contain WAVE header 
 // Throws std::invalid_argument exception if file contains invalid WAVE header 
+// Throws std::out_of_range exception if byte_file ends before the "data" subchunk header
 //
-// The file_path constructor:
-// Throws std::invalid_argument exception if file_path does not exist
+// The file_path constructor reads only the header: the first HEADER_PROBE_BYTES of the file,
+// and one more probe for every subchunk header beyond them, skipping subchunk contents with seeks.
+// Throws std::invalid_argument exception if file_path does not exist or has no "data" subchunk
 // Throws std::runtime_error if error while reading file
 class WavHeader
 {
 private:
   /* The "RIFF" chunk descriptor */
-  uint32_t chunk_ID;            // RIFF Header Magic header
-  uint32_t chunk_size;          // RIFF Chunk Size
+  uint32_t chunk_ID;            // RIFF Header Magic header, "RF64" or "BW64" for 64-bit files
+  uint64_t chunk_size;          // RIFF Chunk Size, from "ds64" subchunk for 64-bit files
   uint32_t format;              // "WAVE" string
   /* The "fmt " sub-chunk */
-  uint32_t subchunk1_ID;        // "fmt " string
-  uint32_t subchunk1_size;      // Size of the fmt chunk
-  uint16_t audio_format;        // Audio format 1=PCM, 6=mulaw, 7=alaw, 257=IBM Mu-Law, 258=IBM A-Law, 259=ADPCM
-  uint16_t num_of_channels;     // Number of channels 1=Mono 2=Sterio
-  uint32_t samples_per_sec;     // Sampling Frequency in Hz
-  uint32_t bytes_per_sec;       // Bytes per second
-  uint16_t block_align;         // Bytes per block of samples (sample size * num of channels)
-  uint16_t bits_per_sample;     // Number of bits per sample
+  uint32_t subchunk1_ID = 0;    // "fmt " string
+  uint32_t subchunk1_size = 0;  // Size of the fmt chunk
+  uint16_t audio_format = 0;    // Audio format 1=PCM, 6=mulaw, 7=alaw, 257=IBM Mu-Law, 258=IBM A-Law, 259=ADPCM
+  uint16_t num_of_channels = 0; // Number of channels 1=Mono 2=Sterio
+  uint32_t samples_per_sec = 0; // Sampling Frequency in Hz
+  uint32_t bytes_per_sec = 0;   // Bytes per second
+  uint16_t block_align = 0;     // Bytes per block of samples (sample size * num of channels)
+  uint16_t bits_per_sample = 0; // Number of bits per sample
   uint16_t extension_size = 0;  // Size of extension for non-PCM formats
+  uint32_t channel_mask = 0;    // Speaker positions of WAVE_FORMAT_EXTENSIBLE channels
   uint16_t subformat = 0;       // Audio subformat of WAVE_FORMAT_EXTENSIBLE
   /* The "data" sub-chunk */
   uint32_t subchunk2_ID;        // "data" string
-  uint32_t subchunk2_size;      // Sampled data length
+  uint64_t subchunk2_size;      // Sampled data length, from "ds64" subchunk for 64-bit files
   /* Offset off the data chunk */
-  uint32_t data_offset;
+  uint64_t data_offset;
+
+  // Reads RIFF chunk descriptor from the first bytes of the file.
+  void read_riff(const uint8_t* byte_file, size_t byte_count);
+
+  // Walks subchunks till the "data" subchunk reading "ds64" and "fmt " subchunks on the way,
+  // then checks the header. read_bytes(offset, byte_count) returns pointer to byte_count bytes at offset.
+  template <typename F>
+  void find_data(F read_bytes);
+
+  // Reads fields of "fmt " subchunk contents.
+  void read_format(const uint8_t* fmt_bytes, size_t byte_count);
 
 public:
   WavHeader(const std::vector<uint8_t> &byte_file);
+  WavHeader(const uint8_t* byte_file, size_t byte_count);
   WavHeader(const char* file_path);
   bool check_validity();
+
+  // Returns true for RF64 and BW64 files, which keep chunk sizes in the "ds64" subchunk.
+  bool is_rf64();
   uint16_t get_audio_format();
   uint16_t get_num_of_channels();
+
+  // Speaker positions of WAVE_FORMAT_EXTENSIBLE file, see speaker namespace, or 0 if the file has none.
+  // Channels take the set bits from the lowest one, channels beyond them have no position.
+  uint32_t get_channel_mask();
   uint32_t get_frequency();
   uint16_t get_bit_depth();
   std::string get_sample_type();
   uint32_t get_bits_per_sec();
-  uint32_t get_length_ms();
-  uint32_t get_data_offset();
-  uint32_t get_data_size();
-  uint32_t get_file_size();
+  uint64_t get_length_ms();
+  uint64_t get_data_offset();
+  uint64_t get_data_size();
+  uint64_t get_file_size();
   uint16_t get_block_align();
   std::string to_string();
 };
 
+// Functions below change WAVE header bytes: the bytes of file before data chunk samples.
+
+// Writes data chunk size and RIFF chunk size for data_size bytes of data in file of file_size bytes.
+// RIFF file larger than 4 GB is promoted to RF64, if its first subchunk is "ds64" or "JUNK"
+// with place for "ds64" contents. RF64 and BW64 files keep their format.
+//
+// Throws std::invalid_argument exception if header_bytes contain invalid WAVE header
+// Throws std::length_error exception if the file is larger than 4 GB and can't be promoted to RF64
+void set_wav_sizes(std::vector<uint8_t>& header_bytes, uint64_t data_size, uint64_t file_size);
+
+// Inserts "JUNK" subchunk after "WAVE" to make place for "ds64" subchunk, unless there is already such place.
+// Shifts the rest of the header, so it must be done before the header is written.
+void reserve_rf64(std::vector<uint8_t>& header_bytes);
+
+// Makes header bytes of WAVE file with data_size bytes of samples of the format: "RIFF" chunk descriptor,
+// 16-byte "fmt " subchunk and "data" subchunk header. Header of data larger than 4 GB is RF64.
+// Throws std::invalid_argument exception if the format is invalid, e.g. it has no channels
+std::vector<uint8_t> make_wav_header(uint16_t audio_format, uint16_t num_of_channels, uint32_t frequency,
+                                     uint16_t bit_depth, uint64_t data_size);
+
 #endif
@@ -0,0 +1,280 @@
+#include "wav-stream.h"
+#include "readfile.h"
+#include "stage-stats.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+/* Support functions */
+
+// Reads the file bytes before data chunk samples.
+// The header is probed first, so only the bytes before data are read.
+std::vector<uint8_t> read_header_bytes(const char* file_path);
+
+// Size of subchunks after data that fits into a RIFF file without RF64 reservation.
+const uint64_t TRAILER_RESERVE_BYTES = 1 << 24;
+
+// End of the sizes in RIFF descriptor and "ds64" subchunk.
+const size_t RF64_SIZES_END = 44;
+
+
+/* WavReader implementation */
+
+WavReader::WavReader(const char* file_path)
+  : file_path(file_path), infile(file_path), header_bytes(read_header_bytes(file_path)), header(header_bytes)
+{
+  select_frames(0, header.get_data_size() / header.get_block_align());
+}
+
+WavHeader& WavReader::get_header()
+{
+  return header;
+}
+
+const char* WavReader::get_file_path()
+{
+  return file_path.c_str();
+}
+
+const std::vector<uint8_t>& WavReader::get_header_bytes()
+{
+  return header_bytes;
+}
+
+void WavReader::select_frames(uint64_t first_frame, uint64_t end_frame)
+{
+  if (first_frame > end_frame || end_frame > header.get_data_size() / header.get_block_align())
+  {
+    throw std::invalid_argument("Error: Selected frames are not in data range!");
+  }
+
+  drop_read_ahead();
+  frame_pos = first_frame;
+  frame_end = end_frame;
+  ahead_pos = first_frame;
+}
+
+// Read time is the time the caller waits for the block, reads done meanwhile are not counted.
+size_t WavReader::read_frames(std::vector<uint8_t>& block, size_t max_frame_count)
+{
+  if (frame_pos == frame_end || max_frame_count == 0)
+  {
+    return 0;
+  }
+
+  stats::StageTimer read_timer(stats::READ);
+  if (max_frame_count != ahead_frame_count)
+  {
+    drop_read_ahead();
+    ahead_frame_count = max_frame_count;
+  }
+  read_ahead();
+
+  // The block is taken from the queue first, so it is not waited for again if the read failed
+  AheadBlock next = std::move(ahead_blocks.front());
+  ahead_blocks.pop_front();
+  spare_blocks.push_back(std::move(block));
+  block = std::move(next.bytes);
+  io->wait();
+  read_ahead();
+
+  frame_pos += next.frame_count;
+  read_timer.stop(next.frame_count * header.get_block_align(), next.frame_count);
+  return next.frame_count;
+}
+
+void WavReader::read_ahead()
+{
+  if (!io)
+  {
+    io = make_io_queue(READ_AHEAD_BLOCKS);
+  }
+
+  size_t block_size = header.get_block_align();
+  while (ahead_blocks.size() < READ_AHEAD_BLOCKS && ahead_pos < frame_end)
+  {
+    AheadBlock ahead;
+    ahead.frame_count = std::min<uint64_t>(ahead_frame_count, frame_end - ahead_pos);
+    if (!spare_blocks.empty())
+    {
+      ahead.bytes = std::move(spare_blocks.back());
+      spare_blocks.pop_back();
+    }
+    ahead.bytes.resize(ahead.frame_count * block_size);
+    ahead_blocks.push_back(std::move(ahead));
+
+    io->submit_read(infile, header.get_data_offset() + ahead_pos * block_size, &ahead_blocks.back().bytes[0],
+                    ahead_blocks.back().bytes.size());
+    ahead_pos += ahead_blocks.back().frame_count;
+  }
+}
+
+// Errors of dropped reads don't matter, their frames are read again if needed.
+void WavReader::drop_read_ahead()
+{
+  while (io && io->get_pending_count() > 0)
+  {
+    try
+    {
+      io->wait();
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+  }
+  while (!ahead_blocks.empty())
+  {
+    spare_blocks.push_back(std::move(ahead_blocks.front().bytes));
+    ahead_blocks.pop_front();
+  }
+  ahead_pos = frame_pos;
+}
+
+std::vector<uint8_t> WavReader::read_trailer()
+{
+  drop_read_ahead();
+  uint64_t data_size = header.get_data_size();
+  uint64_t trailer_pos = header.get_data_offset() + data_size + data_size % 2;
+  uint64_t file_end = infile.get_size();
+
+  std::vector<uint8_t> trailer;
+  if (trailer_pos < file_end)
+  {
+    trailer.resize(file_end - trailer_pos);
+    infile.read_at(trailer_pos, &trailer[0], trailer.size());
+  }
+  return trailer;
+}
+
+
+/* WavWriter implementation */
+
+WavWriter::WavWriter(const char* file_path, const std::vector<uint8_t>& header_bytes, const char* replaced_path)
+  : outfile(file_path, replaced_path), header_bytes(header_bytes)
+{
+}
+
+void WavWriter::expect_data_size(uint64_t byte_count)
+{
+  if (!header_written && header_bytes.size() + byte_count + TRAILER_RESERVE_BYTES > 0xFFFFFFFF)
+  {
+    reserve_rf64(header_bytes);
+  }
+  outfile.preallocate(header_bytes.size() + byte_count + byte_count % 2);
+}
+
+void WavWriter::write(const uint8_t* bytes, size_t byte_count)
+{
+  std::vector<uint8_t> block;
+  if (!spare_blocks.empty())
+  {
+    block = std::move(spare_blocks.back());
+    spare_blocks.pop_back();
+  }
+  block.assign(bytes, bytes + byte_count);
+  write_block(block, byte_count);
+  spare_blocks.push_back(std::move(block));
+}
+
+// Write time is the time the caller waits for the writes to be started or to be over.
+void WavWriter::write_block(std::vector<uint8_t>& block, size_t byte_count)
+{
+  stats::StageTimer write_timer(stats::WRITE);
+  uint64_t header_size = header_written ? 0 : header_bytes.size();
+  write_header();
+  if (byte_count > 0)
+  {
+    if (!io)
+    {
+      io = make_io_queue(WRITE_BEHIND_BLOCKS);
+    }
+    if (behind_blocks.size() == WRITE_BEHIND_BLOCKS)
+    {
+      spare_blocks.push_back(std::move(behind_blocks.front()));
+      behind_blocks.pop_front();
+      io->wait();
+    }
+
+    behind_blocks.push_back(std::move(block));
+    io->submit_write(outfile, header_bytes.size() + data_size, &behind_blocks.back()[0], byte_count);
+    data_size += byte_count;
+
+    block.clear();
+    if (!spare_blocks.empty())
+    {
+      block = std::move(spare_blocks.back());
+      spare_blocks.pop_back();
+    }
+  }
+  write_timer.stop(header_size + byte_count);
+}
+
+void WavWriter::write_header()
+{
+  if (!header_written)
+  {
+    outfile.write(&header_bytes[0], header_bytes.size());
+    header_written = true;
+  }
+}
+
+void WavWriter::wait_writes()
+{
+  while (!behind_blocks.empty())
+  {
+    spare_blocks.push_back(std::move(behind_blocks.front()));
+    behind_blocks.pop_front();
+    io->wait();
+  }
+}
+
+void WavWriter::copy_data(const char* in_path, uint64_t in_pos, uint64_t byte_count)
+{
+  stats::StageTimer write_timer(stats::WRITE);
+  wait_writes();
+  write_header();
+  // Blocks are written at their positions, the copy goes to the current position of the file
+  outfile.seek(header_bytes.size() + data_size);
+  outfile.copy_from_file(in_path, in_pos, byte_count);
+  data_size += byte_count;
+  write_timer.stop(byte_count);
+}
+
+void WavWriter::finish(const std::vector<uint8_t>& trailer)
+{
+  stats::StageTimer write_timer(stats::WRITE);
+  wait_writes();
+  uint64_t file_size = header_bytes.size() + data_size + data_size % 2 + trailer.size();
+  // Changing RIFF Chunk Size and Data Subchunk Size
+  set_wav_sizes(header_bytes, data_size, file_size);
+
+  // Pad byte and trailer go after the data, which may have been written at positions
+  std::vector<uint8_t> end_bytes(data_size % 2, 0);
+  end_bytes.insert(end_bytes.end(), trailer.begin(), trailer.end());
+  if (!end_bytes.empty())
+  {
+    outfile.write_at(header_bytes.size() + data_size, &end_bytes[0], end_bytes.size());
+  }
+  // Sizes are only in the RIFF descriptor, the "ds64" subchunk after it and the data subchunk header
+  size_t header_size = header_written ? 0 : header_bytes.size();
+  if (header_written)
+  {
+    outfile.write_at(0, &header_bytes[0], std::min<size_t>(header_bytes.size(), RF64_SIZES_END));
+    outfile.write_at(header_bytes.size() - 4, &header_bytes[header_bytes.size() - 4], 4);
+  }
+  write_header();
+
+  outfile.sync();
+  outfile.close();
+  write_timer.stop(header_size + end_bytes.size());
+}
+
+
+/* Support functions implementation */
+
+std::vector<uint8_t> read_header_bytes(const char* file_path)
+{
+  WavHeader header = WavHeader(file_path);
+  return readfile(file_path, header.get_data_offset());
+}
@@ -0,0 +1,133 @@
+#ifndef WAVSTREAM_H
+#define WAVSTREAM_H
+
+#include "wav-header.h"
+#include "readfile.h"
+#include "writefile.h"
+#include "io-queue.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Size of one streaming block in bytes.
+// Blocks are rounded down to whole frames, so memory use does not depend on file length.
+const size_t STREAM_BLOCK_BYTES = 1 << 20;
+
+// Number of blocks read ahead of the block being processed and written behind it.
+// With one block of each kind in flight the disk reads, the CPU processes and the disk writes at the same time,
+// the second one covers uneven times of the blocks.
+const size_t READ_AHEAD_BLOCKS = 2;
+const size_t WRITE_BEHIND_BLOCKS = 2;
+
+// Sequential reader of WAVE data chunk.
+// Reads the header on construction, then returns data frames block by block.
+// The next blocks are read ahead in the background (see IoQueue) while the caller processes the current one.
+//
+// Throws std::invalid_argument exception if file_path does not exist or contains invalid WAVE header
+// Throws std::runtime_error if error while reading file
+class WavReader
+{
+private:
+  // Block read ahead with the number of its frames
+  struct AheadBlock
+  {
+    std::vector<uint8_t> bytes;
+    size_t frame_count;
+  };
+
+  std::string file_path;
+  InputFile infile;
+  std::vector<uint8_t> header_bytes;
+  WavHeader header;
+  uint64_t frame_pos = 0, frame_end = 0;
+
+  std::deque<AheadBlock> ahead_blocks;         // blocks being read after frame_pos, oldest first
+  std::vector<std::vector<uint8_t>> spare_blocks;
+  uint64_t ahead_pos = 0;                      // first frame not requested yet
+  size_t ahead_frame_count = 0;                // frames of every block read ahead
+  std::unique_ptr<IoQueue> io;                 // destroyed first, so reads are over before blocks are freed
+
+  // Starts reads of the next blocks until READ_AHEAD_BLOCKS are in flight or the selected frames are over.
+  void read_ahead();
+
+  // Waits for the blocks read ahead and drops them.
+  void drop_read_ahead();
+
+public:
+  WavReader(const char* file_path);
+  WavHeader& get_header();
+  const char* get_file_path();
+
+  // Bytes of the file before data chunk samples: RIFF header, "fmt " and other subchunks.
+  const std::vector<uint8_t>& get_header_bytes();
+
+  // Limits reading to frames [first_frame, end_frame) of the data chunk.
+  // Throws std::invalid_argument exception if the range is not inside the data chunk.
+  void select_frames(uint64_t first_frame, uint64_t end_frame);
+
+  // Reads up to max_frame_count frames into block, which is resized to the frames read.
+  // The block is swapped with a block read ahead, so its old bytes are not kept, and reads of the next
+  // blocks of max_frame_count frames are started. Keep max_frame_count the same for all calls:
+  // when it changes, the blocks read ahead are dropped and read again.
+  // Returns number of frames read, 0 when selected frames are over.
+  size_t read_frames(std::vector<uint8_t>& block, size_t max_frame_count);
+
+  // Reads all subchunks after the data chunk (and its pad byte) till the end of file.
+  std::vector<uint8_t> read_trailer();
+};
+
+// Sequential writer of WAVE file.
+// Writes header_bytes as they are, then data bytes, then fixes RIFF and data sizes on finish().
+// Data blocks are written behind in the background (see IoQueue) while the caller processes the next ones.
+// Output larger than 4 GB is written as RF64, see set_wav_sizes().
+//
+// Throws std::runtime_error if file could not be opened or written
+class WavWriter
+{
+private:
+  OutputFile outfile;
+  std::vector<uint8_t> header_bytes;
+  bool header_written = false;
+  uint64_t data_size = 0;
+
+  std::deque<std::vector<uint8_t>> behind_blocks;  // blocks being written, oldest first
+  std::vector<std::vector<uint8_t>> spare_blocks;
+  std::unique_ptr<IoQueue> io;                     // destroyed first, so writes are over before blocks are freed
+
+  void write_header();
+
+  // Waits for the blocks written behind.
+  void wait_writes();
+
+public:
+  // If replaced_path is set, file_path is a temporary file that will replace it, see OutputFile.
+  WavWriter(const char* file_path, const std::vector<uint8_t>& header_bytes, const char* replaced_path = nullptr);
+
+  // Tells the upper bound of data size before the first write.
+  // If the file can get larger than 4 GB, place for RF64 sizes is reserved in the header.
+  // Disk space for the header and data is preallocated, see OutputFile::preallocate().
+  void expect_data_size(uint64_t byte_count);
+
+  // Appends byte_count bytes to the data chunk. The bytes are copied, so they can be changed right away.
+  void write(const uint8_t* bytes, size_t byte_count);
+
+  // Appends the first byte_count bytes of block to the data chunk without copying them:
+  // the block is taken by the writer and swapped with a block whose write is over,
+  // so its bytes can be reused, e.g. by WavReader::read_frames().
+  void write_block(std::vector<uint8_t>& block, size_t byte_count);
+
+  // Appends byte_count bytes from in_pos of file in_path to the data chunk without reading them into memory.
+  // Blocks written behind are waited for first.
+  void copy_data(const char* in_path, uint64_t in_pos, uint64_t byte_count);
+
+  // Waits for the blocks written behind, writes pad byte if needed and trailer subchunks,
+  // then updates RIFF and data chunk sizes.
+  // The file is synced to the disk before it is closed, so it is complete once finish() returns.
+  void finish(const std::vector<uint8_t>& trailer);
+};
+
+#endif
@@ -0,0 +1,276 @@
+#include "wavedit.h"
+#include "sound-effects.h"
+#include "mapped-file.h"
+#include "readfile.h"
+#include "writefile.h"
+#include "stage-stats.h"
+
+#include <string>
+#include <cstdio>
+#include <stdexcept>
+
+/* Support functions */
+
+// Makes WAVE header bytes that describe frames of format.
+std::vector<uint8_t> frames_header(wavedit::Frames frames, const wavedit::Format& format);
+
+// Applies effect to the input file of reader and writes the result with writer.
+// The effect function is selected based on options type.
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, TrimOptions& options);
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, FadeOptions& options);
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, NormalizeOptions& options);
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, ReverbOptions& options);
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, FreeverbOptions& options);
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, ChainOptions& options);
+
+// Applies effect to the input file in place, if the effect keeps the file size.
+// Returns false if the effect can't be applied in place.
+bool effect_in_place(TrimOptions& options, std::vector<uint64_t>& clip_counts);
+bool effect_in_place(FadeOptions& options, std::vector<uint64_t>& clip_counts);
+bool effect_in_place(NormalizeOptions& options, std::vector<uint64_t>& clip_counts);
+bool effect_in_place(ReverbOptions& options, std::vector<uint64_t>& clip_counts);
+bool effect_in_place(FreeverbOptions& options, std::vector<uint64_t>& clip_counts);
+bool effect_in_place(ChainOptions& options, std::vector<uint64_t>& clip_counts);
+
+
+/* Library functions implementation */
+
+wavedit::Format::Format(uint16_t audio_format, uint16_t num_of_channels, uint32_t frequency, uint16_t bit_depth)
+  : audio_format(audio_format), num_of_channels(num_of_channels), frequency(frequency), bit_depth(bit_depth)
+{
+}
+
+wavedit::Format::Format(WavHeader& header)
+  : audio_format(header.get_audio_format()), num_of_channels(header.get_num_of_channels()),
+    frequency(header.get_frequency()), bit_depth(header.get_block_align() / header.get_num_of_channels() * 8)
+{
+}
+
+uint16_t wavedit::Format::get_block_align() const
+{
+  return num_of_channels * ((bit_depth + 7) / 8);
+}
+
+Analysis wavedit::analyze(Frames frames, const Format& format, AnalyzeOptions& options)
+{
+  return effects::analyze(frames_header(frames, format), frames.data, options);
+}
+
+Analysis wavedit::analyze(WavReader& reader, AnalyzeOptions& options)
+{
+  return effects::analyze(reader, options);
+}
+
+std::vector<uint8_t> wavedit::peaks(Frames frames, const Format& format, PeaksOptions& options)
+{
+  return effects::peaks(frames_header(frames, format), frames.data, options);
+}
+
+uint64_t wavedit::peaks_file(PeaksOptions& options, WavReader& reader, const char* outfile_path)
+{
+  std::vector<uint8_t> bytes = effects::peaks(reader, options);
+
+  std::string target_path = resolve_path(outfile_path);
+  std::string temp_path = temp_file_path(target_path.c_str());
+  try
+  {
+    stats::StageTimer write_timer(stats::WRITE);
+    OutputFile file(temp_path.c_str(), target_path.c_str());
+    file.write(bytes.data(), bytes.size());
+    file.sync();
+    file.close();
+    write_timer.stop(bytes.size());
+  }
+  catch (...)
+  {
+    std::remove(temp_path.c_str());
+    throw;
+  }
+
+  replace_file(temp_path.c_str(), target_path.c_str());
+  return bytes.size();
+}
+
+wavedit::Frames wavedit::trim(Frames frames, const Format& format, TrimOptions& options)
+{
+  WavHeader header = WavHeader(frames_header(frames, format));
+  uint64_t first_frame, end_frame;
+  effects::trim_range(header, options, first_frame, end_frame);
+  return Frames(frames.data + (size_t)first_frame * format.get_block_align(), end_frame - first_frame);
+}
+
+std::vector<uint64_t> wavedit::fade(Frames frames, const Format& format, FadeOptions& options)
+{
+  return effects::fade(frames_header(frames, format), frames.data, options);
+}
+
+std::vector<uint64_t> wavedit::normalize(Frames frames, const Format& format, NormalizeOptions& options)
+{
+  return effects::normalize(frames_header(frames, format), frames.data, options);
+}
+
+std::vector<uint64_t> wavedit::reverb(Frames frames, const Format& format, ReverbOptions& options)
+{
+  return effects::reverb(frames_header(frames, format), frames.data, options);
+}
+
+std::vector<uint64_t> wavedit::freeverb(Frames frames, const Format& format, FreeverbOptions& options)
+{
+  return effects::freeverb(frames_header(frames, format), frames.data, options);
+}
+
+wavedit::Frames wavedit::chain(Frames frames, const Format& format, ChainOptions& options,
+                               std::vector<uint64_t>& clip_counts)
+{
+  uint64_t first_frame, frame_count;
+  clip_counts = effects::chain(frames_header(frames, format), frames.data, options, first_frame, frame_count);
+  return Frames(frames.data + (size_t)first_frame * format.get_block_align(), frame_count);
+}
+
+template <typename O>
+bool wavedit::edit_file(O& options, WavReader& reader, const char* outfile_path, std::vector<uint64_t>& clip_counts,
+                        bool allow_in_place)
+{
+  // Effects that only change sample values can edit the mapped input file directly
+  if (allow_in_place && same_file(options.infile_path, outfile_path) && effect_in_place(options, clip_counts))
+  {
+    return true;
+  }
+
+  // Without the temporary file the output can't be replaced safely, so it is not written at all
+  std::string target_path = resolve_path(outfile_path);
+  if (!directory_writable(target_path.c_str()))
+  {
+    throw std::runtime_error("Error: Directory of '" + std::string(outfile_path) +
+                             "' does not allow creating a temporary file for the output. "
+                             "Edit the file in place (--in-place) or write the output to another directory.");
+  }
+
+  // The input is still being read while the output is written, and the output must stay whole on a crash,
+  // so the result goes to a temporary file that replaces the output at the end.
+  // Links to the output are resolved, so the file they point to is replaced and keeps its permissions and owner
+  std::string temp_path = temp_file_path(target_path.c_str());
+  try
+  {
+    WavWriter writer(temp_path.c_str(), reader.get_header_bytes(), target_path.c_str());
+
+    // Effect function is selected based on options type
+    clip_counts = effect(reader, writer, options);
+  }
+  catch (...)
+  {
+    std::remove(temp_path.c_str());
+    throw;
+  }
+
+  replace_file(temp_path.c_str(), target_path.c_str());
+  return false;
+}
+
+template bool wavedit::edit_file(TrimOptions&, WavReader&, const char*, std::vector<uint64_t>&, bool);
+template bool wavedit::edit_file(FadeOptions&, WavReader&, const char*, std::vector<uint64_t>&, bool);
+template bool wavedit::edit_file(NormalizeOptions&, WavReader&, const char*, std::vector<uint64_t>&, bool);
+template bool wavedit::edit_file(ReverbOptions&, WavReader&, const char*, std::vector<uint64_t>&, bool);
+template bool wavedit::edit_file(FreeverbOptions&, WavReader&, const char*, std::vector<uint64_t>&, bool);
+template bool wavedit::edit_file(ChainOptions&, WavReader&, const char*, std::vector<uint64_t>&, bool);
+
+
+/* Support functions implementation */
+
+std::vector<uint8_t> frames_header(wavedit::Frames frames, const wavedit::Format& format)
+{
+  return make_wav_header(format.audio_format, format.num_of_channels, format.frequency, format.bit_depth,
+                         frames.frame_count * format.get_block_align());
+}
+
+// Trim copies samples as they are, so nothing is clipped.
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, TrimOptions& options)
+{
+  effects::trim(reader, writer, options);
+  return std::vector<uint64_t>();
+}
+
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, FadeOptions& options)
+{
+  return effects::fade(reader, writer, options);
+}
+
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, NormalizeOptions& options)
+{
+  return effects::normalize(reader, writer, options);
+}
+
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, ReverbOptions& options)
+{
+  return effects::reverb(reader, writer, options);
+}
+
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, FreeverbOptions& options)
+{
+  return effects::freeverb(reader, writer, options);
+}
+
+std::vector<uint64_t> effect(WavReader& reader, WavWriter& writer, ChainOptions& options)
+{
+  return effects::chain(reader, writer, options);
+}
+
+// Trim changes file size, so it can't be done in place.
+bool effect_in_place(TrimOptions& /*options*/, std::vector<uint64_t>& /*clip_counts*/)
+{
+  return false;
+}
+
+bool effect_in_place(FadeOptions& options, std::vector<uint64_t>& clip_counts)
+{
+  MappedFile file(options.infile_path);
+  clip_counts = effects::fade(file, options);
+  file.flush();
+  return true;
+}
+
+bool effect_in_place(NormalizeOptions& options, std::vector<uint64_t>& clip_counts)
+{
+  MappedFile file(options.infile_path);
+  clip_counts = effects::normalize(file, options);
+  file.flush();
+  return true;
+}
+
+// Reverb tail makes the file longer, so then it can't be done in place.
+bool effect_in_place(ReverbOptions& options, std::vector<uint64_t>& clip_counts)
+{
+  if (!options.tail.is_zero())
+  {
+    return false;
+  }
+  MappedFile file(options.infile_path);
+  clip_counts = effects::reverb(file, options);
+  file.flush();
+  return true;
+}
+
+bool effect_in_place(FreeverbOptions& options, std::vector<uint64_t>& clip_counts)
+{
+  if (!options.tail.is_zero())
+  {
+    return false;
+  }
+  MappedFile file(options.infile_path);
+  clip_counts = effects::freeverb(file, options);
+  file.flush();
+  return true;
+}
+
+// Chain with trim or reverb tail changes file size, so then it can't be done in place.
+bool effect_in_place(ChainOptions& options, std::vector<uint64_t>& clip_counts)
+{
+  if (options.changes_length())
+  {
+    return false;
+  }
+  MappedFile file(options.infile_path);
+  clip_counts = effects::chain(file, options);
+  file.flush();
+  return true;
+}
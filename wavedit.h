@@ -0,0 +1,105 @@
+#ifndef WAVEDIT_H
+#define WAVEDIT_H
+
+#include "mode-options.h"
+#include "wav-header.h"
+#include "wav-stream.h"
+#include "sound-effects.h"
+
+#include <vector>
+#include <cstdint>
+
+// Library interface of wav-edit (libwavedit).
+// Effects are applied to frames in memory or to WAVE files. Frames in memory are edited where they are:
+// they are not copied, no file is read or written and no WAVE header has to be in front of them.
+// Options are made by their default constructors and filled field by field, see mode-options.h.
+// The wav-edit program is a client of this interface.
+namespace wavedit
+{
+  // Format of samples of interleaved frames, like in the "fmt " subchunk of WAVE file.
+  // Supported samples are 8-bit unsigned, 16, 24, 32 and 64-bit signed integers, 32 and 64-bit floats.
+  struct Format
+  {
+    uint16_t audio_format = format::WAVE_FORMAT_PCM;  // or format::WAVE_FORMAT_IEEE_FLOAT
+    uint16_t num_of_channels = 2;
+    uint32_t frequency = 44100;
+    uint16_t bit_depth = 16;
+
+    Format() {}
+    Format(uint16_t audio_format, uint16_t num_of_channels, uint32_t frequency, uint16_t bit_depth);
+
+    // Format of the data of WAVE file.
+    Format(WavHeader& header);
+
+    // Size of one frame in bytes.
+    uint16_t get_block_align() const;
+  };
+
+  // Span of interleaved frames in memory of the caller, which keeps owning it.
+  struct Frames
+  {
+    uint8_t* data = nullptr;
+    uint64_t frame_count = 0;
+
+    Frames() {}
+    Frames(uint8_t* data, uint64_t frame_count) : data(data), frame_count(frame_count) {}
+  };
+
+  // Time points of the options are measured from the first frame of frames.
+  //
+  // Throws std::invalid_argument exception if format is invalid or its samples are not supported
+  // Throws std::invalid_argument exception if a time point of options is out of frames
+
+  // Measures peak, RMS, DC offset and full scale samples of every channel and integrated loudness of frames,
+  // frames are not changed. The analysis runs on options.thread_count threads, see effects::analyze().
+  Analysis analyze(Frames frames, const Format& format, AnalyzeOptions& options);
+
+  // Analyzes the input file opened by reader like analyze() of frames, reading it block by block.
+  // Throws std::runtime_error if error while reading file
+  Analysis analyze(WavReader& reader, AnalyzeOptions& options);
+
+  // Makes peak file of frames for drawing their waveform, see peak-file.h and effects::peaks().
+  std::vector<uint8_t> peaks(Frames frames, const Format& format, PeaksOptions& options);
+
+  // Makes peak file of the input file opened by reader and writes it to outfile_path, replacing it without asking.
+  // Like in edit_file(), the peak file is written to a synced temporary file and renamed over outfile_path.
+  // Returns the size of the peak file in bytes.
+  // Throws std::runtime_error if error while reading or writing files
+  uint64_t peaks_file(PeaksOptions& options, WavReader& reader, const char* outfile_path);
+
+  // Trim effect. Returns the span of the selected frames inside of frames, nothing is moved.
+  Frames trim(Frames frames, const Format& format, TrimOptions& options);
+
+  // Effects that change samples in place and return the number of clipped samples of every channel.
+  // Memory of frames can't grow, so reverb tails are not added: to keep the tail,
+  // end the frames with silence of the tail length.
+  std::vector<uint64_t> fade(Frames frames, const Format& format, FadeOptions& options);
+  std::vector<uint64_t> normalize(Frames frames, const Format& format, NormalizeOptions& options);
+  std::vector<uint64_t> reverb(Frames frames, const Format& format, ReverbOptions& options);
+  std::vector<uint64_t> freeverb(Frames frames, const Format& format, FreeverbOptions& options);
+
+  // Chain effect in place. Trims of the chain drop frames, the frames left are returned as a span inside of frames.
+  // Number of clipped samples of every channel is put into clip_counts.
+  // Throws std::invalid_argument exception if a stage of the chain has a reverb tail
+  Frames chain(Frames frames, const Format& format, ChainOptions& options, std::vector<uint64_t>& clip_counts);
+
+  // Applies effect to input file opened by reader and writes the result to outfile_path.
+  // The effect is chosen based on the O type of the options: TrimOptions, FadeOptions, NormalizeOptions,
+  // ReverbOptions, FreeverbOptions or ChainOptions. The output file is replaced without asking.
+  // The result is written to a temporary file in the output directory, synced to the disk
+  // and renamed over the output, so a crash at any moment leaves either the old or the new output file.
+  // Symbolic links to the output are resolved first, and the replaced file keeps its permissions and owner.
+  // If allow_in_place is true, the output is the input file and the effect keeps file size,
+  // the mapped file is edited in place instead. It is faster, but a crash leaves the file half edited.
+  // Number of clipped samples of every channel is put into clip_counts, it is empty if the effect can't clip.
+  // Returns true if the file was edited in place.
+  //
+  // Throws std::invalid_argument exception if input file contains invalid WAVE header or options don't fit it
+  // Throws std::runtime_error if error while reading or writing files,
+  // or if the temporary file can't be created in the output directory and the file is not edited in place
+  template <typename O>
+  bool edit_file(O& options, WavReader& reader, const char* outfile_path, std::vector<uint64_t>& clip_counts,
+                 bool allow_in_place = false);
+}
+
+#endif
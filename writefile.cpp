@@ -1,10 +1,471 @@
-#include <fstream>
-#include <iterator>
 #include "writefile.h"
 
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+/* Support functions */
+
+// Size of the buffer used to copy files where the kernel can't do it.
+const size_t COPY_BUFFER_BYTES = 1 << 20;
+
+// Builds error message with file path and system error description.
+std::string write_error(const std::string& file_path)
+{
+  return "Error: Failed to write '" + file_path + "': " + std::strerror(errno) + ".";
+}
+
+std::string open_error(const char* file_path)
+{
+  return "Error: File path '" + std::string(file_path) + "' could not be opened.";
+}
+
+// Directory part of file_path, "." for a bare file name.
+std::string directory_path(const std::string& file_path)
+{
+  size_t name_pos = file_path.find_last_of("/\\");
+  return name_pos == std::string::npos ? "." : file_path.substr(0, std::max<size_t>(name_pos, 1));
+}
+
+/* OutputFile implementation */
+
+#ifdef _WIN32
+
+OutputFile::OutputFile(const char* file_path, const char* /*replaced_path*/) : file_path(file_path)
+{
+  file = std::fopen(file_path, "wb");
+  if (file == nullptr)
+  {
+    throw std::runtime_error("Error: File path '" + this->file_path + "' could not be opened for writing.");
+  }
+}
+
+OutputFile::~OutputFile()
+{
+  if (file != nullptr)
+  {
+    std::fclose(file);
+  }
+}
+
+void OutputFile::write(const WriteRegion* regions, size_t region_count)
+{
+  for (size_t idx = 0; idx < region_count; idx++)
+  {
+    if (std::fwrite(regions[idx].bytes, 1, regions[idx].byte_count, file) != regions[idx].byte_count)
+    {
+      throw std::runtime_error(write_error(file_path));
+    }
+  }
+}
+
+void OutputFile::write_at(uint64_t pos, const uint8_t* bytes, size_t byte_count)
+{
+  int64_t current_pos = _ftelli64(file);
+  if (_fseeki64(file, (int64_t)pos, SEEK_SET) != 0
+      || std::fwrite(bytes, 1, byte_count, file) != byte_count
+      || _fseeki64(file, current_pos, SEEK_SET) != 0)
+  {
+    throw std::runtime_error(write_error(file_path));
+  }
+}
+
+void OutputFile::seek(uint64_t pos)
+{
+  if (_fseeki64(file, (int64_t)pos, SEEK_SET) != 0)
+  {
+    throw std::runtime_error(write_error(file_path));
+  }
+}
+
+void OutputFile::copy_from_file(const char* in_path, uint64_t in_pos, uint64_t byte_count)
+{
+  std::FILE* infile = std::fopen(in_path, "rb");
+  if (infile == nullptr)
+  {
+    throw std::invalid_argument(open_error(in_path));
+  }
+
+  std::vector<uint8_t> buffer(std::min<uint64_t>(byte_count, COPY_BUFFER_BYTES));
+  bool read_ok = _fseeki64(infile, (int64_t)in_pos, SEEK_SET) == 0;
+  while (read_ok && byte_count > 0)
+  {
+    size_t chunk = std::min<uint64_t>(byte_count, buffer.size());
+    read_ok = std::fread(&buffer[0], 1, chunk, infile) == chunk;
+    if (read_ok)
+    {
+      write(&buffer[0], chunk);
+      byte_count -= chunk;
+    }
+  }
+  std::fclose(infile);
+
+  if (!read_ok)
+  {
+    throw std::runtime_error("Error: Failed to read '" + std::string(in_path) + "'.");
+  }
+}
+
+// Windows reserves space only by setting the file size, which would have to be cut back after writing.
+void OutputFile::preallocate(uint64_t /*byte_count*/)
+{
+}
+
+void OutputFile::sync()
+{
+  if (std::fflush(file) != 0 || _commit(_fileno(file)) != 0)
+  {
+    throw std::runtime_error(write_error(file_path));
+  }
+}
+
+void OutputFile::close()
+{
+  int result = std::fclose(file);
+  file = nullptr;
+  if (result != 0)
+  {
+    throw std::runtime_error(write_error(file_path));
+  }
+}
+
+#else
+
+// Temporary file gets the permissions of the replaced file only after it is created with owner-only ones,
+// so the new content is never readable by more users than the old one.
+// Owner is changed before permissions, because a change of owner clears set-user-ID and set-group-ID bits.
+OutputFile::OutputFile(const char* file_path, const char* replaced_path) : file_path(file_path)
+{
+  struct stat replaced;
+  bool replaces = replaced_path != nullptr && stat(replaced_path, &replaced) == 0;
+  int flags = replaced_path != nullptr ? O_WRONLY | O_CREAT | O_EXCL : O_WRONLY | O_CREAT | O_TRUNC;
+  fd = open(file_path, flags, replaces ? 0600 : 0666);
+  if (fd == -1)
+  {
+    throw std::runtime_error("Error: File path '" + this->file_path + "' could not be opened for writing: " +
+                             std::strerror(errno) + ".");
+  }
+
+  if (replaces)
+  {
+    if (fchown(fd, replaced.st_uid, replaced.st_gid) != 0 && fchown(fd, (uid_t)-1, replaced.st_gid) != 0)
+    {
+      // Without privileges the file keeps the owner of the process, like any new file
+    }
+    if (fchmod(fd, replaced.st_mode & 07777) != 0)
+    {
+      int error = errno;
+      ::close(fd);
+      unlink(file_path);
+      errno = error;
+      throw std::runtime_error("Error: Could not give '" + this->file_path + "' the permissions of '" + replaced_path +
+                               "': " + std::strerror(errno) + ".");
+    }
+  }
+}
+
+OutputFile::~OutputFile()
+{
+  if (fd != -1)
+  {
+    ::close(fd);
+  }
+}
+
+void OutputFile::write(const WriteRegion* regions, size_t region_count)
+{
+  std::vector<struct iovec> iov;
+  for (size_t idx = 0; idx < region_count; idx++)
+  {
+    if (regions[idx].byte_count > 0)
+    {
+      iov.push_back({ (void*)regions[idx].bytes, regions[idx].byte_count });
+    }
+  }
+
+  size_t iov_idx = 0;
+  while (iov_idx < iov.size())
+  {
+    ssize_t written = writev(fd, &iov[iov_idx], (int)std::min<size_t>(iov.size() - iov_idx, IOV_MAX));
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      throw std::runtime_error(write_error(file_path));
+    }
+    if (written == 0)
+    {
+      errno = ENOSPC;
+      throw std::runtime_error(write_error(file_path));
+    }
+
+    // Skip fully written regions and continue a short write from where it stopped
+    size_t rest = written;
+    while (iov_idx < iov.size() && rest >= iov[iov_idx].iov_len)
+    {
+      rest -= iov[iov_idx].iov_len;
+      iov_idx++;
+    }
+    if (rest > 0)
+    {
+      iov[iov_idx].iov_base = (uint8_t*)iov[iov_idx].iov_base + rest;
+      iov[iov_idx].iov_len -= rest;
+    }
+  }
+}
+
+void OutputFile::write_at(uint64_t pos, const uint8_t* bytes, size_t byte_count)
+{
+  while (byte_count > 0)
+  {
+    ssize_t written = pwrite(fd, bytes, byte_count, (off_t)pos);
+    if (written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (written <= 0)
+    {
+      throw std::runtime_error(write_error(file_path));
+    }
+    bytes += written;
+    byte_count -= written;
+    pos += written;
+  }
+}
+
+void OutputFile::seek(uint64_t pos)
+{
+  if (lseek(fd, (off_t)pos, SEEK_SET) == -1)
+  {
+    throw std::runtime_error(write_error(file_path));
+  }
+}
+
+void OutputFile::copy_from_file(const char* in_path, uint64_t in_pos, uint64_t byte_count)
+{
+  int in_fd = open(in_path, O_RDONLY);
+  if (in_fd == -1)
+  {
+    throw std::invalid_argument(open_error(in_path));
+  }
+
+  off_t in_off = (off_t)in_pos;
+  ssize_t copied = 0;
+
+#ifdef __linux__
+  // copy_file_range works inside one file system, sendfile works between any files
+  bool use_copy_file_range = true;
+  while (byte_count > 0)
+  {
+    size_t chunk = std::min<uint64_t>(byte_count, 1 << 30);
+    if (use_copy_file_range)
+    {
+      copied = copy_file_range(in_fd, &in_off, fd, nullptr, chunk, 0);
+      if (copied < 0 && (errno == EXDEV || errno == ENOSYS || errno == EINVAL || errno == EOPNOTSUPP))
+      {
+        use_copy_file_range = false;
+        continue;
+      }
+    }
+    else
+    {
+      copied = sendfile(fd, in_fd, &in_off, chunk);
+    }
+
+    if (copied < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (copied <= 0)
+    {
+      break;
+    }
+    byte_count -= copied;
+  }
+#endif
+
+  // Copy the rest through user space if the kernel could not do it
+  std::vector<uint8_t> buffer;
+  try
+  {
+    while (byte_count > 0)
+    {
+      if (buffer.empty())
+      {
+        buffer.resize(std::min<uint64_t>(byte_count, COPY_BUFFER_BYTES));
+      }
+      copied = pread(in_fd, &buffer[0], std::min<uint64_t>(byte_count, buffer.size()), in_off);
+      if (copied < 0 && errno == EINTR)
+      {
+        continue;
+      }
+      if (copied <= 0)
+      {
+        throw std::runtime_error("Error: Failed to read '" + std::string(in_path) + "'.");
+      }
+      write(&buffer[0], copied);
+      in_off += copied;
+      byte_count -= copied;
+    }
+  }
+  catch (...)
+  {
+    ::close(in_fd);
+    throw;
+  }
+
+  ::close(in_fd);
+}
+
+// FALLOC_FL_KEEP_SIZE keeps the file size, so a file that turns out shorter needs no truncation.
+// Preallocation is only a hint for the file system, so its errors are ignored.
+void OutputFile::preallocate(uint64_t byte_count)
+{
+#ifdef __linux__
+  if (byte_count > 0)
+  {
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)byte_count);
+  }
+#endif
+}
+
+void OutputFile::sync()
+{
+  if (fsync(fd) != 0)
+  {
+    throw std::runtime_error(write_error(file_path));
+  }
+}
+
+void OutputFile::close()
+{
+  int result = ::close(fd);
+  fd = -1;
+  if (result != 0)
+  {
+    throw std::runtime_error(write_error(file_path));
+  }
+}
+
+#endif
+
+#ifdef __linux__
+int OutputFile::get_fd()
+{
+  return fd;
+}
+#endif
+
+void OutputFile::write(const uint8_t* bytes, size_t byte_count)
+{
+  WriteRegion region = { bytes, byte_count };
+  write(&region, 1);
+}
+
+/* Header functions */
+
 void writefile(std::vector<uint8_t>& bytes ,std::string filename)
 {
-  std::ofstream file(filename, std::ios::out | std::ios::binary | std::ios::trunc);
-  std::ostream_iterator<uint8_t> out_itr(file);
-  std::copy(bytes.begin(), bytes.end(), out_itr);
+  writefile(std::vector<WriteRegion>(1, { bytes.data(), bytes.size() }), filename);
+}
+
+void writefile(const std::vector<WriteRegion>& regions, std::string filename)
+{
+  OutputFile file(filename.c_str());
+  file.write(regions.data(), regions.size());
+  file.close();
+}
+
+std::string resolve_path(const char* file_path)
+{
+#ifdef _WIN32
+  return file_path;
+#else
+  char resolved[PATH_MAX];
+  return realpath(file_path, resolved) != nullptr ? std::string(resolved) : std::string(file_path);
+#endif
+}
+
+bool directory_writable(const char* file_path)
+{
+#ifdef _WIN32
+  return true;
+#else
+  return access(directory_path(file_path).c_str(), W_OK | X_OK) == 0;
+#endif
+}
+
+std::string temp_file_path(const char* file_path)
+{
+  static std::atomic<uint64_t> temp_count(0);
+#ifdef _WIN32
+  int pid = _getpid();
+#else
+  int pid = getpid();
+#endif
+
+  std::string path = file_path;
+  size_t name_pos = path.find_last_of("/\\") + 1;
+  return path.substr(0, name_pos) + "." + path.substr(name_pos) + "." + std::to_string(pid) + "-" +
+         std::to_string(temp_count++) + ".tmp";
+}
+
+void replace_file(const char* from_path, const char* to_path)
+{
+#ifdef _WIN32
+  // Plain rename does not replace existing files on Windows
+  if (!MoveFileExA(from_path, to_path, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+  {
+    throw std::runtime_error("Error: Could not replace '" + std::string(to_path) + "' with '" + from_path + "'.");
+  }
+#else
+  if (std::rename(from_path, to_path) != 0)
+  {
+    throw std::runtime_error("Error: Could not replace '" + std::string(to_path) + "' with '" + from_path + "': " +
+                             std::strerror(errno) + ".");
+  }
+
+  int dir_fd = open(directory_path(to_path).c_str(), O_RDONLY);
+  if (dir_fd != -1)
+  {
+    fsync(dir_fd);
+    ::close(dir_fd);
+  }
+#endif
+}
+
+void make_directory(const char* dir_path)
+{
+#ifdef _WIN32
+  int result = _mkdir(dir_path);
+#else
+  int result = mkdir(dir_path, 0777);
+#endif
+  int error = errno;
+  struct stat results;
+  if (result != 0 && (error != EEXIST || stat(dir_path, &results) != 0 || (results.st_mode & S_IFMT) != S_IFDIR))
+  {
+    throw std::runtime_error("Error: Could not create directory '" + std::string(dir_path) + "': " + std::strerror(error) + ".");
+  }
 }
@@ -4,7 +4,106 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <cstddef>
+#include <cstdio>
 
+// Continuous region of memory to be written to a file.
+struct WriteRegion
+{
+  const uint8_t* bytes;
+  size_t byte_count;
+};
+
+// Output file written with large unbuffered writes.
+// Several regions can be written with one vectored write (writev on POSIX),
+// so separate buffers don't have to be joined before writing.
+// Short writes are continued until all bytes are written.
+//
+// Throws std::runtime_error if file could not be opened or written, e.g. when the disk is full
+class OutputFile
+{
+private:
+  std::string file_path;
+#ifdef _WIN32
+  std::FILE* file;
+#else
+  int fd;
+#endif
+
+public:
+  // If replaced_path is set, the file is a temporary one that will replace replaced_path, see replace_file().
+  // Then it must not exist yet and is created with owner-only permissions, and on POSIX it gets
+  // the permissions and, where the process is allowed to change it, the owner of replaced_path if that exists.
+  OutputFile(const char* file_path, const char* replaced_path = nullptr);
+  ~OutputFile();
+  OutputFile(const OutputFile&) = delete;
+  OutputFile& operator=(const OutputFile&) = delete;
+
+  // Writes regions one after another at the current position.
+  void write(const WriteRegion* regions, size_t region_count);
+  void write(const uint8_t* bytes, size_t byte_count);
+
+  // Copies byte_count bytes from in_pos of file in_path to the current position.
+  // On Linux the bytes are copied by the kernel (copy_file_range or sendfile) and never pass through user space.
+  // Throws std::invalid_argument exception if in_path could not be opened.
+  void copy_from_file(const char* in_path, uint64_t in_pos, uint64_t byte_count);
+
+  // Writes bytes at pos from the file start. The current position is not changed.
+  void write_at(uint64_t pos, const uint8_t* bytes, size_t byte_count);
+
+  // Moves the current position to pos from the file start.
+  void seek(uint64_t pos);
+
+  // Reserves disk space for byte_count bytes from the file start without changing the file size,
+  // so the file gets few large extents instead of growing write by write.
+  // Done with fallocate on Linux, elsewhere and on file systems without it nothing is done.
+  void preallocate(uint64_t byte_count);
+
+  // Flushes written bytes to the disk (fsync), so they survive a crash of the system.
+  void sync();
+
+  // Closes the file. Errors of delayed writes are reported here.
+  void close();
+
+#ifdef __linux__
+  // Descriptor of the file for asynchronous writes by the kernel.
+  int get_fd();
+#endif
+};
+
+// Writes bytes to file, replacing its content.
+//
+// Throws std::runtime_error if file could not be written
 void writefile (std::vector<uint8_t>& bytes ,std::string filename);
 
-#endif
\ No newline at end of file
+// Writes regions one after another to file, replacing its content.
+//
+// Throws std::runtime_error if file could not be written
+void writefile(const std::vector<WriteRegion>& regions, std::string filename);
+
+// Returns file_path with symbolic links resolved, so the file they point to is replaced, not the links.
+// Path of a file that does not exist is returned as it is.
+std::string resolve_path(const char* file_path);
+
+// Returns true if files can be created in the directory of file_path, e.g. a temporary file that replaces it.
+bool directory_writable(const char* file_path);
+
+// Returns path of a temporary file in the directory of file_path, unique for every call in the process:
+// ".NAME.PID-N.tmp", where NAME is the file name of file_path. The file is not created.
+// Being in the same directory, the temporary file can replace file_path with an atomic rename.
+// file_path should be resolved with resolve_path() first, so the temporary file is next to the file links point to.
+std::string temp_file_path(const char* file_path);
+
+// Moves file from from_path to to_path, replacing the file at to_path if it exists.
+// Replacement is atomic: the file at to_path is either the old or the new one, even after a crash.
+// On POSIX the directory is synced after the rename, so the new file keeps its name after a crash of the system.
+//
+// Throws std::runtime_error if file could not be replaced
+void replace_file(const char* from_path, const char* to_path);
+
+// Creates directory dir_path if it does not exist. Parent directory must exist.
+//
+// Throws std::runtime_error if directory could not be created
+void make_directory(const char* dir_path);
+
+#endif